@@ -8,3 +8,12 @@
 }
 
 -keep class com.fidonext.messenger.rust.RustNative { *; }
+
+# Result classes resolved by name in JNI_OnLoad; renaming them fails library load
+-keep class com.fidonext.messenger.rust.Libp2pNative$IdentityProfile { <init>(...); }
+-keep class com.fidonext.messenger.rust.Libp2pNative$DiscoveryEvent { <init>(...); }
+-keep class com.fidonext.messenger.rust.Libp2pNative$DecryptedE2eeMessage { <init>(...); }
+-keep class com.fidonext.messenger.rust.Libp2pNative$DecryptedE2eeBatch { <init>(...); }
+-keep class com.fidonext.messenger.rust.Libp2pNative$DhtResult { <init>(...); }
+-keep class com.fidonext.messenger.rust.Libp2pNative$NodeEvent { <init>(...); }
+-keep class com.fidonext.messenger.rust.Libp2pNative$DialResult { <init>(...); }
@@ -1,3 +1,6 @@
+#ifndef CABI_RUST_LIBP2P_H
+#define CABI_RUST_LIBP2P_H
+
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -43,6 +46,12 @@
  */
 #define CABI_STATUS_NOT_FOUND 7
 
+/**
+ * Enqueue rejected: the queue is full under [`CABI_OVERFLOW_DROP_NEWEST`], or it
+ * stayed full past `block_timeout_ms` under [`CABI_OVERFLOW_BLOCK`].
+ */
+#define CABI_STATUS_QUEUE_FULL -3
+
 
 
 /**
@@ -85,6 +94,104 @@
  */
 #define CABI_DISCOVERY_EVENT_FINISHED 1
 
+/**
+ * Queue overflow: library default behaviour (the only one older builds have).
+ */
+#define CABI_OVERFLOW_DEFAULT 0
+
+/**
+ * Queue overflow: evict the oldest queued item; the producer never waits.
+ */
+#define CABI_OVERFLOW_DROP_OLDEST 1
+
+/**
+ * Queue overflow: reject the new item with [`CABI_STATUS_QUEUE_FULL`].
+ */
+#define CABI_OVERFLOW_DROP_NEWEST 2
+
+/**
+ * Queue overflow: the producer waits up to `block_timeout_ms` for room, then is
+ * rejected with [`CABI_STATUS_QUEUE_FULL`].
+ */
+#define CABI_OVERFLOW_BLOCK 3
+
+/**
+ * Wait source: inbound message queue.
+ */
+#define CABI_WAIT_SOURCE_MESSAGES 0
+
+/**
+ * Wait source: node event queue.
+ */
+#define CABI_WAIT_SOURCE_NODE_EVENTS 1
+
+/**
+ * Async DHT result of a put.
+ */
+#define CABI_DHT_OP_PUT 0
+
+/**
+ * Async DHT result of a get; carries the record value on success.
+ */
+#define CABI_DHT_OP_GET 1
+
+/**
+ * Node event: AutoNAT status changed; `value` is the new `CABI_AUTONAT_*` status.
+ */
+#define CABI_NODE_EVENT_AUTONAT_CHANGED 0
+
+/**
+ * Node event: a listen address became active; `text` is the multiaddr.
+ */
+#define CABI_NODE_EVENT_LISTEN_ADDR_ADDED 1
+
+/**
+ * Node event: a listen address went away; `text` is the multiaddr.
+ */
+#define CABI_NODE_EVENT_LISTEN_ADDR_REMOVED 2
+
+/**
+ * Node event: connection to `peer_id` opened; `text` is the remote multiaddr and
+ * `value` the number of connections to that peer afterwards.
+ */
+#define CABI_NODE_EVENT_CONNECTION_OPENED 3
+
+/**
+ * Node event: connection to `peer_id` closed; fields as for
+ * [`CABI_NODE_EVENT_CONNECTION_OPENED`].
+ */
+#define CABI_NODE_EVENT_CONNECTION_CLOSED 4
+
+/**
+ * Node event: relay `peer_id` accepted our reservation; `text` is the circuit address.
+ */
+#define CABI_NODE_EVENT_RESERVATION_ACCEPTED 5
+
+/**
+ * Node event: relay `peer_id` dropped our reservation; `text` is the circuit address.
+ */
+#define CABI_NODE_EVENT_RESERVATION_EXPIRED 6
+
+/**
+ * Dial transport: the peer was already connected; nothing was dialed.
+ */
+#define CABI_TRANSPORT_EXISTING 0
+
+/**
+ * Dial transport: direct TCP.
+ */
+#define CABI_TRANSPORT_TCP 1
+
+/**
+ * Dial transport: direct QUIC.
+ */
+#define CABI_TRANSPORT_QUIC 2
+
+/**
+ * Dial transport: circuit relay v2 (a `/p2p-circuit` address).
+ */
+#define CABI_TRANSPORT_RELAY 3
+
 #define DEFAULT_DELIVERY_TTL_SECONDS 300
 
 #define MIN_DELIVERY_TTL_SECONDS 10
@@ -110,6 +217,142 @@ typedef struct CabiNodeHandle {
   uint8_t _private[0];
 } CabiNodeHandle;
 
+/**
+ * Async runtime that several nodes can share (opaque).
+ */
+typedef struct CabiRuntime CabiRuntime;
+
+/**
+ * Profile state opened once by `cabi_e2ee_context_open` (opaque).
+ */
+typedef struct CabiE2eeContext CabiE2eeContext;
+
+/**
+ * One payload of a batch call.
+ */
+typedef struct CabiBuffer {
+  const uint8_t *ptr;
+  uintptr_t len;
+} CabiBuffer;
+
+/**
+ * Argument block for `cabi_runtime_new`. Zeroed fields mean library defaults.
+ */
+typedef struct CabiRuntimeConfig {
+  uintptr_t struct_size;
+  /**
+   * 0 = one worker per core.
+   */
+  uint32_t worker_threads;
+  /**
+   * Pin worker i to core `first_core + i` (Linux only; ignored elsewhere).
+   */
+  bool pin_workers;
+  uint32_t first_core;
+} CabiRuntimeConfig;
+
+/**
+ * Argument block for `cabi_node_new_with_config`.
+ *
+ * Zeroed fields mean library defaults. Fields are only ever appended and
+ * `struct_size` tells the library how much of the struct the caller knows,
+ * so a library reads the prefix it understands.
+ */
+typedef struct CabiNodeConfig {
+  uintptr_t struct_size;
+  bool use_quic;
+  bool enable_relay_hop;
+  const char *const *bootstrap_peers;
+  uintptr_t bootstrap_peers_len;
+  const uint8_t *identity_seed_ptr;
+  uintptr_t identity_seed_len;
+  /**
+   * 0 = [`DEFAULT_MESSAGE_QUEUE_CAPACITY`]; applies to inbound and outbound queues.
+   */
+  uintptr_t message_queue_capacity;
+  /**
+   * 0 = [`DEFAULT_DISCOVERY_QUEUE_CAPACITY`].
+   */
+  uintptr_t discovery_queue_capacity;
+  /**
+   * One of `CABI_OVERFLOW_*`.
+   */
+  int overflow_policy;
+  /**
+   * [`CABI_OVERFLOW_BLOCK`] only; 0 = library default.
+   */
+  uint32_t block_timeout_ms;
+  /**
+   * Swarm connection limits.
+   */
+  uint32_t max_established_connections;
+  uint32_t max_connections_per_peer;
+  uint32_t max_pending_incoming;
+  uint32_t max_pending_outgoing;
+  /**
+   * Close connections with no open streams after this long.
+   */
+  uint64_t idle_connection_timeout_ms;
+  /**
+   * Yamux per-stream receive window in bytes.
+   */
+  uint32_t yamux_max_receive_window;
+  /**
+   * Kademlia query parallelism (alpha) and record replication factor (k).
+   */
+  uint32_t kad_parallelism;
+  uint32_t kad_replication_factor;
+  /**
+   * Tokio worker threads of the node's own runtime.
+   */
+  uint32_t worker_threads;
+  /**
+   * Run on this shared runtime instead of starting one; `worker_threads` is
+   * ignored then. The runtime must outlive the node.
+   */
+  struct CabiRuntime *runtime;
+} CabiNodeConfig;
+
+/**
+ * One record of a `cabi_node_dht_put_records` batch.
+ */
+typedef struct CabiDhtRecord {
+  const uint8_t *key_ptr;
+  uintptr_t key_len;
+  const uint8_t *value_ptr;
+  uintptr_t value_len;
+  uint64_t ttl_seconds;
+} CabiDhtRecord;
+
+/**
+ * Counters of one bounded queue since the node started.
+ */
+typedef struct CabiQueueCounters {
+  uint64_t capacity;
+  uint64_t depth;
+  uint64_t high_water;
+  uint64_t enqueued;
+  uint64_t dropped;
+  /**
+   * Producers that had to wait (block policy) or were rejected (drop-newest).
+   */
+  uint64_t blocked;
+} CabiQueueCounters;
+
+/**
+ * Output of `cabi_node_queue_stats`; set `struct_size` before the call.
+ */
+typedef struct CabiQueueStats {
+  uintptr_t struct_size;
+  struct CabiQueueCounters inbound;
+  struct CabiQueueCounters outbound;
+  struct CabiQueueCounters discovery;
+} CabiQueueStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
 /**
  * C-ABI. Inits tracing for the library in order to give more proper info on networking
  */
@@ -354,6 +597,94 @@ int cabi_e2ee_decrypt_message_auto(const char *profile_path,
                                    uintptr_t *written_len,
                                    int *message_kind);
 
+/**
+ * C-ABI. Decrypts `count` payloads in order with the profile loaded once.
+ *
+ * Plaintext i is `out_lengths[i]` bytes at `out_offsets[i]` in `out_arena`, with
+ * its kind in `out_kinds[i]` and its own status in `out_statuses[i]`.
+ * Stops early with [`CABI_STATUS_BUFFER_TOO_SMALL`] when the next plaintext does
+ * not fit the arena; `out_processed` tells how many leading items have a valid
+ * status, kind, offset and length. The rest were not attempted.
+ */
+int cabi_e2ee_decrypt_messages_auto(const char *profile_path,
+                                    const struct CabiBuffer *payloads,
+                                    uintptr_t count,
+                                    uint8_t *out_arena,
+                                    uintptr_t arena_len,
+                                    uintptr_t *out_offsets,
+                                    uintptr_t *out_lengths,
+                                    int *out_kinds,
+                                    int *out_statuses,
+                                    uintptr_t *out_processed);
+
+/**
+ * C-ABI. Opens a profile once and keeps identity, sessions and prekeys in memory.
+ *
+ * Writes go through the library's journal, so a crash loses at most the
+ * unflushed tail rather than the profile. A context may be used from several
+ * threads, but must not be closed while a call on it is running.
+ */
+int cabi_e2ee_context_open(const char *profile_path, struct CabiE2eeContext **out_ctx);
+
+/**
+ * C-ABI. Persists journaled session/prekey changes of the context.
+ */
+int cabi_e2ee_context_flush(struct CabiE2eeContext *ctx);
+
+/**
+ * C-ABI. Flushes and frees the context.
+ */
+void cabi_e2ee_context_close(struct CabiE2eeContext *ctx);
+
+/**
+ * C-ABI. `cabi_e2ee_build_prekey_bundle` on an open context.
+ */
+int cabi_e2ee_build_prekey_bundle_ctx(struct CabiE2eeContext *ctx,
+                                      uintptr_t one_time_prekey_count,
+                                      uint64_t ttl_seconds,
+                                      uint8_t *out_buffer,
+                                      uintptr_t out_buffer_len,
+                                      uintptr_t *written_len);
+
+/**
+ * C-ABI. `cabi_e2ee_build_message_auto` on an open context.
+ */
+int cabi_e2ee_build_message_auto_ctx(struct CabiE2eeContext *ctx,
+                                     const uint8_t *recipient_prekey_bundle_ptr,
+                                     uintptr_t recipient_prekey_bundle_len,
+                                     const uint8_t *plaintext_ptr,
+                                     uintptr_t plaintext_len,
+                                     const uint8_t *aad_ptr,
+                                     uintptr_t aad_len,
+                                     uint8_t *out_buffer,
+                                     uintptr_t out_buffer_len,
+                                     uintptr_t *written_len);
+
+/**
+ * C-ABI. `cabi_e2ee_decrypt_message_auto` on an open context.
+ */
+int cabi_e2ee_decrypt_message_auto_ctx(struct CabiE2eeContext *ctx,
+                                       const uint8_t *payload_ptr,
+                                       uintptr_t payload_len,
+                                       uint8_t *out_plaintext_buffer,
+                                       uintptr_t out_plaintext_buffer_len,
+                                       uintptr_t *written_len,
+                                       int *message_kind);
+
+/**
+ * C-ABI. `cabi_e2ee_decrypt_messages_auto` on an open context.
+ */
+int cabi_e2ee_decrypt_messages_auto_ctx(struct CabiE2eeContext *ctx,
+                                        const struct CabiBuffer *payloads,
+                                        uintptr_t count,
+                                        uint8_t *out_arena,
+                                        uintptr_t arena_len,
+                                        uintptr_t *out_offsets,
+                                        uintptr_t *out_lengths,
+                                        int *out_kinds,
+                                        int *out_statuses,
+                                        uintptr_t *out_processed);
+
 /**
  * C-ABI. Returns the latest AutoNAT status observed for the node.
  * Use it to detect the node is public or not, which can be a signal to recreate
@@ -372,6 +703,22 @@ struct CabiNodeHandle *cabi_node_new(bool use_quic,
                                      const uint8_t *identity_seed_ptr,
                                      uintptr_t identity_seed_len);
 
+/**
+ * C-ABI. Creates a node from a versioned [`CabiNodeConfig`]. Returns null on failure.
+ */
+struct CabiNodeHandle *cabi_node_new_with_config(const struct CabiNodeConfig *config);
+
+/**
+ * C-ABI. Starts an async runtime that nodes can share through
+ * [`CabiNodeConfig::runtime`]. Returns null on failure.
+ */
+struct CabiRuntime *cabi_runtime_new(const struct CabiRuntimeConfig *config);
+
+/**
+ * C-ABI. Stops the runtime. Every node on it must have been freed first.
+ */
+void cabi_runtime_free(struct CabiRuntime *runtime);
+
 /**
  * C-ABI. Writes the local PeerId into the provided buffer as a UTF-8 string.
  */
@@ -469,7 +816,234 @@ int cabi_node_get_addrs_snapshot(struct CabiNodeHandle *handle,
                                  uintptr_t out_buf_len,
                                  uintptr_t *out_written);
 
+/**
+ * C-ABI. Returns a pollable fd for `source` (`CABI_WAIT_SOURCE_*`).
+ *
+ * The fd is an eventfd counter owned by the node: it becomes readable after
+ * every enqueue to the queue. Read it to reset the counter before draining, so
+ * an item that races the drain re-arms the fd. Do not close it; it lives until
+ * `cabi_node_free`.
+ */
+int cabi_node_get_wait_fd(struct CabiNodeHandle *handle, int source, int *out_fd);
+
+/**
+ * C-ABI. `cabi_node_dequeue_message` that waits up to `timeout_ms` (0 = poll) for
+ * a message before returning [`CABI_STATUS_QUEUE_EMPTY`].
+ */
+int cabi_node_dequeue_message_timeout(struct CabiNodeHandle *handle,
+                                      uint8_t *out_buffer,
+                                      uintptr_t buffer_len,
+                                      uintptr_t *written_len,
+                                      uint64_t timeout_ms);
+
+/**
+ * C-ABI. Enqueues `count` payloads in order under the queue's overflow policy.
+ *
+ * Statuses are written for the first `*out_accepted` buffers only, the prefix
+ * the library processed; the remaining buffers were not enqueued and have no
+ * status.
+ */
+int cabi_node_enqueue_messages(struct CabiNodeHandle *handle,
+                               const struct CabiBuffer *buffers,
+                               uintptr_t count,
+                               int *out_statuses,
+                               uintptr_t *out_accepted);
+
+/**
+ * C-ABI. Copies up to `max_messages` queued messages into `out_arena`.
+ *
+ * Message i is `out_lengths[i]` bytes at `out_offsets[i]`. Returns
+ * [`CABI_STATUS_QUEUE_EMPTY`] (or success with `*out_count == 0`) when nothing
+ * is queued. Returns [`CABI_STATUS_BUFFER_TOO_SMALL`] when the head message
+ * alone does not fit the arena: `out_lengths[0]` then holds its size and the
+ * message stays queued.
+ */
+int cabi_node_dequeue_messages(struct CabiNodeHandle *handle,
+                               uint8_t *out_arena,
+                               uintptr_t arena_len,
+                               uintptr_t *out_offsets,
+                               uintptr_t *out_lengths,
+                               uintptr_t max_messages,
+                               uintptr_t *out_count);
+
+/**
+ * C-ABI. Fills `out_stats` with the counters of the inbound, outbound and
+ * discovery queues. `out_stats->struct_size` must be set by the caller.
+ */
+int cabi_node_queue_stats(struct CabiNodeHandle *handle, struct CabiQueueStats *out_stats);
+
+/**
+ * C-ABI. Renders counters, gauges and latency histograms as text, one record
+ * per line:
+ *
+ * `counter <name> <value>`, `gauge <name> <value>` and
+ * `histogram <name> <count> <sum_us> <min_us> <max_us> <le_us>:<cumulative> ...`
+ *
+ * Histogram buckets are log-linear (HDR style, ~3% relative error) with upper
+ * bounds in microseconds; empty buckets are omitted. Reads atomics only.
+ * Returns [`CABI_STATUS_BUFFER_TOO_SMALL`] with `out_written` set to the size
+ * needed when the text does not fit.
+ */
+int cabi_node_metrics_snapshot(struct CabiNodeHandle *handle,
+                               char *out_buf,
+                               uintptr_t out_buf_len,
+                               uintptr_t *out_written);
+
+/**
+ * C-ABI. Starts a DHT put and returns at once; the outcome is queued for
+ * `cabi_node_dequeue_dht_result` under `*out_request_id`.
+ */
+int cabi_node_dht_put_record_async(struct CabiNodeHandle *handle,
+                                   const uint8_t *key_ptr,
+                                   uintptr_t key_len,
+                                   const uint8_t *value_ptr,
+                                   uintptr_t value_len,
+                                   uint64_t ttl_seconds,
+                                   uint64_t *out_request_id);
+
+/**
+ * C-ABI. Starts a DHT get and returns at once; the outcome, with the record
+ * value, is queued for `cabi_node_dequeue_dht_result` under `*out_request_id`.
+ */
+int cabi_node_dht_get_record_async(struct CabiNodeHandle *handle,
+                                   const uint8_t *key_ptr,
+                                   uintptr_t key_len,
+                                   uint64_t *out_request_id);
+
+/**
+ * C-ABI. Waits up to `timeout_ms` (0 = poll) for the next finished async DHT
+ * operation.
+ *
+ * `op_kind` is `CABI_DHT_OP_*` and `op_status` the operation's own status
+ * ([`CABI_STATUS_NOT_FOUND`] for a missing record). Returns
+ * [`CABI_STATUS_QUEUE_EMPTY`] when nothing finished in time. Returns
+ * [`CABI_STATUS_BUFFER_TOO_SMALL`] when the value does not fit: the result
+ * stays queued and `value_written` is set to the size it needs.
+ */
+int cabi_node_dequeue_dht_result(struct CabiNodeHandle *handle,
+                                 uint64_t timeout_ms,
+                                 uint64_t *request_id,
+                                 int *op_kind,
+                                 int *op_status,
+                                 uint8_t *value_buf,
+                                 uintptr_t value_buf_len,
+                                 uintptr_t *value_written);
+
+/**
+ * C-ABI. Stores `count` records and blocks until every one is stored or has failed.
+ *
+ * Keys that route to the same region of the keyspace share one closest-peers
+ * lookup. One status per record is written to `out_statuses`.
+ */
+int cabi_node_dht_put_records(struct CabiNodeHandle *handle,
+                              const struct CabiDhtRecord *records,
+                              uintptr_t count,
+                              int *out_statuses);
+
+/**
+ * C-ABI. `cabi_node_dequeue_discovery_event` that waits up to `timeout_ms`
+ * (0 = poll) for an event before returning [`CABI_STATUS_QUEUE_EMPTY`].
+ */
+int cabi_node_dequeue_discovery_event_timeout(struct CabiNodeHandle *handle,
+                                              uint64_t timeout_ms,
+                                              int *event_kind,
+                                              uint64_t *request_id,
+                                              int *status_code,
+                                              char *peer_id_buffer,
+                                              uintptr_t peer_id_buffer_len,
+                                              uintptr_t *peer_id_written_len,
+                                              char *address_buffer,
+                                              uintptr_t address_buffer_len,
+                                              uintptr_t *address_written_len);
+
+/**
+ * C-ABI. Runs get_closest_peers for every target at once under one request id
+ * and one deadline.
+ *
+ * Each newly seen peer (never the local one) is queued as a
+ * [`CABI_DISCOVERY_EVENT_ADDRESS`] as soon as any query returns it.
+ * [`CABI_DISCOVERY_EVENT_FINISHED`] follows with success when all queries are
+ * done, or [`CABI_STATUS_TIMEOUT`] when the deadline cut them short.
+ */
+int cabi_node_discover_neighborhood(struct CabiNodeHandle *handle,
+                                    const char *const *target_peer_ids,
+                                    uintptr_t target_count,
+                                    uint64_t timeout_ms,
+                                    uint64_t *out_request_id);
+
+/**
+ * C-ABI. Saves the Kademlia routing table, known peer addresses and reserved
+ * relays to `path`.
+ *
+ * Writes a temp file and renames it over `path`. `out_peers` receives the
+ * number of peers saved.
+ */
+int cabi_node_save_peer_store(struct CabiNodeHandle *handle, const char *path, uintptr_t *out_peers);
+
+/**
+ * C-ABI. Merges a saved peer store into a running node and redials its relays.
+ *
+ * Returns [`CABI_STATUS_NOT_FOUND`] when the file does not exist.
+ */
+int cabi_node_load_peer_store(struct CabiNodeHandle *handle, const char *path, uintptr_t *out_peers);
+
+/**
+ * C-ABI. Turns the circuit relay hop protocol on or off on a running node.
+ *
+ * The handle, listeners, connections and queues are kept.
+ */
+int cabi_node_set_relay_hop(struct CabiNodeHandle *handle, bool enable);
+
+/**
+ * C-ABI. Waits up to `timeout_ms` (0 = poll) for the next node event.
+ *
+ * `kind` is `CABI_NODE_EVENT_*`; `value`, `peer_id` and `text` are described
+ * there. `timestamp_ns` is CLOCK_MONOTONIC when the node saw the change.
+ * Returns [`CABI_STATUS_QUEUE_EMPTY`] when nothing arrived. The queue is
+ * bounded and drops its oldest event when full; its wait fd is
+ * [`CABI_WAIT_SOURCE_NODE_EVENTS`].
+ */
+int cabi_node_dequeue_node_event(struct CabiNodeHandle *handle,
+                                 uint64_t timeout_ms,
+                                 int *kind,
+                                 uint64_t *timestamp_ns,
+                                 int64_t *value,
+                                 char *peer_id_buffer,
+                                 uintptr_t peer_id_buffer_len,
+                                 uintptr_t *peer_id_written_len,
+                                 char *text_buffer,
+                                 uintptr_t text_buffer_len,
+                                 uintptr_t *text_written_len);
+
+/**
+ * C-ABI. Connects to `peer_id` over the best of `addrs`.
+ *
+ * Returns at once with [`CABI_TRANSPORT_EXISTING`] when a connection already
+ * exists, and concurrent calls for the same peer share one attempt. Otherwise
+ * the addresses race happy-eyeballs style: direct QUIC, then direct TCP, then
+ * relayed circuits, each started after a short stagger or as soon as the
+ * previous one fails. The first connection wins and the others are cancelled.
+ * Unlike `cabi_node_dial`, success means the connection is established:
+ * `out_transport`, `out_connect_us` and the winner address describe it.
+ */
+int cabi_node_dial_peer(struct CabiNodeHandle *handle,
+                        const char *peer_id,
+                        const char *const *addrs,
+                        uintptr_t addr_count,
+                        uint64_t timeout_ms,
+                        int *out_transport,
+                        uint64_t *out_connect_us,
+                        char *winner_buffer,
+                        uintptr_t winner_buffer_len,
+                        uintptr_t *winner_written_len);
+
 /**
  * C-ABI. Frees node with specified handle
  */
 void cabi_node_free(struct CabiNodeHandle *handle);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif // __cplusplus
+
+#endif /* CABI_RUST_LIBP2P_H */
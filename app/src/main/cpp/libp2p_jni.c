@@ -1,106 +1,445 @@
 #include <jni.h>
+#include <android/log.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+// C-ABI of the Rust library, linked from libcabi_rust_libp2p.so
+#include "cabi-rust-libp2p.h"
+
+// Optional C-ABI functions from newer fidonext-core releases.
+// Weak: they resolve to NULL when the loaded library lacks them,
+// and every caller keeps a fallback on the baseline ABI.
+#pragma weak cabi_node_dequeue_messages
+#pragma weak cabi_node_new_with_config
+#pragma weak cabi_node_dht_put_record_async
+#pragma weak cabi_node_dht_get_record_async
+#pragma weak cabi_node_dequeue_dht_result
+#pragma weak cabi_node_dht_put_records
+#pragma weak cabi_node_dequeue_discovery_event_timeout
+#pragma weak cabi_node_discover_neighborhood
+#pragma weak cabi_node_save_peer_store
+#pragma weak cabi_node_load_peer_store
+#pragma weak cabi_node_dequeue_node_event
+#pragma weak cabi_node_dial_peer
+#pragma weak cabi_node_metrics_snapshot
+#pragma weak cabi_e2ee_decrypt_messages_auto
+#pragma weak cabi_e2ee_context_open
+#pragma weak cabi_e2ee_context_flush
+#pragma weak cabi_e2ee_context_close
+#pragma weak cabi_e2ee_build_prekey_bundle_ctx
+#pragma weak cabi_e2ee_build_message_auto_ctx
+#pragma weak cabi_e2ee_decrypt_message_auto_ctx
+#pragma weak cabi_e2ee_decrypt_messages_auto_ctx
+
+// Slots of the jlong[] tuning array passed to cabiNodeNewWithConfig;
+// must match Libp2pNative.NODE_CONFIG_*
+enum {
+    NODE_CONFIG_MESSAGE_QUEUE_CAPACITY = 0,
+    NODE_CONFIG_DISCOVERY_QUEUE_CAPACITY,
+    NODE_CONFIG_OVERFLOW_POLICY,
+    NODE_CONFIG_BLOCK_TIMEOUT_MS,
+    NODE_CONFIG_MAX_CONNECTIONS,
+    NODE_CONFIG_MAX_CONNECTIONS_PER_PEER,
+    NODE_CONFIG_MAX_PENDING_INCOMING,
+    NODE_CONFIG_MAX_PENDING_OUTGOING,
+    NODE_CONFIG_IDLE_TIMEOUT_MS,
+    NODE_CONFIG_YAMUX_WINDOW,
+    NODE_CONFIG_KAD_ALPHA,
+    NODE_CONFIG_KAD_REPLICATION,
+    NODE_CONFIG_WORKER_THREADS,
+    NODE_CONFIG_SLOTS
+};
+
+// Native allocation counters, read through cabiJniAllocStats. Once buffers have
+// grown to their high-water mark the send/receive path should stop moving them.
+static atomic_llong jni_scratch_acquires = 0;
+static atomic_llong jni_native_allocations = 0;
+static atomic_llong jni_native_bytes_reserved = 0;
+
+static void count_native_allocation(size_t old_cap, size_t new_cap) {
+    atomic_fetch_add(&jni_native_allocations, 1);
+    atomic_fetch_add(&jni_native_bytes_reserved, (long long)new_cap - (long long)old_cap);
+}
+
+#define SCRATCH_INITIAL (64 * 1024)
+// Retries after CABI_STATUS_BUFFER_TOO_SMALL with the reported size
+#define SCRATCH_MAX_ATTEMPTS 4
+
+// Byte[] arguments at or above this size are accessed in place through
+// GetPrimitiveArrayCritical when the call is bounded; smaller ones (and any
+// argument of a blocking call) are copied into a pooled per-thread slot.
+#define JNI_CRITICAL_MIN_BYTES (16 * 1024)
+// Pooled input slots, one per byte[] argument of the widest wrapper
+#define JNI_ARG_SLOTS 3
+
+typedef struct Scratch {
+    unsigned char* data;
+    size_t cap;
+} Scratch;
+
+// Thread-local buffers for the DHT and E2EE wrappers. They only grow, so after
+// the largest record/message seen on a thread later calls reuse them as is.
+typedef struct ThreadBuffers {
+    Scratch out;
+    Scratch args[JNI_ARG_SLOTS];
+} ThreadBuffers;
+
+static pthread_key_t thread_buffers_key;
+static pthread_once_t thread_buffers_key_once = PTHREAD_ONCE_INIT;
+
+static void scratch_free(Scratch* scratch) {
+    atomic_fetch_sub(&jni_native_bytes_reserved, (long long)scratch->cap);
+    free(scratch->data);
+}
+
+static void thread_buffers_destroy(void* ptr) {
+    ThreadBuffers* buffers = (ThreadBuffers*)ptr;
+    scratch_free(&buffers->out);
+    for (int i = 0; i < JNI_ARG_SLOTS; i++) {
+        scratch_free(&buffers->args[i]);
+    }
+    free(buffers);
+}
+
+static void thread_buffers_key_init(void) {
+    pthread_key_create(&thread_buffers_key, thread_buffers_destroy);
+}
+
+static ThreadBuffers* thread_buffers(void) {
+    pthread_once(&thread_buffers_key_once, thread_buffers_key_init);
+    ThreadBuffers* buffers = (ThreadBuffers*)pthread_getspecific(thread_buffers_key);
+    if (buffers == NULL) {
+        buffers = (ThreadBuffers*)calloc(1, sizeof(ThreadBuffers));
+        if (buffers == NULL) return NULL;
+        pthread_setspecific(thread_buffers_key, buffers);
+    }
+    return buffers;
+}
+
+static unsigned char* scratch_reserve(Scratch* scratch, size_t min_cap) {
+    if (scratch->cap < min_cap) {
+        unsigned char* grown = (unsigned char*)realloc(scratch->data, min_cap);
+        if (grown == NULL) return NULL;
+        count_native_allocation(scratch->cap, min_cap);
+        scratch->data = grown;
+        scratch->cap = min_cap;
+    }
+    return scratch->data;
+}
+
+// Returns this thread's output scratch with room for at least min_cap bytes, or NULL.
+static unsigned char* scratch_acquire(size_t min_cap, size_t* cap) {
+    atomic_fetch_add(&jni_scratch_acquires, 1);
+    ThreadBuffers* buffers = thread_buffers();
+    if (buffers == NULL) return NULL;
+
+    if (min_cap < SCRATCH_INITIAL) min_cap = SCRATCH_INITIAL;
+    unsigned char* data = scratch_reserve(&buffers->out, min_cap);
+    *cap = buffers->out.cap;
+    return data;
+}
+
+// A byte[] argument made readable for the duration of one library call.
+typedef struct JniBytes {
+    jbyteArray array;
+    const unsigned char* data;
+    size_t len;
+    bool critical;
+} JniBytes;
+
+// Valid non-NULL pointer for empty arrays; the library rejects NULL even with len 0
+static const unsigned char empty_bytes[1] = {0};
+
+// bounded: the library call neither blocks (network, disk) nor re-enters JNI, so
+// large arrays may be pinned with GetPrimitiveArrayCritical instead of copied.
+// Otherwise the bytes are copied into pooled slot `slot` with GetByteArrayRegion.
+// A pinned array opens a critical region, so a bounded get must be the last JNI
+// call before the library call; at most one per wrapper.
+static bool jni_bytes_get(JNIEnv* env, jbyteArray array, int slot, bool bounded, JniBytes* out) {
+    out->array = array;
+    out->critical = false;
+    out->len = (size_t)(*env)->GetArrayLength(env, array);
+    if (out->len == 0) {
+        out->data = empty_bytes;
+        return true;
+    }
+
+    if (bounded && out->len >= JNI_CRITICAL_MIN_BYTES) {
+        out->data = (const unsigned char*)(*env)->GetPrimitiveArrayCritical(env, array, NULL);
+        out->critical = true;
+        return out->data != NULL;
+    }
+
+    atomic_fetch_add(&jni_scratch_acquires, 1);
+    ThreadBuffers* buffers = thread_buffers();
+    unsigned char* copy = buffers != NULL ? scratch_reserve(&buffers->args[slot], out->len) : NULL;
+    if (copy == NULL) {
+        out->data = NULL;
+        return false;
+    }
+    (*env)->GetByteArrayRegion(env, array, 0, (jsize)out->len, (jbyte*)copy);
+    out->data = copy;
+    return true;
+}
+
+static void jni_bytes_release(JNIEnv* env, JniBytes* bytes) {
+    if (bytes->critical && bytes->data != NULL) {
+        (*env)->ReleasePrimitiveArrayCritical(env, bytes->array, (void*)bytes->data, JNI_ABORT);
+    }
+    bytes->data = NULL;
+    bytes->critical = false;
+}
+
+// Most messages staged per cabi_node_dequeue_messages call
+#define RX_BATCH_MAX 64
+#define RX_ARENA_INITIAL (64 * 1024)
+
+// Per-node JNI state, registered when a node is created and dropped in cabiNodeFree.
+typedef struct NodeState {
+    void* handle;
+    struct NodeState* next;
+    // Guarded by node_states_lock: calls using the state, and whether the node is being freed
+    int users;
+    bool released;
+
+    // Inbound messages staged by one batched dequeue and handed out one by one
+    pthread_mutex_t rx_lock;
+    unsigned char* rx_arena;
+    size_t rx_arena_cap;
+    size_t rx_offsets[RX_BATCH_MAX];
+    size_t rx_lengths[RX_BATCH_MAX];
+    size_t rx_count;
+    size_t rx_next;
+} NodeState;
+
+static pthread_mutex_t node_states_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t node_states_idle = PTHREAD_COND_INITIALIZER;
+static NodeState* node_states = NULL;
+
+// Called once per node created through these wrappers. On allocation failure the
+// node still works; its dequeues just skip the staged batch path.
+static void node_state_register(void* handle) {
+    if (handle == NULL) return;
+    NodeState* state = (NodeState*)calloc(1, sizeof(NodeState));
+    if (state == NULL) return;
+    state->handle = handle;
+    pthread_mutex_init(&state->rx_lock, NULL);
+
+    pthread_mutex_lock(&node_states_lock);
+    state->next = node_states;
+    node_states = state;
+    pthread_mutex_unlock(&node_states_lock);
+}
 
-// Forward declarations of C-ABI functions from Rust library
-// These will be linked from libcabi_rust_libp2p.so
-
-extern int cabi_init_tracing(void);
-extern int cabi_autonat_status(void* handle);
-extern int cabi_identity_load_or_create(
-    const char* profile_path,
-    char* account_id_buffer,
-    size_t account_id_buffer_len,
-    size_t* account_id_written_len,
-    char* device_id_buffer,
-    size_t device_id_buffer_len,
-    size_t* device_id_written_len,
-    unsigned char* libp2p_seed_buffer,
-    size_t libp2p_seed_buffer_len,
-    unsigned char* signal_identity_seed_buffer,
-    size_t signal_identity_seed_buffer_len
-);
-
-extern void* cabi_node_new(
-    bool use_quic,
-    bool enable_relay_hop,
-    const char** bootstrap_peers,
-    size_t bootstrap_peers_len,
-    const unsigned char* identity_seed_ptr,
-    size_t identity_seed_len
-);
-extern int cabi_node_local_peer_id(void* handle, char* out_buffer, size_t buffer_len, size_t* written_len);
-extern int cabi_node_listen(void* handle, const char* address);
-extern int cabi_node_dial(void* handle, const char* address);
-extern int cabi_node_find_peer(void* handle, const char* peer_id, unsigned long long* request_id);
-extern int cabi_node_get_closest_peers(void* handle, const char* peer_id, unsigned long long* request_id);
-extern int cabi_node_dht_put_record(
-    void* handle,
-    const unsigned char* key_ptr,
-    size_t key_len,
-    const unsigned char* value_ptr,
-    size_t value_len,
-    unsigned long long ttl_seconds
-);
-extern int cabi_node_dht_get_record(
-    void* handle,
-    const unsigned char* key_ptr,
-    size_t key_len,
-    unsigned char* out_buffer,
-    size_t buffer_len,
-    size_t* written_len
-);
-extern int cabi_node_enqueue_message(void* handle, const unsigned char* data, size_t data_len);
-extern int cabi_node_dequeue_message(void* handle, unsigned char* out_buffer, size_t buffer_len, size_t* written_len);
-extern int cabi_node_dequeue_discovery_event(void* handle,
-                                            int* event_kind,
-                                            unsigned long long* request_id,
-                                            int* status_code,
-                                            char* peer_id_buffer,
-                                            size_t peer_id_buffer_len,
-                                            size_t* peer_id_written_len,
-                                            char* address_buffer,
-                                            size_t address_buffer_len,
-                                            size_t* address_written_len);
-extern void cabi_node_free(void* handle);
-
-#define CABI_STATUS_QUEUE_EMPTY (-1)
-
-extern int cabi_e2ee_build_prekey_bundle(
-    const char* profile_path,
-    size_t one_time_prekey_count,
-    unsigned long long ttl_seconds,
-    unsigned char* out_buffer,
-    size_t out_buffer_len,
-    size_t* written_len
-);
-extern int cabi_e2ee_validate_prekey_bundle(
-    const unsigned char* payload_ptr,
-    size_t payload_len,
-    unsigned long long now_unix
-);
-extern int cabi_e2ee_build_message_auto(
-    const char* profile_path,
-    const unsigned char* recipient_prekey_bundle_ptr,
-    size_t recipient_prekey_bundle_len,
-    const unsigned char* plaintext_ptr,
-    size_t plaintext_len,
-    const unsigned char* aad_ptr,
-    size_t aad_len,
-    unsigned char* out_buffer,
-    size_t out_buffer_len,
-    size_t* written_len
-);
-extern int cabi_e2ee_decrypt_message_auto(
-    const char* profile_path,
-    const unsigned char* payload_ptr,
-    size_t payload_len,
-    unsigned char* out_plaintext_buffer,
-    size_t out_plaintext_buffer_len,
-    size_t* written_len,
-    int* message_kind
-);
+// Pins the state of a live node until node_state_put; NULL for unknown or freed handles
+static NodeState* node_state_get(void* handle) {
+    pthread_mutex_lock(&node_states_lock);
+    NodeState* state = node_states;
+    while (state != NULL && state->handle != handle) {
+        state = state->next;
+    }
+    if (state != NULL && state->released) state = NULL;
+    if (state != NULL) state->users++;
+    pthread_mutex_unlock(&node_states_lock);
+    return state;
+}
+
+static void node_state_put(NodeState* state) {
+    pthread_mutex_lock(&node_states_lock);
+    if (--state->users == 0 && state->released) {
+        pthread_cond_broadcast(&node_states_idle);
+    }
+    pthread_mutex_unlock(&node_states_lock);
+}
+
+// New lookups fail from here on; calls already using the state finish first, so
+// the node can be freed right after this returns
+static void node_state_release(void* handle) {
+    pthread_mutex_lock(&node_states_lock);
+    NodeState** link = &node_states;
+    while (*link != NULL && (*link)->handle != handle) {
+        link = &(*link)->next;
+    }
+    NodeState* state = *link;
+    if (state != NULL) {
+        state->released = true;
+        while (state->users > 0) {
+            pthread_cond_wait(&node_states_idle, &node_states_lock);
+        }
+        // Re-walk: other nodes may have been registered or released while waiting
+        link = &node_states;
+        while (*link != state) {
+            link = &(*link)->next;
+        }
+        *link = state->next;
+    }
+    pthread_mutex_unlock(&node_states_lock);
+
+    if (state == NULL) return;
+    pthread_mutex_destroy(&state->rx_lock);
+    atomic_fetch_sub(&jni_native_bytes_reserved, (long long)state->rx_arena_cap);
+    free(state->rx_arena);
+    free(state);
+}
+
+// Returns the next staged inbound message, refilling the stage with a single
+// batched dequeue once it runs dry. Caller holds state->rx_lock.
+static int node_rx_next(NodeState* state, const unsigned char** data, size_t* len) {
+    if (state->rx_next >= state->rx_count) {
+        state->rx_count = 0;
+        state->rx_next = 0;
+        if (state->rx_arena == NULL) {
+            state->rx_arena = (unsigned char*)malloc(RX_ARENA_INITIAL);
+            if (state->rx_arena == NULL) return CABI_STATUS_INTERNAL_ERROR;
+            count_native_allocation(0, RX_ARENA_INITIAL);
+            state->rx_arena_cap = RX_ARENA_INITIAL;
+        }
+
+        for (;;) {
+            size_t count = 0;
+            int status = cabi_node_dequeue_messages(
+                state->handle,
+                state->rx_arena, state->rx_arena_cap,
+                state->rx_offsets, state->rx_lengths,
+                RX_BATCH_MAX, &count
+            );
+            if (status == CABI_STATUS_BUFFER_TOO_SMALL) {
+                // Head message alone exceeds the arena; rx_lengths[0] is its size
+                size_t cap = state->rx_arena_cap * 2;
+                if (cap < state->rx_lengths[0]) cap = state->rx_lengths[0];
+                unsigned char* grown = (unsigned char*)realloc(state->rx_arena, cap);
+                if (grown == NULL) return CABI_STATUS_INTERNAL_ERROR;
+                count_native_allocation(state->rx_arena_cap, cap);
+                state->rx_arena = grown;
+                state->rx_arena_cap = cap;
+                continue;
+            }
+            if (status != 0) return status;
+            state->rx_count = count;
+            break;
+        }
+        if (state->rx_count == 0) return CABI_STATUS_QUEUE_EMPTY;
+    }
+
+    *data = state->rx_arena + state->rx_offsets[state->rx_next];
+    *len = state->rx_lengths[state->rx_next];
+    state->rx_next++;
+    return 0;
+}
+
+#define LOG_TAG "libp2p_jni"
+
+// Result classes and constructors, resolved once in JNI_OnLoad and pinned with
+// global refs so the wrappers never pay for FindClass/GetMethodID per call
+typedef struct JniClassCache {
+    jclass identity_profile;
+    jmethodID identity_profile_ctor;
+    jclass discovery_event;
+    jmethodID discovery_event_ctor;
+    jclass decrypted_message;
+    jmethodID decrypted_message_ctor;
+    jclass decrypted_batch;
+    jmethodID decrypted_batch_ctor;
+    jclass dht_result;
+    jmethodID dht_result_ctor;
+    jclass node_event;
+    jmethodID node_event_ctor;
+    jclass dial_result;
+    jmethodID dial_result_ctor;
+    jclass byte_array;
+} JniClassCache;
+
+static JniClassCache jni_classes;
+
+static bool cache_class(JNIEnv* env, const char* name, const char* ctor_sig, jclass* cls, jmethodID* ctor) {
+    jclass local = (*env)->FindClass(env, name);
+    if (local == NULL) {
+        (*env)->ExceptionClear(env);
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "JNI_OnLoad: class %s not found", name);
+        return false;
+    }
+    *ctor = (*env)->GetMethodID(env, local, "<init>", ctor_sig);
+    if (*ctor == NULL) {
+        (*env)->ExceptionClear(env);
+        (*env)->DeleteLocalRef(env, local);
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "JNI_OnLoad: %s has no constructor %s", name, ctor_sig);
+        return false;
+    }
+    *cls = (jclass)(*env)->NewGlobalRef(env, local);
+    (*env)->DeleteLocalRef(env, local);
+    return *cls != NULL;
+}
+
+static void release_class_cache(JNIEnv* env) {
+    if (jni_classes.identity_profile != NULL) (*env)->DeleteGlobalRef(env, jni_classes.identity_profile);
+    if (jni_classes.discovery_event != NULL) (*env)->DeleteGlobalRef(env, jni_classes.discovery_event);
+    if (jni_classes.decrypted_message != NULL) (*env)->DeleteGlobalRef(env, jni_classes.decrypted_message);
+    if (jni_classes.decrypted_batch != NULL) (*env)->DeleteGlobalRef(env, jni_classes.decrypted_batch);
+    if (jni_classes.dht_result != NULL) (*env)->DeleteGlobalRef(env, jni_classes.dht_result);
+    if (jni_classes.node_event != NULL) (*env)->DeleteGlobalRef(env, jni_classes.node_event);
+    if (jni_classes.dial_result != NULL) (*env)->DeleteGlobalRef(env, jni_classes.dial_result);
+    if (jni_classes.byte_array != NULL) (*env)->DeleteGlobalRef(env, jni_classes.byte_array);
+    memset(&jni_classes, 0, sizeof(jni_classes));
+}
+
+// A missing class or constructor fails System.loadLibrary instead of every call
+JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM* vm, void* reserved) {
+    JNIEnv* env = NULL;
+    if ((*vm)->GetEnv(vm, (void**)&env, JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+
+    bool ok =
+        cache_class(env, "com/fidonext/messenger/rust/Libp2pNative$IdentityProfile",
+                    "(Ljava/lang/String;Ljava/lang/String;[B[B)V",
+                    &jni_classes.identity_profile, &jni_classes.identity_profile_ctor) &&
+        /* (eventKind: Int, requestId: Long, statusCode: Int, peerId: String, address: String) */
+        cache_class(env, "com/fidonext/messenger/rust/Libp2pNative$DiscoveryEvent",
+                    "(IJILjava/lang/String;Ljava/lang/String;)V",
+                    &jni_classes.discovery_event, &jni_classes.discovery_event_ctor) &&
+        cache_class(env, "com/fidonext/messenger/rust/Libp2pNative$DecryptedE2eeMessage",
+                    "(I[B)V",
+                    &jni_classes.decrypted_message, &jni_classes.decrypted_message_ctor) &&
+        cache_class(env, "com/fidonext/messenger/rust/Libp2pNative$DecryptedE2eeBatch",
+                    "([I[I[[B)V",
+                    &jni_classes.decrypted_batch, &jni_classes.decrypted_batch_ctor) &&
+        /* (requestId: Long, op: Int, status: Int, value: ByteArray?) */
+        cache_class(env, "com/fidonext/messenger/rust/Libp2pNative$DhtResult",
+                    "(JII[B)V",
+                    &jni_classes.dht_result, &jni_classes.dht_result_ctor) &&
+        /* (kind: Int, timestampNs: Long, value: Long, peerId: String, text: String) */
+        cache_class(env, "com/fidonext/messenger/rust/Libp2pNative$NodeEvent",
+                    "(IJJLjava/lang/String;Ljava/lang/String;)V",
+                    &jni_classes.node_event, &jni_classes.node_event_ctor) &&
+        /* (status: Int, transport: Int, connectMicros: Long, address: String) */
+        cache_class(env, "com/fidonext/messenger/rust/Libp2pNative$DialResult",
+                    "(IIJLjava/lang/String;)V",
+                    &jni_classes.dial_result, &jni_classes.dial_result_ctor);
+    if (ok) {
+        jclass local = (*env)->FindClass(env, "[B");
+        jni_classes.byte_array = local != NULL ? (jclass)(*env)->NewGlobalRef(env, local) : NULL;
+        if (local != NULL) (*env)->DeleteLocalRef(env, local);
+        ok = jni_classes.byte_array != NULL;
+    }
+    if (!ok) {
+        release_class_cache(env);
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_6;
+}
+
+JNIEXPORT void JNICALL
+JNI_OnUnload(JavaVM* vm, void* reserved) {
+    JNIEnv* env = NULL;
+    if ((*vm)->GetEnv(vm, (void**)&env, JNI_VERSION_1_6) == JNI_OK) {
+        release_class_cache(env);
+    }
+}
 
 static jbyteArray make_jbyte_array(JNIEnv* env, const unsigned char* data, size_t len) {
     if (data == NULL || len == 0) {
@@ -156,9 +495,40 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeNew(JNIEnv *env, jobject o
         free(peers);
     }
 
+    node_state_register(handle);
     return (jlong)handle;
 }
 
+// Pins every bootstrap multiaddr as UTF-8; release with release_peer_strings.
+// Returns false only on allocation failure.
+static bool get_peer_strings(JNIEnv *env, jobjectArray bootstrapPeers, const char*** out_peers, int* out_count) {
+    *out_peers = NULL;
+    *out_count = 0;
+    if (bootstrapPeers == NULL) return true;
+
+    int peer_count = (*env)->GetArrayLength(env, bootstrapPeers);
+    const char** peers = (const char**)malloc(peer_count * sizeof(char*));
+    if (peers == NULL) return false;
+    for (int i = 0; i < peer_count; i++) {
+        jstring peer_str = (jstring)(*env)->GetObjectArrayElement(env, bootstrapPeers, i);
+        peers[i] = (*env)->GetStringUTFChars(env, peer_str, NULL);
+        (*env)->DeleteLocalRef(env, peer_str);
+    }
+    *out_peers = peers;
+    *out_count = peer_count;
+    return true;
+}
+
+static void release_peer_strings(JNIEnv *env, jobjectArray bootstrapPeers, const char** peers, int peer_count) {
+    if (peers == NULL) return;
+    for (int i = 0; i < peer_count; i++) {
+        jstring peer_str = (jstring)(*env)->GetObjectArrayElement(env, bootstrapPeers, i);
+        (*env)->ReleaseStringUTFChars(env, peer_str, peers[i]);
+        (*env)->DeleteLocalRef(env, peer_str);
+    }
+    free(peers);
+}
+
 JNIEXPORT jlong JNICALL
 Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeNewWithSeed(JNIEnv *env, jobject obj,
                                                                   jboolean useQuic,
@@ -167,27 +537,14 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeNewWithSeed(JNIEnv *env, j
                                                                   jbyteArray identitySeed) {
     int peer_count = 0;
     const char** peers = NULL;
-
-    if (bootstrapPeers != NULL) {
-        peer_count = (*env)->GetArrayLength(env, bootstrapPeers);
-        peers = (const char**)malloc(peer_count * sizeof(char*));
-        if (peers == NULL) return 0;
-        for (int i = 0; i < peer_count; i++) {
-            jstring peer_str = (jstring)(*env)->GetObjectArrayElement(env, bootstrapPeers, i);
-            peers[i] = (*env)->GetStringUTFChars(env, peer_str, NULL);
-        }
-    }
+    if (!get_peer_strings(env, bootstrapPeers, &peers, &peer_count)) return 0;
 
     const unsigned char* seed_ptr = NULL;
     size_t seed_len = 0;
-    jbyte* seed_bytes = NULL;
-    if (identitySeed != NULL) {
-        jsize len = (*env)->GetArrayLength(env, identitySeed);
-        if (len > 0) {
-            seed_len = (size_t)len;
-            seed_bytes = (*env)->GetByteArrayElements(env, identitySeed, NULL);
-            seed_ptr = (const unsigned char*)seed_bytes;
-        }
+    JniBytes seed = {0};
+    if (identitySeed != NULL && jni_bytes_get(env, identitySeed, 0, false, &seed) && seed.len > 0) {
+        seed_ptr = seed.data;
+        seed_len = seed.len;
     }
 
     void* handle = cabi_node_new(
@@ -199,18 +556,77 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeNewWithSeed(JNIEnv *env, j
         seed_len
     );
 
-    if (seed_bytes != NULL) {
-        (*env)->ReleaseByteArrayElements(env, identitySeed, seed_bytes, JNI_ABORT);
+    jni_bytes_release(env, &seed);
+    release_peer_strings(env, bootstrapPeers, peers, peer_count);
+
+    node_state_register(handle);
+    return (jlong)handle;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeNewWithConfig(JNIEnv *env, jobject obj,
+                                                                    jboolean useQuic,
+                                                                    jboolean enableRelayHop,
+                                                                    jobjectArray bootstrapPeers,
+                                                                    jbyteArray identitySeed,
+                                                                    jlongArray tuning) {
+    jlong slots[NODE_CONFIG_SLOTS] = {0};
+    if (tuning != NULL) {
+        jsize len = (*env)->GetArrayLength(env, tuning);
+        if (len > NODE_CONFIG_SLOTS) len = NODE_CONFIG_SLOTS;
+        (*env)->GetLongArrayRegion(env, tuning, 0, len, slots);
     }
 
-    if (peers != NULL) {
-        for (int i = 0; i < peer_count; i++) {
-            jstring peer_str = (jstring)(*env)->GetObjectArrayElement(env, bootstrapPeers, i);
-            (*env)->ReleaseStringUTFChars(env, peer_str, peers[i]);
-        }
-        free(peers);
+    int peer_count = 0;
+    const char** peers = NULL;
+    if (!get_peer_strings(env, bootstrapPeers, &peers, &peer_count)) return 0;
+
+    JniBytes seed = {0};
+    bool has_seed = identitySeed != NULL && jni_bytes_get(env, identitySeed, 0, false, &seed) && seed.len > 0;
+
+    void* handle;
+    if (cabi_node_new_with_config != NULL) {
+        CabiNodeConfig config;
+        memset(&config, 0, sizeof(config));
+        config.struct_size = sizeof(config);
+        config.use_quic = (bool)useQuic;
+        config.enable_relay_hop = (bool)enableRelayHop;
+        config.bootstrap_peers = peers;
+        config.bootstrap_peers_len = (size_t)peer_count;
+        config.identity_seed_ptr = has_seed ? seed.data : NULL;
+        config.identity_seed_len = has_seed ? seed.len : 0;
+        config.message_queue_capacity = (size_t)slots[NODE_CONFIG_MESSAGE_QUEUE_CAPACITY];
+        config.discovery_queue_capacity = (size_t)slots[NODE_CONFIG_DISCOVERY_QUEUE_CAPACITY];
+        config.overflow_policy = (int)slots[NODE_CONFIG_OVERFLOW_POLICY];
+        config.block_timeout_ms = (uint32_t)slots[NODE_CONFIG_BLOCK_TIMEOUT_MS];
+        config.max_established_connections = (uint32_t)slots[NODE_CONFIG_MAX_CONNECTIONS];
+        config.max_connections_per_peer = (uint32_t)slots[NODE_CONFIG_MAX_CONNECTIONS_PER_PEER];
+        config.max_pending_incoming = (uint32_t)slots[NODE_CONFIG_MAX_PENDING_INCOMING];
+        config.max_pending_outgoing = (uint32_t)slots[NODE_CONFIG_MAX_PENDING_OUTGOING];
+        config.idle_connection_timeout_ms = (uint64_t)slots[NODE_CONFIG_IDLE_TIMEOUT_MS];
+        config.yamux_max_receive_window = (uint32_t)slots[NODE_CONFIG_YAMUX_WINDOW];
+        config.kad_parallelism = (uint32_t)slots[NODE_CONFIG_KAD_ALPHA];
+        config.kad_replication_factor = (uint32_t)slots[NODE_CONFIG_KAD_REPLICATION];
+        config.worker_threads = (uint32_t)slots[NODE_CONFIG_WORKER_THREADS];
+        handle = cabi_node_new_with_config(&config);
+    } else {
+        // Older library: same node, library defaults for every tuning knob
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG,
+                            "cabi_node_new_with_config missing; node tuning ignored");
+        handle = cabi_node_new(
+            (bool)useQuic,
+            (bool)enableRelayHop,
+            peers,
+            (size_t)peer_count,
+            has_seed ? seed.data : NULL,
+            has_seed ? seed.len : 0
+        );
     }
 
+    jni_bytes_release(env, &seed);
+    release_peer_strings(env, bootstrapPeers, peers, peer_count);
+
+    node_state_register(handle);
     return (jlong)handle;
 }
 
@@ -246,11 +662,6 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiIdentityLoadOrCreate(JNIEnv *e
         return NULL;
     }
 
-    jclass cls = (*env)->FindClass(env, "com/fidonext/messenger/rust/Libp2pNative$IdentityProfile");
-    if (cls == NULL) return NULL;
-    jmethodID ctor = (*env)->GetMethodID(env, cls, "<init>", "(Ljava/lang/String;Ljava/lang/String;[B[B)V");
-    if (ctor == NULL) return NULL;
-
     jstring accountId = (*env)->NewStringUTF(env, account_buf);
     jstring deviceId = (*env)->NewStringUTF(env, device_buf);
     jbyteArray libp2pSeed = make_jbyte_array(env, libp2p_seed, sizeof(libp2p_seed));
@@ -260,7 +671,8 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiIdentityLoadOrCreate(JNIEnv *e
         return NULL;
     }
 
-    return (*env)->NewObject(env, cls, ctor, accountId, deviceId, libp2pSeed, signalSeed);
+    return (*env)->NewObject(env, jni_classes.identity_profile, jni_classes.identity_profile_ctor,
+                             accountId, deviceId, libp2pSeed, signalSeed);
 }
 
 JNIEXPORT jstring JNICALL
@@ -275,6 +687,33 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeLocalPeerId(JNIEnv *env, j
     return NULL;
 }
 
+JNIEXPORT jstring JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeMetricsSnapshot(JNIEnv *env, jobject obj, jlong handle) {
+    if (handle == 0 || cabi_node_metrics_snapshot == NULL) return NULL;
+
+    size_t cap = 0;
+    unsigned char* buffer = scratch_acquire(0, &cap);
+    size_t written_len = 0;
+    int status = CABI_STATUS_INTERNAL_ERROR;
+
+    // One byte kept back for the terminator NewStringUTF needs
+    for (int attempt = 0; buffer != NULL && attempt < SCRATCH_MAX_ATTEMPTS; attempt++) {
+        written_len = 0;
+        status = cabi_node_metrics_snapshot((void*)handle, (char*)buffer, cap - 1, &written_len);
+        if (status == CABI_STATUS_BUFFER_TOO_SMALL && written_len >= cap) {
+            buffer = scratch_acquire(written_len + 1, &cap);
+            continue;
+        }
+        break;
+    }
+
+    if (buffer == NULL || status != 0 || written_len >= cap) {
+        return NULL;
+    }
+    buffer[written_len] = '\0';
+    return (*env)->NewStringUTF(env, (const char*)buffer);
+}
+
 JNIEXPORT jint JNICALL
 Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeListen(JNIEnv *env, jobject obj, 
                                                               jlong handle, jstring address) {
@@ -284,6 +723,39 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeListen(JNIEnv *env, jobjec
     return result;
 }
 
+JNIEXPORT jboolean JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodePeerStoreIsNative(JNIEnv *env, jobject obj) {
+    return cabi_node_save_peer_store != NULL && cabi_node_load_peer_store != NULL;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeSavePeerStore(JNIEnv *env, jobject obj,
+                                                                    jlong handle, jstring path) {
+    if (handle == 0 || path == NULL) return 1;
+    if (cabi_node_save_peer_store == NULL) return CABI_STATUS_INTERNAL_ERROR;
+    const char* path_chars = (*env)->GetStringUTFChars(env, path, NULL);
+    if (path_chars == NULL) return 1;
+    size_t peers = 0;
+    int result = cabi_node_save_peer_store((void*)handle, path_chars, &peers);
+    (*env)->ReleaseStringUTFChars(env, path, path_chars);
+    if (result == 0) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, "Saved %zu peers to the peer store", peers);
+    return result;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeLoadPeerStore(JNIEnv *env, jobject obj,
+                                                                    jlong handle, jstring path) {
+    if (handle == 0 || path == NULL) return 1;
+    if (cabi_node_load_peer_store == NULL) return CABI_STATUS_INTERNAL_ERROR;
+    const char* path_chars = (*env)->GetStringUTFChars(env, path, NULL);
+    if (path_chars == NULL) return 1;
+    size_t peers = 0;
+    int result = cabi_node_load_peer_store((void*)handle, path_chars, &peers);
+    (*env)->ReleaseStringUTFChars(env, path, path_chars);
+    if (result == 0) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, "Loaded %zu peers from the peer store", peers);
+    return result;
+}
+
 JNIEXPORT jint JNICALL
 Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDial(JNIEnv *env, jobject obj,
                                                             jlong handle, jstring address) {
@@ -293,11 +765,87 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDial(JNIEnv *env, jobject
     return result;
 }
 
+JNIEXPORT jboolean JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDialPeerIsNative(JNIEnv *env, jobject obj) {
+    return cabi_node_dial_peer != NULL;
+}
+
+static int transport_of_multiaddr(const char* addr) {
+    if (strstr(addr, "/p2p-circuit") != NULL) return CABI_TRANSPORT_RELAY;
+    if (strstr(addr, "/quic") != NULL) return CABI_TRANSPORT_QUIC;
+    return CABI_TRANSPORT_TCP;
+}
+
+// Without the racing ABI every address is dialed, as before. cabi_node_dial only
+// starts a dial, so the result names the first address started and reports the
+// time to connect as -1 (unknown).
+JNIEXPORT jobject JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDialPeer(JNIEnv *env, jobject obj,
+                                                                jlong handle, jstring peerId,
+                                                                jobjectArray addrs, jlong timeoutMs) {
+    if (handle == 0 || peerId == NULL || addrs == NULL) return NULL;
+
+    int addr_count = 0;
+    const char** addr_chars = NULL;
+    if (!get_peer_strings(env, addrs, &addr_chars, &addr_count)) return NULL;
+
+    int status = CABI_STATUS_INVALID_ARGUMENT;
+    int transport = CABI_TRANSPORT_EXISTING;
+    uint64_t connect_us = 0;
+    int connect_unknown = 0;
+    char winner_buf[1024];
+    size_t winner_written = 0;
+    memset(winner_buf, 0, sizeof(winner_buf));
+
+    if (cabi_node_dial_peer != NULL) {
+        const char* peer_id = (*env)->GetStringUTFChars(env, peerId, NULL);
+        if (peer_id != NULL) {
+            status = cabi_node_dial_peer(
+                (void*)handle,
+                peer_id,
+                addr_chars,
+                (size_t)addr_count,
+                timeoutMs > 0 ? (unsigned long long)timeoutMs : 0,
+                &transport,
+                &connect_us,
+                winner_buf,
+                sizeof(winner_buf) - 1,
+                &winner_written
+            );
+            (*env)->ReleaseStringUTFChars(env, peerId, peer_id);
+        }
+    } else {
+        connect_unknown = 1;
+        for (int i = 0; i < addr_count; i++) {
+            int dial_status = cabi_node_dial((void*)handle, addr_chars[i]);
+            if (dial_status != 0) {
+                if (status != 0) status = dial_status;
+                continue;
+            }
+            if (status != 0) {
+                transport = transport_of_multiaddr(addr_chars[i]);
+                strncpy(winner_buf, addr_chars[i], sizeof(winner_buf) - 1);
+            }
+            status = 0;
+        }
+    }
+
+    release_peer_strings(env, addrs, addr_chars, addr_count);
+
+    jstring winner = (*env)->NewStringUTF(env, status == 0 ? winner_buf : "");
+    if (winner == NULL) winner = (*env)->NewStringUTF(env, "");
+    return (*env)->NewObject(env, jni_classes.dial_result, jni_classes.dial_result_ctor,
+                             (jint)status,
+                             (jint)transport,
+                             connect_unknown ? (jlong)-1 : (jlong)connect_us,
+                             winner);
+}
+
 JNIEXPORT jlong JNICALL
 Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeFindPeer(JNIEnv *env, jobject obj,
                                                                 jlong handle, jstring peerId) {
     const char* peer_id = (*env)->GetStringUTFChars(env, peerId, NULL);
-    unsigned long long request_id = 0;
+    uint64_t request_id = 0;
     int status = cabi_node_find_peer((void*)handle, peer_id, &request_id);
     (*env)->ReleaseStringUTFChars(env, peerId, peer_id);
     return (status == 0) ? (jlong)request_id : 0;
@@ -307,7 +855,7 @@ JNIEXPORT jlong JNICALL
 Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeGetClosestPeers(JNIEnv *env, jobject obj,
                                                                         jlong handle, jstring peerId) {
     const char* peer_id = (*env)->GetStringUTFChars(env, peerId, NULL);
-    unsigned long long request_id = 0;
+    uint64_t request_id = 0;
     int status = cabi_node_get_closest_peers((void*)handle, peer_id, &request_id);
     (*env)->ReleaseStringUTFChars(env, peerId, peer_id);
     return (status == 0) ? (jlong)request_id : 0;
@@ -316,17 +864,33 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeGetClosestPeers(JNIEnv *en
 JNIEXPORT jint JNICALL
 Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeEnqueueMessage(JNIEnv *env, jobject obj,
                                                                       jlong handle, jbyteArray message) {
-    jsize len = (*env)->GetArrayLength(env, message);
-    jbyte* bytes = (*env)->GetByteArrayElements(env, message, NULL);
-    
-    int result = cabi_node_enqueue_message((void*)handle, (unsigned char*)bytes, len);
-    
-    (*env)->ReleaseByteArrayElements(env, message, bytes, JNI_ABORT);
+    // Always copied: under CABI_OVERFLOW_BLOCK the enqueue can wait up to
+    // block_timeout_ms, far too long to hold a critical region and stall the GC
+    JniBytes bytes;
+    if (!jni_bytes_get(env, message, 0, false, &bytes)) return 1;
+
+    int result = cabi_node_enqueue_message((void*)handle, bytes.data, bytes.len);
+
+    jni_bytes_release(env, &bytes);
     return result;
 }
 
 JNIEXPORT jbyteArray JNICALL
 Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueMessage(JNIEnv *env, jobject obj, jlong handle) {
+    NodeState* state = cabi_node_dequeue_messages != NULL ? node_state_get((void*)handle) : NULL;
+    if (state != NULL) {
+        pthread_mutex_lock(&state->rx_lock);
+        const unsigned char* data = NULL;
+        size_t len = 0;
+        jbyteArray result = NULL;
+        if (node_rx_next(state, &data, &len) == 0) {
+            result = make_jbyte_array(env, data, len);
+        }
+        pthread_mutex_unlock(&state->rx_lock);
+        node_state_put(state);
+        return result;
+    }
+
     unsigned char buffer[65536]; // 64KB buffer
     size_t written_len = 0;
 
@@ -341,12 +905,50 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueMessage(JNIEnv *env
     return NULL;
 }
 
-JNIEXPORT jobject JNICALL
-Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueDiscoveryEvent(JNIEnv *env, jobject obj, jlong handle) {
+// Dequeues into a caller-owned direct ByteBuffer (from index 0) without a Java allocation.
+// Returns the message length, -1 when the queue is empty or on error, and the negated
+// required length when the buffer is too small (the message then stays queued).
+JNIEXPORT jint JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueMessageDirect(JNIEnv *env, jobject obj,
+                                                                            jlong handle, jobject buffer) {
+    if (handle == 0 || buffer == NULL) return -1;
+    unsigned char* address = (unsigned char*)(*env)->GetDirectBufferAddress(env, buffer);
+    jlong capacity = (*env)->GetDirectBufferCapacity(env, buffer);
+    if (address == NULL || capacity <= 0) return -1;
+
+    NodeState* state = cabi_node_dequeue_messages != NULL ? node_state_get((void*)handle) : NULL;
+    if (state != NULL) {
+        pthread_mutex_lock(&state->rx_lock);
+        const unsigned char* data = NULL;
+        size_t len = 0;
+        jint result = -1;
+        if (node_rx_next(state, &data, &len) == 0) {
+            if (len > (size_t)capacity) {
+                state->rx_next--;
+                result = -(jint)len;
+            } else {
+                memcpy(address, data, len);
+                result = (jint)len;
+            }
+        }
+        pthread_mutex_unlock(&state->rx_lock);
+        node_state_put(state);
+        return result;
+    }
+
+    size_t written_len = 0;
+    int status = cabi_node_dequeue_message((void*)handle, address, (size_t)capacity, &written_len);
+    if (status == 0) return (jint)written_len;
+    if (status == CABI_STATUS_BUFFER_TOO_SMALL && written_len > (size_t)capacity) return -(jint)written_len;
+    return -1;
+}
+
+// Waits up to timeout_ms when the library can block; otherwise (or with 0) polls once
+static jobject dequeue_discovery_event(JNIEnv *env, jlong handle, unsigned long long timeout_ms) {
     if (handle == 0) return NULL;
 
     int event_kind = 0;
-    unsigned long long request_id = 0;
+    uint64_t request_id = 0;
     int status_code = 0;
     char peer_id_buf[256];
     char address_buf[1024];
@@ -356,18 +958,35 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueDiscoveryEvent(JNIE
     memset(peer_id_buf, 0, sizeof(peer_id_buf));
     memset(address_buf, 0, sizeof(address_buf));
 
-    int status = cabi_node_dequeue_discovery_event(
-        (void*)handle,
-        &event_kind,
-        &request_id,
-        &status_code,
-        peer_id_buf,
-        sizeof(peer_id_buf),
-        &peer_id_written,
-        address_buf,
-        sizeof(address_buf),
-        &address_written
-    );
+    int status;
+    if (timeout_ms > 0 && cabi_node_dequeue_discovery_event_timeout != NULL) {
+        status = cabi_node_dequeue_discovery_event_timeout(
+            (void*)handle,
+            timeout_ms,
+            &event_kind,
+            &request_id,
+            &status_code,
+            peer_id_buf,
+            sizeof(peer_id_buf),
+            &peer_id_written,
+            address_buf,
+            sizeof(address_buf),
+            &address_written
+        );
+    } else {
+        status = cabi_node_dequeue_discovery_event(
+            (void*)handle,
+            &event_kind,
+            &request_id,
+            &status_code,
+            peer_id_buf,
+            sizeof(peer_id_buf),
+            &peer_id_written,
+            address_buf,
+            sizeof(address_buf),
+            &address_written
+        );
+    }
 
     if (status == CABI_STATUS_QUEUE_EMPTY) {
         return NULL;
@@ -376,18 +995,12 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueDiscoveryEvent(JNIE
         return NULL;
     }
 
-    jclass cls = (*env)->FindClass(env, "com/fidonext/messenger/rust/Libp2pNative$DiscoveryEvent");
-    if (cls == NULL) return NULL;
-    /* (eventKind: Int, requestId: Long, statusCode: Int, peerId: String, address: String) */
-    jmethodID ctor = (*env)->GetMethodID(env, cls, "<init>", "(IJILjava/lang/String;Ljava/lang/String;)V");
-    if (ctor == NULL) return NULL;
-
     jstring peerId = (*env)->NewStringUTF(env, peer_id_buf);
     jstring address = (*env)->NewStringUTF(env, address_buf);
     if (peerId == NULL) peerId = (*env)->NewStringUTF(env, "");
     if (address == NULL) address = (*env)->NewStringUTF(env, "");
 
-    return (*env)->NewObject(env, cls, ctor,
+    return (*env)->NewObject(env, jni_classes.discovery_event, jni_classes.discovery_event_ctor,
                              (jint)event_kind,
                              (jlong)request_id,
                              (jint)status_code,
@@ -395,6 +1008,102 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueDiscoveryEvent(JNIE
                              address);
 }
 
+JNIEXPORT jobject JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueDiscoveryEvent(JNIEnv *env, jobject obj, jlong handle) {
+    return dequeue_discovery_event(env, handle, 0);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDiscoverNeighborhoodIsNative(JNIEnv *env, jobject obj) {
+    return cabi_node_discover_neighborhood != NULL;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDiscoverNeighborhood(JNIEnv *env, jobject obj,
+                                                                          jlong handle, jobjectArray targetPeerIds,
+                                                                          jlong timeoutMs) {
+    if (handle == 0 || targetPeerIds == NULL || cabi_node_discover_neighborhood == NULL) return 0;
+
+    int target_count = 0;
+    const char** targets = NULL;
+    if (!get_peer_strings(env, targetPeerIds, &targets, &target_count)) return 0;
+
+    uint64_t request_id = 0;
+    int status = cabi_node_discover_neighborhood(
+        (void*)handle,
+        targets,
+        (size_t)target_count,
+        timeoutMs > 0 ? (unsigned long long)timeoutMs : 0,
+        &request_id
+    );
+
+    release_peer_strings(env, targetPeerIds, targets, target_count);
+    return status == 0 ? (jlong)request_id : 0;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDiscoveryWaitIsNative(JNIEnv *env, jobject obj) {
+    return cabi_node_dequeue_discovery_event_timeout != NULL;
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueDiscoveryEventTimeout(JNIEnv *env, jobject obj,
+                                                                                   jlong handle, jlong timeoutMs) {
+    return dequeue_discovery_event(env, handle, timeoutMs > 0 ? (unsigned long long)timeoutMs : 0);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeEventsIsNative(JNIEnv *env, jobject obj) {
+    return cabi_node_dequeue_node_event != NULL;
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueNodeEvent(JNIEnv *env, jobject obj,
+                                                                      jlong handle, jlong timeoutMs) {
+    if (handle == 0 || cabi_node_dequeue_node_event == NULL) return NULL;
+
+    int kind = 0;
+    uint64_t timestamp_ns = 0;
+    int64_t value = 0;
+    char peer_id_buf[256];
+    char text_buf[1024];
+    size_t peer_id_written = 0;
+    size_t text_written = 0;
+
+    memset(peer_id_buf, 0, sizeof(peer_id_buf));
+    memset(text_buf, 0, sizeof(text_buf));
+
+    // One byte short of each buffer so the strings stay NUL-terminated
+    int status = cabi_node_dequeue_node_event(
+        (void*)handle,
+        timeoutMs > 0 ? (unsigned long long)timeoutMs : 0,
+        &kind,
+        &timestamp_ns,
+        &value,
+        peer_id_buf,
+        sizeof(peer_id_buf) - 1,
+        &peer_id_written,
+        text_buf,
+        sizeof(text_buf) - 1,
+        &text_written
+    );
+    if (status != 0) {
+        return NULL;
+    }
+
+    jstring peerId = (*env)->NewStringUTF(env, peer_id_buf);
+    jstring text = (*env)->NewStringUTF(env, text_buf);
+    if (peerId == NULL) peerId = (*env)->NewStringUTF(env, "");
+    if (text == NULL) text = (*env)->NewStringUTF(env, "");
+
+    return (*env)->NewObject(env, jni_classes.node_event, jni_classes.node_event_ctor,
+                             (jint)kind,
+                             (jlong)timestamp_ns,
+                             (jlong)value,
+                             peerId,
+                             text);
+}
+
 JNIEXPORT jint JNICALL
 Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDhtPutRecord(JNIEnv *env, jobject obj,
                                                                    jlong handle, jbyteArray key, jbyteArray value, jlong ttlSeconds) {
@@ -403,107 +1112,603 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDhtPutRecord(JNIEnv *env,
     jsize value_len = (*env)->GetArrayLength(env, value);
     if (key_len <= 0 || value_len <= 0) return 2;
 
-    jbyte* key_bytes = (*env)->GetByteArrayElements(env, key, NULL);
-    jbyte* value_bytes = (*env)->GetByteArrayElements(env, value, NULL);
-    if (key_bytes == NULL || value_bytes == NULL) {
-        if (key_bytes != NULL) (*env)->ReleaseByteArrayElements(env, key, key_bytes, JNI_ABORT);
-        if (value_bytes != NULL) (*env)->ReleaseByteArrayElements(env, value, value_bytes, JNI_ABORT);
+    // The put waits on the network, so both arguments are copied rather than pinned
+    JniBytes key_bytes;
+    JniBytes value_bytes;
+    if (!jni_bytes_get(env, key, 0, false, &key_bytes) ||
+        !jni_bytes_get(env, value, 1, false, &value_bytes)) {
         return 1;
     }
 
     int status = cabi_node_dht_put_record(
         (void*)handle,
-        (const unsigned char*)key_bytes, (size_t)key_len,
-        (const unsigned char*)value_bytes, (size_t)value_len,
+        key_bytes.data, key_bytes.len,
+        value_bytes.data, value_bytes.len,
         (unsigned long long)ttlSeconds
     );
 
-    (*env)->ReleaseByteArrayElements(env, key, key_bytes, JNI_ABORT);
-    (*env)->ReleaseByteArrayElements(env, value, value_bytes, JNI_ABORT);
+    jni_bytes_release(env, &key_bytes);
+    jni_bytes_release(env, &value_bytes);
     return status;
 }
 
-JNIEXPORT jbyteArray JNICALL
-Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDhtGetRecord(JNIEnv *env, jobject obj,
-                                                                   jlong handle, jbyteArray key) {
+JNIEXPORT jboolean JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDhtPutRecordsIsNative(JNIEnv *env, jobject obj) {
+    return cabi_node_dht_put_records != NULL;
+}
+
+// One status per record. Libraries without the multi-put entry point get one
+// blocking put per record, in order.
+JNIEXPORT jintArray JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDhtPutRecords(JNIEnv *env, jobject obj,
+                                                                    jlong handle, jobjectArray keys,
+                                                                    jobjectArray values, jlongArray ttlSeconds) {
+    if (handle == 0 || keys == NULL || values == NULL || ttlSeconds == NULL) return NULL;
+    jsize count = (*env)->GetArrayLength(env, keys);
+    if ((*env)->GetArrayLength(env, values) != count || (*env)->GetArrayLength(env, ttlSeconds) != count) {
+        return NULL;
+    }
+    jintArray statuses_out = (*env)->NewIntArray(env, count);
+    if (statuses_out == NULL || count == 0) return statuses_out;
+
+    // Descriptors, TTLs and statuses share one pooled slot; keys and values are
+    // copied back to back into another so the library sees stable pointers
+    ThreadBuffers* buffers = thread_buffers();
+    if (buffers == NULL) return NULL;
+    size_t n = (size_t)count;
+    unsigned char* meta = scratch_reserve(&buffers->args[1],
+                                          n * (sizeof(CabiDhtRecord) + sizeof(jlong) + sizeof(jint)));
+    if (meta == NULL) return NULL;
+    CabiDhtRecord* records = (CabiDhtRecord*)meta;
+    jlong* ttls = (jlong*)(records + n);
+    jint* statuses = (jint*)(ttls + n);
+    (*env)->GetLongArrayRegion(env, ttlSeconds, 0, count, ttls);
+
+    size_t total_len = 0;
+    for (jsize i = 0; i < count; i++) {
+        jbyteArray key = (jbyteArray)(*env)->GetObjectArrayElement(env, keys, i);
+        jbyteArray value = (jbyteArray)(*env)->GetObjectArrayElement(env, values, i);
+        records[i].key_len = key != NULL ? (size_t)(*env)->GetArrayLength(env, key) : 0;
+        records[i].value_len = value != NULL ? (size_t)(*env)->GetArrayLength(env, value) : 0;
+        records[i].ttl_seconds = (unsigned long long)ttls[i];
+        total_len += records[i].key_len + records[i].value_len;
+        if (key != NULL) (*env)->DeleteLocalRef(env, key);
+        if (value != NULL) (*env)->DeleteLocalRef(env, value);
+    }
+    unsigned char* input = scratch_reserve(&buffers->args[0], total_len > 0 ? total_len : 1);
+    if (input == NULL) return NULL;
+    size_t pos = 0;
+    for (jsize i = 0; i < count; i++) {
+        jbyteArray key = (jbyteArray)(*env)->GetObjectArrayElement(env, keys, i);
+        jbyteArray value = (jbyteArray)(*env)->GetObjectArrayElement(env, values, i);
+        records[i].key_ptr = input + pos;
+        if (records[i].key_len > 0) {
+            (*env)->GetByteArrayRegion(env, key, 0, (jsize)records[i].key_len, (jbyte*)(input + pos));
+            pos += records[i].key_len;
+        }
+        records[i].value_ptr = input + pos;
+        if (records[i].value_len > 0) {
+            (*env)->GetByteArrayRegion(env, value, 0, (jsize)records[i].value_len, (jbyte*)(input + pos));
+            pos += records[i].value_len;
+        }
+        if (key != NULL) (*env)->DeleteLocalRef(env, key);
+        if (value != NULL) (*env)->DeleteLocalRef(env, value);
+    }
+
+    if (cabi_node_dht_put_records != NULL) {
+        // The library's per-record statuses stand as they are; entries it never
+        // wrote (a failed call) read as internal errors
+        for (size_t i = 0; i < n; i++) statuses[i] = CABI_STATUS_INTERNAL_ERROR;
+        cabi_node_dht_put_records((void*)handle, records, n, (int*)statuses);
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            if (records[i].key_len == 0 || records[i].value_len == 0) {
+                statuses[i] = CABI_STATUS_INVALID_ARGUMENT;
+                continue;
+            }
+            statuses[i] = cabi_node_dht_put_record(
+                (void*)handle,
+                records[i].key_ptr, records[i].key_len,
+                records[i].value_ptr, records[i].value_len,
+                records[i].ttl_seconds
+            );
+        }
+    }
+    (*env)->SetIntArrayRegion(env, statuses_out, 0, count, statuses);
+    return statuses_out;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDhtAsyncIsNative(JNIEnv *env, jobject obj) {
+    return cabi_node_dht_put_record_async != NULL &&
+           cabi_node_dht_get_record_async != NULL &&
+           cabi_node_dequeue_dht_result != NULL;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDhtPutRecordAsync(JNIEnv *env, jobject obj,
+                                                                        jlong handle, jbyteArray key, jbyteArray value, jlong ttlSeconds) {
+    if (handle == 0 || key == NULL || value == NULL || cabi_node_dht_put_record_async == NULL) return 0;
+    if ((*env)->GetArrayLength(env, key) <= 0 || (*env)->GetArrayLength(env, value) <= 0) return 0;
+
+    // Only starts the query and copies the record, so a large value may be pinned.
+    // The key is copied first: no JNI call may run inside the value's critical region.
+    JniBytes key_bytes;
+    JniBytes value_bytes;
+    if (!jni_bytes_get(env, key, 0, false, &key_bytes)) return 0;
+    if (!jni_bytes_get(env, value, 1, true, &value_bytes)) {
+        jni_bytes_release(env, &key_bytes);
+        return 0;
+    }
+
+    uint64_t request_id = 0;
+    int status = cabi_node_dht_put_record_async(
+        (void*)handle,
+        key_bytes.data, key_bytes.len,
+        value_bytes.data, value_bytes.len,
+        (unsigned long long)ttlSeconds,
+        &request_id
+    );
+
+    jni_bytes_release(env, &value_bytes);
+    jni_bytes_release(env, &key_bytes);
+    return status == 0 ? (jlong)request_id : 0;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDhtGetRecordAsync(JNIEnv *env, jobject obj,
+                                                                        jlong handle, jbyteArray key) {
+    if (handle == 0 || key == NULL || cabi_node_dht_get_record_async == NULL) return 0;
+    if ((*env)->GetArrayLength(env, key) <= 0) return 0;
+
+    JniBytes key_bytes;
+    if (!jni_bytes_get(env, key, 0, true, &key_bytes)) return 0;
+
+    uint64_t request_id = 0;
+    int status = cabi_node_dht_get_record_async((void*)handle, key_bytes.data, key_bytes.len, &request_id);
+
+    jni_bytes_release(env, &key_bytes);
+    return status == 0 ? (jlong)request_id : 0;
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDequeueDhtResult(JNIEnv *env, jobject obj,
+                                                                       jlong handle, jlong timeoutMs) {
+    if (handle == 0 || cabi_node_dequeue_dht_result == NULL) return NULL;
+
+    size_t cap = 0;
+    unsigned char* buffer = scratch_acquire(0, &cap);
+    uint64_t request_id = 0;
+    int op_kind = 0;
+    int op_status = 0;
+    size_t written_len = 0;
+    int status = CABI_STATUS_INTERNAL_ERROR;
+    unsigned long long timeout_ms = timeoutMs > 0 ? (unsigned long long)timeoutMs : 0;
+
+    for (int attempt = 0; buffer != NULL && attempt < SCRATCH_MAX_ATTEMPTS; attempt++) {
+        written_len = 0;
+        status = cabi_node_dequeue_dht_result(
+            (void*)handle,
+            timeout_ms,
+            &request_id,
+            &op_kind,
+            &op_status,
+            buffer, cap,
+            &written_len
+        );
+        if (status == CABI_STATUS_BUFFER_TOO_SMALL && written_len > cap) {
+            buffer = scratch_acquire(written_len, &cap);
+            // The result is already waiting; do not block again
+            timeout_ms = 0;
+            continue;
+        }
+        break;
+    }
+
+    if (buffer == NULL || status != 0) {
+        return NULL;
+    }
+
+    jbyteArray value = make_jbyte_array(env, buffer, written_len);
+    jobject result = (*env)->NewObject(env, jni_classes.dht_result, jni_classes.dht_result_ctor,
+                                       (jlong)request_id,
+                                       (jint)op_kind,
+                                       (jint)op_status,
+                                       value);
+    if (value != NULL) (*env)->DeleteLocalRef(env, value);
+    return result;
+}
+
+// Blocking get; *status_out keeps the library status so NOT_FOUND can be told
+// apart from other failures. Returns the value on success, NULL otherwise.
+static jbyteArray dht_get_record_blocking(JNIEnv *env, jlong handle, jbyteArray key, int* status_out) {
+    *status_out = CABI_STATUS_INVALID_ARGUMENT;
     if (handle == 0 || key == NULL) return NULL;
     jsize key_len = (*env)->GetArrayLength(env, key);
     if (key_len <= 0) return NULL;
 
-    jbyte* key_bytes = (*env)->GetByteArrayElements(env, key, NULL);
-    if (key_bytes == NULL) return NULL;
+    JniBytes key_bytes;
+    *status_out = CABI_STATUS_INTERNAL_ERROR;
+    if (!jni_bytes_get(env, key, 0, false, &key_bytes)) return NULL;
 
-    size_t cap = 64 * 1024;
-    unsigned char* buffer = NULL;
+    size_t cap = 0;
+    unsigned char* buffer = scratch_acquire(0, &cap);
     size_t written_len = 0;
-    int status = 0;
+    int status = CABI_STATUS_INTERNAL_ERROR;
 
-    for (int attempt = 0; attempt < 4; attempt++) {
-        buffer = (unsigned char*)malloc(cap);
-        if (buffer == NULL) {
-            (*env)->ReleaseByteArrayElements(env, key, key_bytes, JNI_ABORT);
-            return NULL;
-        }
+    for (int attempt = 0; buffer != NULL && attempt < SCRATCH_MAX_ATTEMPTS; attempt++) {
         written_len = 0;
         status = cabi_node_dht_get_record(
             (void*)handle,
-            (const unsigned char*)key_bytes, (size_t)key_len,
+            key_bytes.data, key_bytes.len,
             buffer, cap,
             &written_len
         );
-        if (status == -2 && written_len > cap) { // CABI_STATUS_BUFFER_TOO_SMALL
-            free(buffer);
-            buffer = NULL;
-            cap = written_len + 1;
+        if (status == CABI_STATUS_BUFFER_TOO_SMALL && written_len > cap) {
+            buffer = scratch_acquire(written_len, &cap);
             continue;
         }
         break;
     }
 
-    (*env)->ReleaseByteArrayElements(env, key, key_bytes, JNI_ABORT);
+    jni_bytes_release(env, &key_bytes);
 
+    if (buffer == NULL) status = CABI_STATUS_INTERNAL_ERROR;
+    *status_out = status;
     if (status != 0 || written_len == 0) {
-        if (buffer != NULL) free(buffer);
         return NULL;
     }
 
-    jbyteArray out = make_jbyte_array(env, buffer, written_len);
-    free(buffer);
-    return out;
+    return make_jbyte_array(env, buffer, written_len);
 }
 
 JNIEXPORT jbyteArray JNICALL
-Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeBuildPrekeyBundle(JNIEnv *env, jobject obj,
-                                                                        jstring profilePath, jint oneTimePrekeyCount, jlong ttlSeconds) {
-    if (profilePath == NULL) return NULL;
-    const char* path = (*env)->GetStringUTFChars(env, profilePath, NULL);
-    if (path == NULL) return NULL;
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDhtGetRecord(JNIEnv *env, jobject obj,
+                                                                   jlong handle, jbyteArray key) {
+    int status;
+    return dht_get_record_blocking(env, handle, key, &status);
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeDhtGetRecordResult(JNIEnv *env, jobject obj,
+                                                                         jlong handle, jbyteArray key) {
+    int status;
+    jbyteArray value = dht_get_record_blocking(env, handle, key, &status);
+    if ((*env)->ExceptionCheck(env)) return NULL;
+    jobject result = (*env)->NewObject(env, jni_classes.dht_result, jni_classes.dht_result_ctor,
+                                       (jlong)0,
+                                       (jint)CABI_DHT_OP_GET,
+                                       (jint)status,
+                                       value);
+    if (value != NULL) (*env)->DeleteLocalRef(env, value);
+    return result;
+}
+
+// Where an E2EE call reads its state from: an open library context when there
+// is one, otherwise the profile file on every call
+typedef struct E2eeTarget {
+    CabiE2eeContext* ctx;
+    const char* path;
+} E2eeTarget;
+
+static int e2ee_build_prekey_bundle(const E2eeTarget* target, size_t one_time_prekey_count,
+                                    unsigned long long ttl_seconds,
+                                    unsigned char* out, size_t out_len, size_t* written_len) {
+    if (target->ctx != NULL) {
+        return cabi_e2ee_build_prekey_bundle_ctx(target->ctx, one_time_prekey_count, ttl_seconds,
+                                                 out, out_len, written_len);
+    }
+    return cabi_e2ee_build_prekey_bundle(target->path, one_time_prekey_count, ttl_seconds,
+                                         out, out_len, written_len);
+}
+
+static int e2ee_build_message_auto(const E2eeTarget* target,
+                                   const JniBytes* bundle, const JniBytes* plaintext, const JniBytes* aad,
+                                   unsigned char* out, size_t out_len, size_t* written_len) {
+    if (target->ctx != NULL) {
+        return cabi_e2ee_build_message_auto_ctx(target->ctx,
+                                                bundle->data, bundle->len,
+                                                plaintext->data, plaintext->len,
+                                                aad->data, aad->len,
+                                                out, out_len, written_len);
+    }
+    return cabi_e2ee_build_message_auto(target->path,
+                                        bundle->data, bundle->len,
+                                        plaintext->data, plaintext->len,
+                                        aad->data, aad->len,
+                                        out, out_len, written_len);
+}
 
-    size_t cap = 64 * 1024;
-    unsigned char* buffer = (unsigned char*)malloc(cap);
-    if (buffer == NULL) {
-        (*env)->ReleaseStringUTFChars(env, profilePath, path);
+static int e2ee_decrypt_message_auto(const E2eeTarget* target, const unsigned char* payload, size_t payload_len,
+                                     unsigned char* out, size_t out_len, size_t* written_len, int* kind) {
+    if (target->ctx != NULL) {
+        return cabi_e2ee_decrypt_message_auto_ctx(target->ctx, payload, payload_len,
+                                                  out, out_len, written_len, kind);
+    }
+    return cabi_e2ee_decrypt_message_auto(target->path, payload, payload_len,
+                                          out, out_len, written_len, kind);
+}
+
+static bool e2ee_has_batch_decrypt(const E2eeTarget* target) {
+    return target->ctx != NULL ? cabi_e2ee_decrypt_messages_auto_ctx != NULL
+                               : cabi_e2ee_decrypt_messages_auto != NULL;
+}
+
+static int e2ee_decrypt_messages_auto(const E2eeTarget* target, const CabiBuffer* payloads, size_t count,
+                                      unsigned char* arena, size_t arena_len,
+                                      size_t* offsets, size_t* lengths, int* kinds, int* statuses,
+                                      size_t* processed) {
+    if (target->ctx != NULL) {
+        return cabi_e2ee_decrypt_messages_auto_ctx(target->ctx, payloads, count, arena, arena_len,
+                                                   offsets, lengths, kinds, statuses, processed);
+    }
+    return cabi_e2ee_decrypt_messages_auto(target->path, payloads, count, arena, arena_len,
+                                           offsets, lengths, kinds, statuses, processed);
+}
+
+static jbyteArray build_prekey_bundle(JNIEnv* env, const E2eeTarget* target,
+                                      jint oneTimePrekeyCount, jlong ttlSeconds) {
+    size_t cap = 0;
+    unsigned char* buffer = scratch_acquire(0, &cap);
+    size_t written_len = 0;
+    int status = CABI_STATUS_INTERNAL_ERROR;
+
+    for (int attempt = 0; buffer != NULL && attempt < SCRATCH_MAX_ATTEMPTS; attempt++) {
+        written_len = 0;
+        status = e2ee_build_prekey_bundle(
+            target,
+            (size_t)(oneTimePrekeyCount > 0 ? oneTimePrekeyCount : 1),
+            (unsigned long long)(ttlSeconds > 0 ? ttlSeconds : 1),
+            buffer, cap, &written_len
+        );
+        if (status == CABI_STATUS_BUFFER_TOO_SMALL && written_len > cap) {
+            buffer = scratch_acquire(written_len, &cap);
+            continue;
+        }
+        break;
+    }
+
+    if (buffer == NULL || status != 0 || written_len == 0) {
         return NULL;
     }
 
+    return make_jbyte_array(env, buffer, written_len);
+}
+
+static jbyteArray build_message_auto(JNIEnv* env, const E2eeTarget* target,
+                                     jbyteArray recipientPrekeyBundle, jbyteArray plaintext, jbyteArray aad) {
+    jsize bundle_len = (*env)->GetArrayLength(env, recipientPrekeyBundle);
+    if (bundle_len <= 0) return NULL;
+
+    // Encrypting may write the profile or its journal to disk, so the inputs
+    // are copied into pooled slots rather than held in a critical region
+    JniBytes bundle_bytes;
+    JniBytes plaintext_bytes;
+    JniBytes aad_bytes;
+    if (!jni_bytes_get(env, recipientPrekeyBundle, 0, false, &bundle_bytes) ||
+        !jni_bytes_get(env, plaintext, 1, false, &plaintext_bytes) ||
+        !jni_bytes_get(env, aad, 2, false, &aad_bytes)) {
+        return NULL;
+    }
+
+    size_t cap = 0;
+    unsigned char* buffer = scratch_acquire(0, &cap);
     size_t written_len = 0;
-    int status = cabi_e2ee_build_prekey_bundle(
-        path,
-        (size_t)(oneTimePrekeyCount > 0 ? oneTimePrekeyCount : 1),
-        (unsigned long long)(ttlSeconds > 0 ? ttlSeconds : 1),
-        buffer, cap, &written_len
-    );
+    int status = CABI_STATUS_INTERNAL_ERROR;
 
-    (*env)->ReleaseStringUTFChars(env, profilePath, path);
+    // Encrypting advances session state, so there is no BUFFER_TOO_SMALL retry;
+    // the scratch is sized for the base64/JSON envelope up front instead
+    size_t needed = 2 * (plaintext_bytes.len + aad_bytes.len) + bundle_bytes.len + 4096;
+    if (buffer != NULL && cap < needed) {
+        buffer = scratch_acquire(needed, &cap);
+    }
+    if (buffer != NULL) {
+        status = e2ee_build_message_auto(target, &bundle_bytes, &plaintext_bytes, &aad_bytes,
+                                         buffer, cap, &written_len);
+    }
 
-    if (status != 0 || written_len == 0) {
-        free(buffer);
+    jni_bytes_release(env, &bundle_bytes);
+    jni_bytes_release(env, &plaintext_bytes);
+    jni_bytes_release(env, &aad_bytes);
+
+    if (buffer == NULL || status != 0 || written_len == 0) {
         return NULL;
     }
 
-    jbyteArray out = make_jbyte_array(env, buffer, written_len);
-    free(buffer);
-    return out;
+    return make_jbyte_array(env, buffer, written_len);
+}
+
+static jobject decrypt_message_auto(JNIEnv* env, const E2eeTarget* target, jbyteArray payload) {
+    jsize payload_len = (*env)->GetArrayLength(env, payload);
+    if (payload_len <= 0) return NULL;
+
+    JniBytes payload_bytes;
+    if (!jni_bytes_get(env, payload, 0, false, &payload_bytes)) return NULL;
+
+    size_t cap = 0;
+    unsigned char* buffer = scratch_acquire(0, &cap);
+    size_t written_len = 0;
+    int kind = 0;
+    int status = CABI_STATUS_INTERNAL_ERROR;
+
+    // Plaintext is never larger than its ciphertext, so sizing the scratch to the
+    // payload up front avoids a BUFFER_TOO_SMALL retry that could look like a replay
+    if (buffer != NULL && cap < (size_t)payload_len) {
+        buffer = scratch_acquire((size_t)payload_len, &cap);
+    }
+    if (buffer != NULL) {
+        status = e2ee_decrypt_message_auto(target, payload_bytes.data, payload_bytes.len,
+                                           buffer, cap, &written_len, &kind);
+    }
+
+    jni_bytes_release(env, &payload_bytes);
+
+    if (buffer == NULL || status != 0 || written_len == 0) {
+        return NULL;
+    }
+
+    jbyteArray plaintext = make_jbyte_array(env, buffer, written_len);
+    if (plaintext == NULL) return NULL;
+    return (*env)->NewObject(env, jni_classes.decrypted_message, jni_classes.decrypted_message_ctor,
+                             (jint)kind, plaintext);
+}
+
+// Fallback for libraries without the batch entry point: same results, one
+// library call per payload, starting at payloads[first]
+static void decrypt_batch_fallback(JNIEnv* env, const E2eeTarget* target, const CabiBuffer* payloads,
+                                   size_t first, size_t count, jint* kinds, jint* statuses,
+                                   jobjectArray plaintexts, size_t max_payload) {
+    size_t cap = 0;
+    unsigned char* buffer = scratch_acquire(max_payload, &cap);
+
+    for (size_t i = first; i < count; i++) {
+        size_t written_len = 0;
+        int kind = 0;
+        int status = buffer != NULL
+            ? e2ee_decrypt_message_auto(target, payloads[i].ptr, payloads[i].len,
+                                        buffer, cap, &written_len, &kind)
+            : CABI_STATUS_INTERNAL_ERROR;
+        kinds[i] = kind;
+        statuses[i] = status;
+        if (status != 0 || written_len == 0) continue;
+
+        jbyteArray plaintext = make_jbyte_array(env, buffer, written_len);
+        if (plaintext == NULL) {
+            statuses[i] = CABI_STATUS_INTERNAL_ERROR;
+            continue;
+        }
+        (*env)->SetObjectArrayElement(env, plaintexts, (jsize)i, plaintext);
+        (*env)->DeleteLocalRef(env, plaintext);
+    }
+}
+
+// Batch decrypt through the library's batch entry point, resuming after an early
+// stop. Results land in Java arrays as each chunk completes since the output
+// arena is reused.
+static void decrypt_batch_native(JNIEnv* env, const E2eeTarget* target, const CabiBuffer* payloads, size_t count,
+                                 size_t* offsets, size_t* lengths, jint* kinds, jint* statuses,
+                                 jobjectArray plaintexts, size_t output_hint) {
+    size_t cap = 0;
+    unsigned char* arena = scratch_acquire(output_hint, &cap);
+    size_t done = 0;
+
+    while (arena != NULL && done < count) {
+        size_t processed = 0;
+        int status = e2ee_decrypt_messages_auto(
+            target, payloads + done, count - done,
+            arena, cap,
+            offsets + done, lengths + done,
+            (int*)kinds + done, (int*)statuses + done,
+            &processed
+        );
+        if (processed > count - done) processed = count - done;
+
+        for (size_t i = done; i < done + processed; i++) {
+            if (statuses[i] != 0 || lengths[i] == 0) continue;
+            jbyteArray plaintext = make_jbyte_array(env, arena + offsets[i], lengths[i]);
+            if (plaintext == NULL) {
+                statuses[i] = CABI_STATUS_INTERNAL_ERROR;
+                continue;
+            }
+            (*env)->SetObjectArrayElement(env, plaintexts, (jsize)i, plaintext);
+            (*env)->DeleteLocalRef(env, plaintext);
+        }
+        done += processed;
+
+        if (status == CABI_STATUS_BUFFER_TOO_SMALL) {
+            // A single plaintext larger than the whole arena: grow before resuming
+            if (processed == 0) arena = scratch_acquire(cap * 2, &cap);
+            continue;
+        }
+        if (status != 0) break;
+    }
+
+    // Items the batch call never reached still get their own status, one call each,
+    // instead of being reported as failed
+    if (done < count) {
+        size_t max_len = 0;
+        for (size_t i = done; i < count; i++) {
+            if (payloads[i].len > max_len) max_len = payloads[i].len;
+        }
+        decrypt_batch_fallback(env, target, payloads, done, count, kinds, statuses, plaintexts, max_len);
+    }
+}
+
+static jobject decrypt_messages_auto(JNIEnv* env, const E2eeTarget* target, jobjectArray payloads) {
+    jsize count = (*env)->GetArrayLength(env, payloads);
+
+    jintArray kinds_out = (*env)->NewIntArray(env, count);
+    jintArray statuses_out = (*env)->NewIntArray(env, count);
+    jobjectArray plaintexts = (*env)->NewObjectArray(env, count, jni_classes.byte_array, NULL);
+    if (kinds_out == NULL || statuses_out == NULL || plaintexts == NULL) return NULL;
+    if (count == 0) {
+        return (*env)->NewObject(env, jni_classes.decrypted_batch, jni_classes.decrypted_batch_ctor,
+                                 statuses_out, kinds_out, plaintexts);
+    }
+
+    // Per-item metadata shares one pooled slot: descriptors, offsets, lengths, kinds, statuses
+    ThreadBuffers* buffers = thread_buffers();
+    if (buffers == NULL) return NULL;
+    size_t n = (size_t)count;
+    size_t meta_len = n * (sizeof(CabiBuffer) + 2 * sizeof(size_t) + 2 * sizeof(jint));
+    unsigned char* meta = scratch_reserve(&buffers->args[1], meta_len);
+    if (meta == NULL) return NULL;
+    CabiBuffer* descriptors = (CabiBuffer*)meta;
+    size_t* offsets = (size_t*)(descriptors + n);
+    size_t* lengths = offsets + n;
+    jint* kinds = (jint*)(lengths + n);
+    jint* statuses = kinds + n;
+    memset(kinds, 0, n * sizeof(jint));
+
+    // Copy every payload into one input arena so the library sees stable pointers
+    size_t total_len = 0;
+    size_t max_len = 0;
+    for (jsize i = 0; i < count; i++) {
+        jbyteArray item = (jbyteArray)(*env)->GetObjectArrayElement(env, payloads, i);
+        size_t len = item != NULL ? (size_t)(*env)->GetArrayLength(env, item) : 0;
+        descriptors[i].len = len;
+        total_len += len;
+        if (len > max_len) max_len = len;
+        if (item != NULL) (*env)->DeleteLocalRef(env, item);
+    }
+    unsigned char* input = scratch_reserve(&buffers->args[0], total_len > 0 ? total_len : 1);
+    if (input == NULL) return NULL;
+    size_t pos = 0;
+    for (jsize i = 0; i < count; i++) {
+        descriptors[i].ptr = input + pos;
+        if (descriptors[i].len == 0) continue;
+        jbyteArray item = (jbyteArray)(*env)->GetObjectArrayElement(env, payloads, i);
+        (*env)->GetByteArrayRegion(env, item, 0, (jsize)descriptors[i].len, (jbyte*)(input + pos));
+        (*env)->DeleteLocalRef(env, item);
+        pos += descriptors[i].len;
+    }
+
+    // Plaintexts are never larger than their ciphertexts, so an arena the size of
+    // the input normally takes the whole batch in one call
+    if (e2ee_has_batch_decrypt(target)) {
+        decrypt_batch_native(env, target, descriptors, n, offsets, lengths, kinds, statuses, plaintexts, total_len);
+    } else {
+        decrypt_batch_fallback(env, target, descriptors, 0, n, kinds, statuses, plaintexts, max_len);
+    }
+
+    (*env)->SetIntArrayRegion(env, kinds_out, 0, count, kinds);
+    (*env)->SetIntArrayRegion(env, statuses_out, 0, count, statuses);
+    return (*env)->NewObject(env, jni_classes.decrypted_batch, jni_classes.decrypted_batch_ctor,
+                             statuses_out, kinds_out, plaintexts);
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeBuildPrekeyBundle(JNIEnv *env, jobject obj,
+                                                                        jstring profilePath, jint oneTimePrekeyCount, jlong ttlSeconds) {
+    if (profilePath == NULL) return NULL;
+    const char* path = (*env)->GetStringUTFChars(env, profilePath, NULL);
+    if (path == NULL) return NULL;
+
+    E2eeTarget target = { NULL, path };
+    jbyteArray result = build_prekey_bundle(env, &target, oneTimePrekeyCount, ttlSeconds);
+
+    (*env)->ReleaseStringUTFChars(env, profilePath, path);
+    return result;
 }
 
 JNIEXPORT jint JNICALL
@@ -513,16 +1718,17 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeValidatePrekeyBundle(JNIEn
     jsize len = (*env)->GetArrayLength(env, payload);
     if (len <= 0) return 2;
 
-    jbyte* bytes = (*env)->GetByteArrayElements(env, payload, NULL);
-    if (bytes == NULL) return 1;
+    // Validation is pure signature checking with no I/O, so it may read in place
+    JniBytes bytes;
+    if (!jni_bytes_get(env, payload, 0, true, &bytes)) return 1;
 
     int status = cabi_e2ee_validate_prekey_bundle(
-        (const unsigned char*)bytes,
-        (size_t)len,
+        bytes.data,
+        bytes.len,
         (unsigned long long)(nowUnix >= 0 ? nowUnix : 0)
     );
 
-    (*env)->ReleaseByteArrayElements(env, payload, bytes, JNI_ABORT);
+    jni_bytes_release(env, &bytes);
     return status;
 }
 
@@ -536,58 +1742,11 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeBuildMessageAuto(JNIEnv *e
     const char* path = (*env)->GetStringUTFChars(env, profilePath, NULL);
     if (path == NULL) return NULL;
 
-    jsize bundle_len = (*env)->GetArrayLength(env, recipientPrekeyBundle);
-    jsize plaintext_len = (*env)->GetArrayLength(env, plaintext);
-    jsize aad_len = (*env)->GetArrayLength(env, aad);
-    if (bundle_len <= 0 || plaintext_len < 0 || aad_len < 0) {
-        (*env)->ReleaseStringUTFChars(env, profilePath, path);
-        return NULL;
-    }
-
-    jbyte* bundle_bytes = (*env)->GetByteArrayElements(env, recipientPrekeyBundle, NULL);
-    jbyte* plaintext_bytes = (*env)->GetByteArrayElements(env, plaintext, NULL);
-    jbyte* aad_bytes = (*env)->GetByteArrayElements(env, aad, NULL);
-    if (bundle_bytes == NULL || plaintext_bytes == NULL || aad_bytes == NULL) {
-        if (bundle_bytes != NULL) (*env)->ReleaseByteArrayElements(env, recipientPrekeyBundle, bundle_bytes, JNI_ABORT);
-        if (plaintext_bytes != NULL) (*env)->ReleaseByteArrayElements(env, plaintext, plaintext_bytes, JNI_ABORT);
-        if (aad_bytes != NULL) (*env)->ReleaseByteArrayElements(env, aad, aad_bytes, JNI_ABORT);
-        (*env)->ReleaseStringUTFChars(env, profilePath, path);
-        return NULL;
-    }
-
-    size_t cap = 64 * 1024;
-    unsigned char* buffer = (unsigned char*)malloc(cap);
-    if (buffer == NULL) {
-        (*env)->ReleaseByteArrayElements(env, recipientPrekeyBundle, bundle_bytes, JNI_ABORT);
-        (*env)->ReleaseByteArrayElements(env, plaintext, plaintext_bytes, JNI_ABORT);
-        (*env)->ReleaseByteArrayElements(env, aad, aad_bytes, JNI_ABORT);
-        (*env)->ReleaseStringUTFChars(env, profilePath, path);
-        return NULL;
-    }
+    E2eeTarget target = { NULL, path };
+    jbyteArray result = build_message_auto(env, &target, recipientPrekeyBundle, plaintext, aad);
 
-    size_t written_len = 0;
-    int status = cabi_e2ee_build_message_auto(
-        path,
-        (const unsigned char*)bundle_bytes, (size_t)bundle_len,
-        (const unsigned char*)plaintext_bytes, (size_t)plaintext_len,
-        (const unsigned char*)aad_bytes, (size_t)aad_len,
-        buffer, cap,
-        &written_len
-    );
-
-    (*env)->ReleaseByteArrayElements(env, recipientPrekeyBundle, bundle_bytes, JNI_ABORT);
-    (*env)->ReleaseByteArrayElements(env, plaintext, plaintext_bytes, JNI_ABORT);
-    (*env)->ReleaseByteArrayElements(env, aad, aad_bytes, JNI_ABORT);
     (*env)->ReleaseStringUTFChars(env, profilePath, path);
-
-    if (status != 0 || written_len == 0) {
-        free(buffer);
-        return NULL;
-    }
-
-    jbyteArray out = make_jbyte_array(env, buffer, written_len);
-    free(buffer);
-    return out;
+    return result;
 }
 
 JNIEXPORT jobject JNICALL
@@ -597,61 +1756,295 @@ Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeDecryptMessageAuto(JNIEnv
     const char* path = (*env)->GetStringUTFChars(env, profilePath, NULL);
     if (path == NULL) return NULL;
 
-    jsize payload_len = (*env)->GetArrayLength(env, payload);
-    if (payload_len <= 0) {
-        (*env)->ReleaseStringUTFChars(env, profilePath, path);
-        return NULL;
-    }
+    E2eeTarget target = { NULL, path };
+    jobject result = decrypt_message_auto(env, &target, payload);
 
-    jbyte* payload_bytes = (*env)->GetByteArrayElements(env, payload, NULL);
-    if (payload_bytes == NULL) {
-        (*env)->ReleaseStringUTFChars(env, profilePath, path);
-        return NULL;
+    (*env)->ReleaseStringUTFChars(env, profilePath, path);
+    return result;
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeDecryptMessagesAuto(JNIEnv *env, jobject obj,
+                                                                          jstring profilePath, jobjectArray payloads) {
+    if (profilePath == NULL || payloads == NULL) return NULL;
+    const char* path = (*env)->GetStringUTFChars(env, profilePath, NULL);
+    if (path == NULL) return NULL;
+
+    E2eeTarget target = { NULL, path };
+    jobject result = decrypt_messages_auto(env, &target, payloads);
+
+    (*env)->ReleaseStringUTFChars(env, profilePath, path);
+    return result;
+}
+
+// Context handle given to Kotlin. `native` is NULL on libraries without the
+// complete context ABI; calls then go through profile_path exactly like the
+// wrappers above.
+typedef struct E2eeContext {
+    CabiE2eeContext* native;
+    char* profile_path;
+    struct E2eeContext* next;
+    // Session state is not reentrant: one call per context at a time
+    pthread_mutex_t lock;
+    // Guarded by e2ee_contexts_lock: calls inside the context, and whether close started
+    int users;
+    bool closed;
+} E2eeContext;
+
+// Open contexts. The registry lock outlives every context, so a call racing
+// cabiE2eeContextClose either gets in before close starts (and close waits for
+// it) or finds the handle closed or gone; it never touches freed memory.
+static pthread_mutex_t e2ee_contexts_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t e2ee_contexts_idle = PTHREAD_COND_INITIALIZER;
+static E2eeContext* e2ee_contexts = NULL;
+
+// Every *_ctx entry point the wrappers call unconditionally; a library that
+// exports only some of them is used through the profile path instead
+static bool e2ee_context_abi_complete(void) {
+    return cabi_e2ee_context_open != NULL &&
+           cabi_e2ee_context_flush != NULL &&
+           cabi_e2ee_context_close != NULL &&
+           cabi_e2ee_build_prekey_bundle_ctx != NULL &&
+           cabi_e2ee_build_message_auto_ctx != NULL &&
+           cabi_e2ee_decrypt_message_auto_ctx != NULL;
+}
+
+static E2eeContext* e2ee_context_find_locked(jlong context) {
+    E2eeContext* ctx = e2ee_contexts;
+    while (ctx != NULL && ctx != (E2eeContext*)context) {
+        ctx = ctx->next;
     }
+    return ctx;
+}
 
-    size_t cap = 64 * 1024;
-    unsigned char* buffer = (unsigned char*)malloc(cap);
-    if (buffer == NULL) {
-        (*env)->ReleaseByteArrayElements(env, payload, payload_bytes, JNI_ABORT);
-        (*env)->ReleaseStringUTFChars(env, profilePath, path);
+static E2eeContext* e2ee_context_enter(jlong context, E2eeTarget* target) {
+    pthread_mutex_lock(&e2ee_contexts_lock);
+    E2eeContext* ctx = e2ee_context_find_locked(context);
+    if (ctx == NULL || ctx->closed) {
+        pthread_mutex_unlock(&e2ee_contexts_lock);
         return NULL;
     }
+    ctx->users++;
+    pthread_mutex_unlock(&e2ee_contexts_lock);
 
-    size_t written_len = 0;
-    int kind = 0;
-    int status = cabi_e2ee_decrypt_message_auto(
-        path,
-        (const unsigned char*)payload_bytes, (size_t)payload_len,
-        buffer, cap,
-        &written_len,
-        &kind
-    );
+    pthread_mutex_lock(&ctx->lock);
+    target->ctx = ctx->native;
+    target->path = ctx->profile_path;
+    return ctx;
+}
+
+static void e2ee_context_leave(E2eeContext* ctx) {
+    pthread_mutex_unlock(&ctx->lock);
 
-    (*env)->ReleaseByteArrayElements(env, payload, payload_bytes, JNI_ABORT);
+    pthread_mutex_lock(&e2ee_contexts_lock);
+    if (--ctx->users == 0 && ctx->closed) {
+        pthread_cond_broadcast(&e2ee_contexts_idle);
+    }
+    pthread_mutex_unlock(&e2ee_contexts_lock);
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeContextOpen(JNIEnv *env, jobject obj, jstring profilePath) {
+    if (profilePath == NULL) return 0;
+    const char* path = (*env)->GetStringUTFChars(env, profilePath, NULL);
+    if (path == NULL) return 0;
+
+    E2eeContext* ctx = (E2eeContext*)calloc(1, sizeof(E2eeContext));
+    if (ctx != NULL) {
+        ctx->profile_path = strdup(path);
+        if (ctx->profile_path == NULL) {
+            free(ctx);
+            ctx = NULL;
+        }
+    }
+    if (ctx != NULL && e2ee_context_abi_complete() &&
+        cabi_e2ee_context_open(path, &ctx->native) != 0) {
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG,
+                            "cabi_e2ee_context_open failed; using per-call profile access");
+        ctx->native = NULL;
+    }
     (*env)->ReleaseStringUTFChars(env, profilePath, path);
 
-    if (status != 0 || written_len == 0) {
-        free(buffer);
-        return NULL;
+    if (ctx == NULL) return 0;
+    pthread_mutex_init(&ctx->lock, NULL);
+
+    pthread_mutex_lock(&e2ee_contexts_lock);
+    ctx->next = e2ee_contexts;
+    e2ee_contexts = ctx;
+    pthread_mutex_unlock(&e2ee_contexts_lock);
+    return (jlong)ctx;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeContextIsNative(JNIEnv *env, jobject obj, jlong context) {
+    pthread_mutex_lock(&e2ee_contexts_lock);
+    E2eeContext* ctx = e2ee_context_find_locked(context);
+    jboolean is_native = (ctx != NULL && ctx->native != NULL) ? JNI_TRUE : JNI_FALSE;
+    pthread_mutex_unlock(&e2ee_contexts_lock);
+    return is_native;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeContextFlush(JNIEnv *env, jobject obj, jlong context) {
+    E2eeTarget target;
+    E2eeContext* ctx = e2ee_context_enter(context, &target);
+    if (ctx == NULL) return 1;
+    // Without a native context every call already wrote the profile through
+    int status = target.ctx != NULL ? cabi_e2ee_context_flush(target.ctx) : 0;
+    e2ee_context_leave(ctx);
+    return status;
+}
+
+// New calls fail from here on; calls already inside finish first, then the
+// context is unlinked and freed
+JNIEXPORT void JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeContextClose(JNIEnv *env, jobject obj, jlong context) {
+    pthread_mutex_lock(&e2ee_contexts_lock);
+    E2eeContext* ctx = e2ee_context_find_locked(context);
+    if (ctx == NULL || ctx->closed) {
+        pthread_mutex_unlock(&e2ee_contexts_lock);
+        return;
+    }
+    ctx->closed = true;
+    while (ctx->users > 0) {
+        pthread_cond_wait(&e2ee_contexts_idle, &e2ee_contexts_lock);
+    }
+    E2eeContext** link = &e2ee_contexts;
+    while (*link != ctx) {
+        link = &(*link)->next;
     }
+    *link = ctx->next;
+    pthread_mutex_unlock(&e2ee_contexts_lock);
 
-    jclass cls = (*env)->FindClass(env, "com/fidonext/messenger/rust/Libp2pNative$DecryptedE2eeMessage");
-    if (cls == NULL) {
-        free(buffer);
-        return NULL;
+    if (ctx->native != NULL) {
+        cabi_e2ee_context_close(ctx->native);
     }
-    jmethodID ctor = (*env)->GetMethodID(env, cls, "<init>", "(I[B)V");
-    if (ctor == NULL) {
-        free(buffer);
-        return NULL;
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx->profile_path);
+    free(ctx);
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeBuildPrekeyBundleCtx(JNIEnv *env, jobject obj,
+                                                                           jlong context, jint oneTimePrekeyCount, jlong ttlSeconds) {
+    E2eeTarget target;
+    E2eeContext* ctx = e2ee_context_enter(context, &target);
+    if (ctx == NULL) return NULL;
+    jbyteArray result = build_prekey_bundle(env, &target, oneTimePrekeyCount, ttlSeconds);
+    e2ee_context_leave(ctx);
+    return result;
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeBuildMessageAutoCtx(JNIEnv *env, jobject obj,
+                                                                          jlong context,
+                                                                          jbyteArray recipientPrekeyBundle,
+                                                                          jbyteArray plaintext,
+                                                                          jbyteArray aad) {
+    if (recipientPrekeyBundle == NULL || plaintext == NULL || aad == NULL) return NULL;
+    E2eeTarget target;
+    E2eeContext* ctx = e2ee_context_enter(context, &target);
+    if (ctx == NULL) return NULL;
+    jbyteArray result = build_message_auto(env, &target, recipientPrekeyBundle, plaintext, aad);
+    e2ee_context_leave(ctx);
+    return result;
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeDecryptMessageAutoCtx(JNIEnv *env, jobject obj,
+                                                                            jlong context, jbyteArray payload) {
+    if (payload == NULL) return NULL;
+    E2eeTarget target;
+    E2eeContext* ctx = e2ee_context_enter(context, &target);
+    if (ctx == NULL) return NULL;
+    jobject result = decrypt_message_auto(env, &target, payload);
+    e2ee_context_leave(ctx);
+    return result;
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiE2eeDecryptMessagesAutoCtx(JNIEnv *env, jobject obj,
+                                                                             jlong context, jobjectArray payloads) {
+    if (payloads == NULL) return NULL;
+    E2eeTarget target;
+    E2eeContext* ctx = e2ee_context_enter(context, &target);
+    if (ctx == NULL) return NULL;
+    jobject result = decrypt_messages_auto(env, &target, payloads);
+    e2ee_context_leave(ctx);
+    return result;
+}
+
+// [scratch acquires, native allocations, bytes currently reserved]
+JNIEXPORT jlongArray JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiJniAllocStats(JNIEnv *env, jobject obj) {
+    jlong stats[3] = {
+        (jlong)atomic_load(&jni_scratch_acquires),
+        (jlong)atomic_load(&jni_native_allocations),
+        (jlong)atomic_load(&jni_native_bytes_reserved),
+    };
+    jlongArray out = (*env)->NewLongArray(env, 3);
+    if (out == NULL) return NULL;
+    (*env)->SetLongArrayRegion(env, out, 0, 3, stats);
+    return out;
+}
+
+// Array access strategies compared by cabiJniBenchArrayAccess
+#define JNI_BENCH_ELEMENTS 0
+#define JNI_BENCH_REGION 1
+#define JNI_BENCH_CRITICAL 2
+#define JNI_BENCH_AUTO 3
+
+// Times `iterations` rounds of exposing `payload` to native code and reading it
+// once, as the wrappers above do. Returns total elapsed nanoseconds, or -1.
+JNIEXPORT jlong JNICALL
+Java_com_fidonext_messenger_rust_Libp2pNative_cabiJniBenchArrayAccess(JNIEnv *env, jobject obj,
+                                                                      jbyteArray payload, jint mode, jint iterations) {
+    if (payload == NULL || iterations <= 0) return -1;
+    jsize len = (*env)->GetArrayLength(env, payload);
+    if (len <= 0) return -1;
+
+    volatile unsigned char sink = 0;
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (jint i = 0; i < iterations; i++) {
+        switch (mode) {
+            case JNI_BENCH_ELEMENTS: {
+                jbyte* bytes = (*env)->GetByteArrayElements(env, payload, NULL);
+                if (bytes == NULL) return -1;
+                sink ^= (unsigned char)(bytes[0] ^ bytes[len - 1]);
+                (*env)->ReleaseByteArrayElements(env, payload, bytes, JNI_ABORT);
+                break;
+            }
+            case JNI_BENCH_REGION:
+            case JNI_BENCH_AUTO: {
+                JniBytes bytes;
+                bool bounded = mode == JNI_BENCH_AUTO;
+                if (!jni_bytes_get(env, payload, 0, bounded, &bytes)) return -1;
+                sink ^= (unsigned char)(bytes.data[0] ^ bytes.data[bytes.len - 1]);
+                jni_bytes_release(env, &bytes);
+                break;
+            }
+            case JNI_BENCH_CRITICAL: {
+                unsigned char* bytes = (unsigned char*)(*env)->GetPrimitiveArrayCritical(env, payload, NULL);
+                if (bytes == NULL) return -1;
+                sink ^= (unsigned char)(bytes[0] ^ bytes[len - 1]);
+                (*env)->ReleasePrimitiveArrayCritical(env, payload, bytes, JNI_ABORT);
+                break;
+            }
+            default:
+                return -1;
+        }
     }
-    jbyteArray plaintext = make_jbyte_array(env, buffer, written_len);
-    free(buffer);
-    if (plaintext == NULL) return NULL;
-    return (*env)->NewObject(env, cls, ctor, (jint)kind, plaintext);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    (void)sink;
+    return (jlong)(end.tv_sec - start.tv_sec) * 1000000000LL + (jlong)(end.tv_nsec - start.tv_nsec);
 }
 
 JNIEXPORT void JNICALL
 Java_com_fidonext_messenger_rust_Libp2pNative_cabiNodeFree(JNIEnv *env, jobject obj, jlong handle) {
+    node_state_release((void*)handle);
     cabi_node_free((void*)handle);
 }
@@ -51,6 +51,10 @@ class MainActivity : ComponentActivity() {
 
         // Start and bind to libp2p service
         val serviceIntent = Intent(this, Libp2pService::class.java)
+        serviceIntent.putExtra(
+            Libp2pService.EXTRA_RUN_BENCHMARKS,
+            intent.getBooleanExtra(Libp2pService.EXTRA_RUN_BENCHMARKS, false)
+        )
         startForegroundService(serviceIntent)
         bindService(serviceIntent, serviceConnection, Context.BIND_AUTO_CREATE)
 
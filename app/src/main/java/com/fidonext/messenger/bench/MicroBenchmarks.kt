@@ -0,0 +1,106 @@
+package com.fidonext.messenger.bench
+
+import android.util.Log
+import com.fidonext.messenger.protocol.ChatPacketCodec
+import com.fidonext.messenger.rust.Libp2pNative
+import java.nio.ByteBuffer
+import java.nio.charset.StandardCharsets
+
+/**
+ * On-device microbenchmarks for the hot JNI and packet-framing paths. Debug builds only; started with
+ * `adb shell am start -n com.fidonext.messenger/.MainActivity --ez run_benchmarks true`
+ * and reported to logcat under the MicroBenchmarks tag.
+ */
+object MicroBenchmarks {
+    private const val TAG = "MicroBenchmarks"
+    private val PAYLOAD_SIZES = intArrayOf(256, 4 * 1024, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024)
+    /** Bytes touched per size point, so small payloads run enough iterations to time */
+    private const val BYTES_PER_POINT = 64L * 1024 * 1024
+    private const val WARMUP_ITERATIONS = 50
+
+    private val ARRAY_ACCESS_MODES = listOf(
+        Libp2pNative.JNI_BENCH_ELEMENTS to "elements",
+        Libp2pNative.JNI_BENCH_REGION to "region",
+        Libp2pNative.JNI_BENCH_CRITICAL to "critical",
+        Libp2pNative.JNI_BENCH_AUTO to "auto",
+    )
+
+    private val PACKET_PAYLOAD_SIZES = intArrayOf(64, 512, 4 * 1024, 32 * 1024)
+    private const val PACKET_ITERATIONS = 2_000
+    private const val SAMPLE_PEER_ID = "12D3KooWQYhTNQdmr3ArTeUHRYzFg94BKyTkoWBDWez9kSCVe2Xo"
+
+    fun runAll() {
+        Log.i(TAG, "Running microbenchmarks")
+        benchArrayAccess()
+        benchChatPacketFraming()
+        Log.i(TAG, "Microbenchmarks finished")
+    }
+
+    /** byte[] -> native exposure cost per KB for each access strategy */
+    private fun benchArrayAccess() {
+        for (size in PAYLOAD_SIZES) {
+            val payload = ByteArray(size) { it.toByte() }
+            val iterations = (BYTES_PER_POINT / size).coerceIn(100L, 100_000L).toInt()
+            val results = ARRAY_ACCESS_MODES.joinToString(" ") { (mode, name) ->
+                Libp2pNative.cabiJniBenchArrayAccess(payload, mode, WARMUP_ITERATIONS)
+                val elapsedNs = Libp2pNative.cabiJniBenchArrayAccess(payload, mode, iterations)
+                if (elapsedNs < 0) {
+                    "$name=failed"
+                } else {
+                    val nsPerKb = elapsedNs.toDouble() / iterations / (size / 1024.0)
+                    "$name=${"%.1f".format(nsPerKb)}ns/KB"
+                }
+            }
+            Log.i(TAG, "array access size=$size iterations=$iterations $results")
+        }
+    }
+
+    /** Wire size and encode/parse cost of the json vs bin1 chat packet formats */
+    private fun benchChatPacketFraming() {
+        for (size in PACKET_PAYLOAD_SIZES) {
+            val packet = ChatPacketCodec.ChatPacket(
+                messageId = ByteArray(ChatPacketCodec.MESSAGE_ID_BYTES) { it.toByte() },
+                createdAtUnix = System.currentTimeMillis() / 1000L,
+                fromPeerId = SAMPLE_PEER_ID,
+                toPeerId = SAMPLE_PEER_ID,
+                payload = ByteArray(size) { (it * 31).toByte() },
+            )
+            val json = ChatPacketCodec.encodeJson(packet)
+            val binary = ChatPacketCodec.encodeBinary(packet)
+            val localBytes = SAMPLE_PEER_ID.toByteArray(StandardCharsets.US_ASCII)
+            // Parse from a direct buffer, as the service does with dequeued messages
+            val jsonBuffer = ByteBuffer.allocateDirect(json.size).put(json)
+            val binaryBuffer = ByteBuffer.allocateDirect(binary.size).put(binary)
+
+            val jsonEncodeNs = timePerOp { ChatPacketCodec.encodeJson(packet).size }
+            val binaryEncodeNs = timePerOp { ChatPacketCodec.encodeBinary(packet).size }
+            val jsonParseNs = timePerOp {
+                jsonBuffer.clear()
+                val text = StandardCharsets.UTF_8.decode(jsonBuffer).toString()
+                ChatPacketCodec.parseJson(text)?.payload?.size ?: -1
+            }
+            val binaryParseNs = timePerOp {
+                binaryBuffer.clear()
+                val view = ChatPacketCodec.parseBinary(binaryBuffer)
+                if (view != null && view.isAddressedTo(localBytes)) view.copyPayload().size else -1
+            }
+
+            Log.i(
+                TAG,
+                "chat packet payload=$size wire json=${json.size}B bin1=${binary.size}B " +
+                    "encode json=${jsonEncodeNs}ns bin1=${binaryEncodeNs}ns " +
+                    "parse json=${jsonParseNs}ns bin1=${binaryParseNs}ns"
+            )
+        }
+    }
+
+    private inline fun timePerOp(op: () -> Int): Long {
+        var sink = 0
+        repeat(PACKET_ITERATIONS / 10) { sink += op() }
+        val start = System.nanoTime()
+        repeat(PACKET_ITERATIONS) { sink += op() }
+        val elapsed = System.nanoTime() - start
+        if (sink == Int.MIN_VALUE) Log.v(TAG, "sink $sink")
+        return elapsed / PACKET_ITERATIONS
+    }
+}
@@ -0,0 +1,176 @@
+package com.fidonext.messenger.protocol
+
+import android.util.Base64
+import org.json.JSONObject
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.nio.charset.StandardCharsets
+
+/**
+ * Wire formats for encrypted chat packets.
+ *
+ * `json` is the original `fidonext-chat-v1` document with the ciphertext as base64.
+ * `bin1` carries the same fields in a fixed header followed by the raw ciphertext:
+ *
+ * ```
+ * offset size  field
+ * 0      2     magic 0xFE 'N' (0xFE never occurs in UTF-8, so JSON can't start with it)
+ * 2      1     version (1)
+ * 3      1     schema (1 = chat, libsignal payload)
+ * 4      8     created_at_unix, big-endian
+ * 12     16    message_id
+ * 28     1     from_peer_id length F
+ * 29     1     to_peer_id length T
+ * 30     4     payload length P, big-endian
+ * 34     F+T+P from_peer_id, to_peer_id (ASCII), payload
+ * ```
+ *
+ * Peers advertise the formats they read under `packet_formats` in their prekey card
+ * and prekey exchange packets; `bin1` is only sent to peers that listed it.
+ */
+object ChatPacketCodec {
+    const val FORMAT_JSON = "json"
+    const val FORMAT_BINARY_V1 = "bin1"
+    val SUPPORTED_FORMATS = listOf(FORMAT_JSON, FORMAT_BINARY_V1)
+
+    const val JSON_SCHEMA = "fidonext-chat-v1"
+    private const val JSON_PAYLOAD_TYPE = "libsignal"
+
+    private const val MAGIC_0 = 0xFE.toByte()
+    private const val MAGIC_1 = 'N'.code.toByte()
+    private const val VERSION_1: Byte = 1
+    private const val SCHEMA_CHAT_LIBSIGNAL: Byte = 1
+    const val MESSAGE_ID_BYTES = 16
+    private const val HEADER_BYTES = 34
+    private const val MAX_PEER_ID_BYTES = 255
+
+    /** Decoded or parsed chat packet. [payload] is the raw ciphertext. */
+    class ChatPacket(
+        val messageId: ByteArray,
+        val createdAtUnix: Long,
+        val fromPeerId: String,
+        val toPeerId: String,
+        val payload: ByteArray,
+    )
+
+    /**
+     * A `bin1` packet validated in place. Field accessors read the underlying buffer,
+     * which must not be reused until the view is done with.
+     */
+    class BinaryView internal constructor(
+        private val buffer: ByteBuffer,
+        private val base: Int,
+        val fromLength: Int,
+        val toLength: Int,
+        val payloadLength: Int,
+    ) {
+        // duplicate() is always big-endian, whatever order the caller left on buffer
+        val createdAtUnix: Long get() = buffer.duplicate().getLong(base + 4)
+        private val fromOffset get() = base + HEADER_BYTES
+        private val toOffset get() = fromOffset + fromLength
+        private val payloadOffset get() = toOffset + toLength
+
+        fun messageId(): ByteArray = copy(base + 12, MESSAGE_ID_BYTES)
+        fun fromPeerId(): String = ascii(fromOffset, fromLength)
+        fun toPeerId(): String = ascii(toOffset, toLength)
+
+        /** Compares to_peer_id without decoding it, so packets for other peers cost no allocation. */
+        fun isAddressedTo(peerId: ByteArray): Boolean {
+            if (peerId.size != toLength) return false
+            for (i in peerId.indices) {
+                if (buffer.get(toOffset + i) != peerId[i]) return false
+            }
+            return true
+        }
+
+        fun copyPayload(): ByteArray = copy(payloadOffset, payloadLength)
+
+        fun toPacket(): ChatPacket = ChatPacket(messageId(), createdAtUnix, fromPeerId(), toPeerId(), copyPayload())
+
+        private fun copy(offset: Int, length: Int): ByteArray {
+            val out = ByteArray(length)
+            buffer.duplicate().apply { position(offset) }.get(out)
+            return out
+        }
+
+        private fun ascii(offset: Int, length: Int): String =
+            String(copy(offset, length), StandardCharsets.US_ASCII)
+    }
+
+    /** True when the bytes between position and limit start with the `bin1` magic. */
+    fun isBinary(buffer: ByteBuffer): Boolean {
+        val start = buffer.position()
+        return buffer.remaining() >= 2 && buffer.get(start) == MAGIC_0 && buffer.get(start + 1) == MAGIC_1
+    }
+
+    fun encodeBinary(packet: ChatPacket): ByteArray {
+        val from = packet.fromPeerId.toByteArray(StandardCharsets.US_ASCII)
+        val to = packet.toPeerId.toByteArray(StandardCharsets.US_ASCII)
+        require(from.size <= MAX_PEER_ID_BYTES && to.size <= MAX_PEER_ID_BYTES) { "peer id too long" }
+        require(packet.messageId.size == MESSAGE_ID_BYTES) { "message id must be $MESSAGE_ID_BYTES bytes" }
+
+        val out = ByteBuffer.allocate(HEADER_BYTES + from.size + to.size + packet.payload.size)
+            .order(ByteOrder.BIG_ENDIAN)
+        out.put(MAGIC_0).put(MAGIC_1).put(VERSION_1).put(SCHEMA_CHAT_LIBSIGNAL)
+        out.putLong(packet.createdAtUnix)
+        out.put(packet.messageId)
+        out.put(from.size.toByte()).put(to.size.toByte())
+        out.putInt(packet.payload.size)
+        out.put(from).put(to).put(packet.payload)
+        return out.array()
+    }
+
+    /**
+     * Validates a `bin1` packet between the buffer's position and limit without copying it.
+     * Returns null for a foreign magic, unknown version/schema or inconsistent lengths.
+     */
+    fun parseBinary(buffer: ByteBuffer): BinaryView? {
+        val base = buffer.position()
+        val size = buffer.remaining()
+        if (size < HEADER_BYTES || !isBinary(buffer)) return null
+        if (buffer.get(base + 2) != VERSION_1 || buffer.get(base + 3) != SCHEMA_CHAT_LIBSIGNAL) return null
+
+        val fromLength = buffer.get(base + 28).toInt() and 0xFF
+        val toLength = buffer.get(base + 29).toInt() and 0xFF
+        val payloadLength = buffer.duplicate().getInt(base + 30)
+        if (payloadLength < 0) return null
+        if (HEADER_BYTES.toLong() + fromLength + toLength + payloadLength != size.toLong()) return null
+        return BinaryView(buffer, base, fromLength, toLength, payloadLength)
+    }
+
+    fun encodeJson(packet: ChatPacket): ByteArray = JSONObject().apply {
+        put("schema", JSON_SCHEMA)
+        put("message_id", packet.messageId.joinToString("") { "%02x".format(it) })
+        put("created_at_unix", packet.createdAtUnix)
+        put("from_peer_id", packet.fromPeerId)
+        put("to_peer_id", packet.toPeerId)
+        put("payload_type", JSON_PAYLOAD_TYPE)
+        put("payload_b64", Base64.encodeToString(packet.payload, Base64.NO_WRAP))
+    }.toString().toByteArray(StandardCharsets.UTF_8)
+
+    /** Parses a `json` chat packet; null if it is some other document or malformed. */
+    fun parseJson(text: String): ChatPacket? = try {
+        val json = JSONObject(text)
+        if (json.optString("schema") != JSON_SCHEMA || json.optString("payload_type") != JSON_PAYLOAD_TYPE) {
+            null
+        } else {
+            ChatPacket(
+                messageId = hexToBytes(json.optString("message_id")),
+                createdAtUnix = json.optLong("created_at_unix"),
+                fromPeerId = json.optString("from_peer_id"),
+                toPeerId = json.optString("to_peer_id"),
+                payload = Base64.decode(json.optString("payload_b64"), Base64.DEFAULT),
+            )
+        }
+    } catch (_: Exception) {
+        null
+    }
+
+    /** Other clients may use non-hex message ids; those map to all zeros rather than failing the packet. */
+    private fun hexToBytes(hex: String): ByteArray {
+        if (hex.length != MESSAGE_ID_BYTES * 2) return ByteArray(MESSAGE_ID_BYTES)
+        return runCatching {
+            ByteArray(MESSAGE_ID_BYTES) { i -> hex.substring(i * 2, i * 2 + 2).toInt(16).toByte() }
+        }.getOrElse { ByteArray(MESSAGE_ID_BYTES) }
+    }
+}
@@ -1,5 +1,7 @@
 package com.fidonext.messenger.rust
 
+import java.nio.ByteBuffer
+
 /**
  * Kotlin wrapper for the C-ABI libp2p Rust library.
  * This provides a type-safe interface to the FidoNext networking layer.
@@ -30,6 +32,58 @@ object Libp2pNative {
     const val DISCOVERY_EVENT_ADDRESS = 0
     const val DISCOVERY_EVENT_FINISHED = 1
 
+    // Node event kinds (NodeEvent.kind)
+    const val NODE_EVENT_AUTONAT_CHANGED = 0
+    const val NODE_EVENT_LISTEN_ADDR_ADDED = 1
+    const val NODE_EVENT_LISTEN_ADDR_REMOVED = 2
+    const val NODE_EVENT_CONNECTION_OPENED = 3
+    const val NODE_EVENT_CONNECTION_CLOSED = 4
+    const val NODE_EVENT_RESERVATION_ACCEPTED = 5
+    const val NODE_EVENT_RESERVATION_EXPIRED = 6
+
+    // Transports reported in DialResult.transport
+    const val TRANSPORT_EXISTING = 0
+    const val TRANSPORT_TCP = 1
+    const val TRANSPORT_QUIC = 2
+    const val TRANSPORT_RELAY = 3
+
+    // Async DHT operation kinds (DhtResult.op)
+    const val DHT_OP_PUT = 0
+    const val DHT_OP_GET = 1
+
+    // Indices into cabiJniAllocStats()
+    const val JNI_STATS_SCRATCH_ACQUIRES = 0
+    const val JNI_STATS_NATIVE_ALLOCATIONS = 1
+    const val JNI_STATS_NATIVE_BYTES_RESERVED = 2
+
+    // Queue overflow policies for NodeConfig.overflowPolicy
+    const val OVERFLOW_DEFAULT = 0
+    const val OVERFLOW_DROP_OLDEST = 1
+    const val OVERFLOW_DROP_NEWEST = 2
+    const val OVERFLOW_BLOCK = 3
+
+    // Slots of the tuning array passed to cabiNodeNewWithConfig()
+    const val NODE_CONFIG_MESSAGE_QUEUE_CAPACITY = 0
+    const val NODE_CONFIG_DISCOVERY_QUEUE_CAPACITY = 1
+    const val NODE_CONFIG_OVERFLOW_POLICY = 2
+    const val NODE_CONFIG_BLOCK_TIMEOUT_MS = 3
+    const val NODE_CONFIG_MAX_CONNECTIONS = 4
+    const val NODE_CONFIG_MAX_CONNECTIONS_PER_PEER = 5
+    const val NODE_CONFIG_MAX_PENDING_INCOMING = 6
+    const val NODE_CONFIG_MAX_PENDING_OUTGOING = 7
+    const val NODE_CONFIG_IDLE_TIMEOUT_MS = 8
+    const val NODE_CONFIG_YAMUX_WINDOW = 9
+    const val NODE_CONFIG_KAD_ALPHA = 10
+    const val NODE_CONFIG_KAD_REPLICATION = 11
+    const val NODE_CONFIG_WORKER_THREADS = 12
+    const val NODE_CONFIG_SLOTS = 13
+
+    // Modes of cabiJniBenchArrayAccess()
+    const val JNI_BENCH_ELEMENTS = 0
+    const val JNI_BENCH_REGION = 1
+    const val JNI_BENCH_CRITICAL = 2
+    const val JNI_BENCH_AUTO = 3
+
     /**
      * Initialize tracing for the library
      */
@@ -79,12 +133,75 @@ object Libp2pNative {
         identitySeed: ByteArray?,
     ): Long
 
+    /**
+     * Creates a node through `cabi_node_new_with_config`, passing transport,
+     * muxer, DHT and runtime knobs. Falls back to `cabi_node_new` with library
+     * defaults when the loaded library predates the config ABI.
+     * @param tuning slots indexed by NODE_CONFIG_*, usually [NodeConfig.toNativeArray]
+     */
+    external fun cabiNodeNewWithConfig(
+        useQuic: Boolean,
+        enableRelayHop: Boolean,
+        bootstrapPeers: Array<String>,
+        identitySeed: ByteArray?,
+        tuning: LongArray?,
+    ): Long
+
+    /**
+     * Node tuning for [cabiNodeNewWithConfig]. Zero keeps the library default.
+     */
+    data class NodeConfig(
+        val messageQueueCapacity: Int = 0,
+        val discoveryQueueCapacity: Int = 0,
+        val overflowPolicy: Int = OVERFLOW_DEFAULT,
+        val blockTimeoutMs: Int = 0,
+        val maxConnections: Int = 0,
+        val maxConnectionsPerPeer: Int = 0,
+        val maxPendingIncoming: Int = 0,
+        val maxPendingOutgoing: Int = 0,
+        val idleConnectionTimeoutMs: Long = 0,
+        val yamuxReceiveWindow: Int = 0,
+        val kadAlpha: Int = 0,
+        val kadReplicationFactor: Int = 0,
+        val workerThreads: Int = 0,
+    ) {
+        fun toNativeArray(): LongArray {
+            val slots = LongArray(NODE_CONFIG_SLOTS)
+            slots[NODE_CONFIG_MESSAGE_QUEUE_CAPACITY] = messageQueueCapacity.toLong()
+            slots[NODE_CONFIG_DISCOVERY_QUEUE_CAPACITY] = discoveryQueueCapacity.toLong()
+            slots[NODE_CONFIG_OVERFLOW_POLICY] = overflowPolicy.toLong()
+            slots[NODE_CONFIG_BLOCK_TIMEOUT_MS] = blockTimeoutMs.toLong()
+            slots[NODE_CONFIG_MAX_CONNECTIONS] = maxConnections.toLong()
+            slots[NODE_CONFIG_MAX_CONNECTIONS_PER_PEER] = maxConnectionsPerPeer.toLong()
+            slots[NODE_CONFIG_MAX_PENDING_INCOMING] = maxPendingIncoming.toLong()
+            slots[NODE_CONFIG_MAX_PENDING_OUTGOING] = maxPendingOutgoing.toLong()
+            slots[NODE_CONFIG_IDLE_TIMEOUT_MS] = idleConnectionTimeoutMs
+            slots[NODE_CONFIG_YAMUX_WINDOW] = yamuxReceiveWindow.toLong()
+            slots[NODE_CONFIG_KAD_ALPHA] = kadAlpha.toLong()
+            slots[NODE_CONFIG_KAD_REPLICATION] = kadReplicationFactor.toLong()
+            slots[NODE_CONFIG_WORKER_THREADS] = workerThreads.toLong()
+            return slots
+        }
+    }
+
     /**
      * Get the local peer ID for a node
      * @return Peer ID as string
      */
     external fun cabiNodeLocalPeerId(handle: Long): String?
 
+    /**
+     * Node counters, gauges and latency histograms, cheap enough to poll every second.
+     * One record per line:
+     * - `counter <name> <value>`
+     * - `gauge <name> <value>`
+     * - `histogram <name> <count> <sum_us> <min_us> <max_us> <le_us>:<cumulative> ...`
+     *
+     * Histogram buckets are log-linear with upper bounds in microseconds.
+     * @return snapshot text, or null when the library predates the metrics ABI
+     */
+    external fun cabiNodeMetricsSnapshot(handle: Long): String?
+
     /**
      * Start listening on an address
      */
@@ -95,6 +212,51 @@ object Libp2pNative {
      */
     external fun cabiNodeDial(handle: Long, address: String): Int
 
+    /**
+     * True when the library exports cabi_node_dial_peer (connection reuse, coalesced dials,
+     * address racing).
+     */
+    external fun cabiNodeDialPeerIsNative(): Boolean
+
+    /**
+     * Connects to [peerId] over the best of [addrs]. Returns at once with TRANSPORT_EXISTING
+     * when already connected; concurrent calls for the same peer share one attempt; otherwise
+     * races direct QUIC, direct TCP and relayed circuit addresses happy-eyeballs style.
+     * Without the ABI every address is dialed; the result then only says a dial was started.
+     * @return DialResult, or null on invalid arguments
+     */
+    external fun cabiNodeDialPeer(handle: Long, peerId: String, addrs: Array<String>, timeoutMs: Long): DialResult?
+
+    data class DialResult(
+        val status: Int,
+        /** TRANSPORT_* of the winning connection */
+        val transport: Int,
+        /**
+         * Time from the start of the dial to the winning connection; 0 for an existing one,
+         * -1 when unknown (without the ABI, where the connection is not awaited)
+         */
+        val connectMicros: Long,
+        /** Winning address (the first one dialed when connectMicros is -1), empty for an existing connection or on failure */
+        val address: String,
+    )
+
+    /**
+     * True when the library can save and load its routing table / address book.
+     */
+    external fun cabiNodePeerStoreIsNative(): Boolean
+
+    /**
+     * Writes the routing table, known peer addresses and reserved relays to [path]
+     * (atomically, via a temp file and rename).
+     */
+    external fun cabiNodeSavePeerStore(handle: Long, path: String): Int
+
+    /**
+     * Merges a file written by [cabiNodeSavePeerStore] into the running node.
+     * @return STATUS_NOT_FOUND when the file does not exist yet
+     */
+    external fun cabiNodeLoadPeerStore(handle: Long, path: String): Int
+
     /**
      * Find a peer in the DHT
      * @return Request ID for tracking the query, or 0 on failure
@@ -113,6 +275,31 @@ object Libp2pNative {
      */
     external fun cabiNodeDequeueDiscoveryEvent(handle: Long): DiscoveryEvent?
 
+    /**
+     * True when the library exports cabi_node_discover_neighborhood.
+     */
+    external fun cabiNodeDiscoverNeighborhoodIsNative(): Boolean
+
+    /**
+     * Runs get_closest_peers for every target at once under one request id, ending at one
+     * deadline. Each new peer arrives once as a DISCOVERY_EVENT_ADDRESS; FINISHED carries
+     * STATUS_TIMEOUT when the deadline cut the queries short.
+     * @return Request ID, or 0 on failure or without the aggregate ABI
+     */
+    external fun cabiNodeDiscoverNeighborhood(handle: Long, targetPeerIds: Array<String>, timeoutMs: Long): Long
+
+    /**
+     * True when the library can block in [cabiNodeDequeueDiscoveryEventTimeout]; otherwise
+     * that call polls once and returns.
+     */
+    external fun cabiNodeDiscoveryWaitIsNative(): Boolean
+
+    /**
+     * Waits up to timeoutMs (0 = poll) for the next discovery event of any request.
+     * @return DiscoveryEvent, or null when none arrived in time
+     */
+    external fun cabiNodeDequeueDiscoveryEventTimeout(handle: Long, timeoutMs: Long): DiscoveryEvent?
+
     data class DiscoveryEvent(
         val eventKind: Int,
         val requestId: Long,
@@ -121,6 +308,30 @@ object Libp2pNative {
         val address: String,
     )
 
+    /**
+     * True when the library pushes node events; otherwise state has to be polled.
+     */
+    external fun cabiNodeEventsIsNative(): Boolean
+
+    /**
+     * Waits up to timeoutMs (0 = poll) for the next node event. The queue is bounded and
+     * drops its oldest event when full.
+     * @return NodeEvent, or null when none arrived in time or without the events ABI
+     */
+    external fun cabiNodeDequeueNodeEvent(handle: Long, timeoutMs: Long): NodeEvent?
+
+    data class NodeEvent(
+        /** NODE_EVENT_* */
+        val kind: Int,
+        /** CLOCK_MONOTONIC nanoseconds when the node saw the change; comparable with System.nanoTime() */
+        val timestampNs: Long,
+        /** AutoNAT status for AUTONAT_CHANGED, open connections to the peer for CONNECTION_* */
+        val value: Long,
+        val peerId: String,
+        /** Multiaddr: listen address, remote address or reservation address */
+        val text: String,
+    )
+
     /**
      * Stores a binary key/value record in Kademlia DHT.
      * ttlSeconds = 0 means "node default".
@@ -133,6 +344,63 @@ object Libp2pNative {
      */
     external fun cabiNodeDhtGetRecord(handle: Long, key: ByteArray): ByteArray?
 
+    /**
+     * Blocking get like [cabiNodeDhtGetRecord] that keeps the library status, so a
+     * missing record (STATUS_NOT_FOUND) can be told apart from a failed lookup.
+     * @return DhtResult with requestId 0 and op DHT_OP_GET, or null when it could not be built
+     */
+    external fun cabiNodeDhtGetRecordResult(handle: Long, key: ByteArray): DhtResult?
+
+    /**
+     * True when the library exports cabi_node_dht_put_records, which shares closest-peers
+     * lookups between the records of one call.
+     */
+    external fun cabiNodeDhtPutRecordsIsNative(): Boolean
+
+    /**
+     * Stores keys[i] -> values[i] for every i and blocks until all are done. Falls back to
+     * one blocking put per record without the multi-put ABI.
+     * @return one status per record, or null when the arrays differ in length
+     */
+    external fun cabiNodeDhtPutRecords(
+        handle: Long,
+        keys: Array<ByteArray>,
+        values: Array<ByteArray>,
+        ttlSeconds: LongArray,
+    ): IntArray?
+
+    /**
+     * True when the library exports the non-blocking DHT calls below.
+     */
+    external fun cabiNodeDhtAsyncIsNative(): Boolean
+
+    /**
+     * Starts a DHT put and returns at once.
+     * @return request id matched by [DhtResult.requestId], or 0 on failure or without the async ABI
+     */
+    external fun cabiNodeDhtPutRecordAsync(handle: Long, key: ByteArray, value: ByteArray, ttlSeconds: Long): Long
+
+    /**
+     * Starts a DHT get and returns at once.
+     * @return request id matched by [DhtResult.requestId], or 0 on failure or without the async ABI
+     */
+    external fun cabiNodeDhtGetRecordAsync(handle: Long, key: ByteArray): Long
+
+    /**
+     * Waits up to timeoutMs (0 = poll) for the next finished async DHT operation.
+     * @return DhtResult, or null when none finished in time
+     */
+    external fun cabiNodeDequeueDhtResult(handle: Long, timeoutMs: Long): DhtResult?
+
+    data class DhtResult(
+        val requestId: Long,
+        /** DHT_OP_PUT or DHT_OP_GET */
+        val op: Int,
+        val status: Int,
+        /** Record value for a successful get, null otherwise */
+        val value: ByteArray?,
+    )
+
     /**
      * Enqueue a message to be published via gossipsub
      */
@@ -144,6 +412,15 @@ object Libp2pNative {
      */
     external fun cabiNodeDequeueMessage(handle: Long): ByteArray?
 
+    /**
+     * Dequeue a received message into a reusable direct buffer, starting at index 0.
+     * Avoids the per-message ByteArray allocation of [cabiNodeDequeueMessage].
+     * @param buffer Direct ByteBuffer; position and limit are ignored and left untouched
+     * @return Message length; -1 when the queue is empty or on error; below -1 when [buffer]
+     * is too small (negated required length, the message stays queued)
+     */
+    external fun cabiNodeDequeueMessageDirect(handle: Long, buffer: ByteBuffer): Int
+
     /**
      * Builds a signed pre-key bundle JSON document from local signal state.
      */
@@ -175,6 +452,65 @@ object Libp2pNative {
         val plaintext: ByteArray,
     )
 
+    /**
+     * Decrypts [payloads] in order with the profile loaded once, for draining a
+     * backlog after reconnecting. Falls back to per-payload calls on libraries
+     * without the batch entry point. Returns null only if the call itself failed.
+     */
+    external fun cabiE2eeDecryptMessagesAuto(profilePath: String, payloads: Array<ByteArray>): DecryptedE2eeBatch?
+
+    /** Per-item results of [cabiE2eeDecryptMessagesAuto]; plaintexts[i] is null unless statuses[i] == 0. */
+    data class DecryptedE2eeBatch(
+        val statuses: IntArray,
+        val kinds: IntArray,
+        val plaintexts: Array<ByteArray?>,
+    )
+
+    /**
+     * Open an E2EE context for a profile: identity, sessions and prekeys stay in
+     * memory and the *Ctx calls below skip per-message profile loading. On libraries
+     * without the context ABI the handle still works and each call reads the profile
+     * path as before. Returns 0 on failure; release with [cabiE2eeContextClose].
+     */
+    external fun cabiE2eeContextOpen(profilePath: String): Long
+
+    /** True when [context] is backed by an in-memory library context. */
+    external fun cabiE2eeContextIsNative(context: Long): Boolean
+
+    /** Persist pending session/prekey changes of [context]; returns a status code. */
+    external fun cabiE2eeContextFlush(context: Long): Int
+
+    /** Flush and free [context]. Calls already in flight finish first; later calls on it fail. */
+    external fun cabiE2eeContextClose(context: Long)
+
+    external fun cabiE2eeBuildPrekeyBundleCtx(context: Long, oneTimePrekeyCount: Int, ttlSeconds: Long): ByteArray?
+
+    external fun cabiE2eeBuildMessageAutoCtx(
+        context: Long,
+        recipientPrekeyBundle: ByteArray,
+        plaintext: ByteArray,
+        aad: ByteArray,
+    ): ByteArray?
+
+    external fun cabiE2eeDecryptMessageAutoCtx(context: Long, payload: ByteArray): DecryptedE2eeMessage?
+
+    external fun cabiE2eeDecryptMessagesAutoCtx(context: Long, payloads: Array<ByteArray>): DecryptedE2eeBatch?
+
+    /**
+     * Native buffer counters of the JNI layer, indexed by the JNI_STATS_* constants.
+     * Scratch and receive buffers only grow, so once traffic reaches steady state the
+     * allocation count should stop increasing while acquires keep climbing.
+     */
+    external fun cabiJniAllocStats(): LongArray?
+
+    /**
+     * Times [iterations] rounds of exposing [payload] to native code with the given
+     * JNI_BENCH_* strategy (AUTO is what the bounded wrappers use: async DHT
+     * put/get and prekey bundle validation).
+     * Returns total elapsed nanoseconds, or -1 on failure. Benchmark use only.
+     */
+    external fun cabiJniBenchArrayAccess(payload: ByteArray, mode: Int, iterations: Int): Long
+
     /**
      * Free a node handle and shutdown the node
      */
@@ -0,0 +1,201 @@
+package com.fidonext.messenger.service
+
+import android.util.Log
+import com.fidonext.messenger.rust.Libp2pNative
+import java.util.concurrent.CompletableFuture
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.TimeUnit
+import java.util.concurrent.TimeoutException
+import java.util.concurrent.atomic.AtomicBoolean
+
+/**
+ * Pipelined DHT puts and gets for one node handle. Every operation of a call is started at once
+ * through the async C-ABI and a single pump thread routes completions back by request id, so
+ * N records cost one round trip instead of N. Batches of puts go through the multi-put ABI when
+ * present. Libraries without either get the blocking calls, one after another, as before.
+ * Gets are answered from [cache] first; only the misses reach the network.
+ *
+ * Close before the node handle is freed.
+ */
+class DhtClient(
+    private val handle: Long,
+    val cache: DhtRecordCache = DhtRecordCache(),
+) : AutoCloseable {
+
+    companion object {
+        private const val TAG = "DhtClient"
+        /** How long the pump blocks in native per wait; bounds close() latency */
+        private const val PUMP_WAIT_MS = 200L
+        const val DEFAULT_TIMEOUT_MS = 30_000L
+    }
+
+    data class PutRequest(val key: ByteArray, val value: ByteArray, val ttlSeconds: Long)
+
+    val isPipelined: Boolean = Libp2pNative.cabiNodeDhtAsyncIsNative()
+
+    private val pending = ConcurrentHashMap<Long, CompletableFuture<Libp2pNative.DhtResult>>()
+    // Held while starting an operation and while routing a result, so a result that
+    // finishes before its future is registered cannot be dropped
+    private val routeLock = Any()
+    private val running = AtomicBoolean(true)
+    private val pump: Thread? = if (isPipelined) {
+        Thread({ pumpLoop() }, "dht-results").apply {
+            isDaemon = true
+            start()
+        }
+    } else null
+
+    /** Multi-put shares closest-peers lookups across records, so it beats pipelined single puts */
+    val hasMultiPut: Boolean = Libp2pNative.cabiNodeDhtPutRecordsIsNative()
+
+    /**
+     * Multi-put runs to completion in native and does not honour [timeoutMs].
+     * @return one status per record, in order; STATUS_TIMEOUT for those unfinished at the deadline
+     */
+    fun putAll(records: List<PutRequest>, timeoutMs: Long = DEFAULT_TIMEOUT_MS): IntArray {
+        if (records.isEmpty()) return IntArray(0)
+        records.forEach { cache.invalidate(it.key) }
+        if (hasMultiPut) {
+            Libp2pNative.cabiNodeDhtPutRecords(
+                handle,
+                Array(records.size) { records[it].key },
+                Array(records.size) { records[it].value },
+                LongArray(records.size) { records[it].ttlSeconds },
+            )?.let { return it }
+        }
+        if (!isPipelined) {
+            return IntArray(records.size) { i ->
+                val r = records[i]
+                Libp2pNative.cabiNodeDhtPutRecord(handle, r.key, r.value, r.ttlSeconds)
+            }
+        }
+        val futures = records.map { r ->
+            start { Libp2pNative.cabiNodeDhtPutRecordAsync(handle, r.key, r.value, r.ttlSeconds) }
+        }
+        val results = await(futures, timeoutMs)
+        return IntArray(records.size) { i -> results[i]?.status ?: Libp2pNative.STATUS_TIMEOUT }
+    }
+
+    /**
+     * Found values that pass [accept] are cached for [cacheTtlMs] (clamped by [DhtRecordCache]);
+     * NOT_FOUND is cached briefly. Rejected values, failures and timeouts are not cached.
+     * @return one value per key, in order; null when missing, rejected, failed or unfinished at the deadline
+     */
+    fun getAll(
+        keys: List<ByteArray>,
+        timeoutMs: Long = DEFAULT_TIMEOUT_MS,
+        cacheTtlMs: Long = DhtRecordCache.MAX_POSITIVE_TTL_MS,
+        accept: (ByteArray) -> Boolean = { true },
+    ): List<ByteArray?> {
+        val values = arrayOfNulls<ByteArray>(keys.size)
+        val misses = ArrayList<Int>(keys.size)
+        keys.forEachIndexed { i, key ->
+            val hit = cache.lookup(key)
+            if (hit != null) values[i] = hit.value else misses.add(i)
+        }
+        if (misses.isEmpty()) return values.toList()
+
+        if (!isPipelined) {
+            for (i in misses) {
+                values[i] = record(keys[i], Libp2pNative.cabiNodeDhtGetRecordResult(handle, keys[i]), accept, cacheTtlMs)
+            }
+            return values.toList()
+        }
+        val futures = misses.map { i -> start { Libp2pNative.cabiNodeDhtGetRecordAsync(handle, keys[i]) } }
+        await(futures, timeoutMs).forEachIndexed { n, result ->
+            val i = misses[n]
+            values[i] = record(keys[i], result, accept, cacheTtlMs)
+        }
+        return values.toList()
+    }
+
+    /** Caches a finished get and returns its value when found and accepted */
+    private fun record(
+        key: ByteArray,
+        result: Libp2pNative.DhtResult?,
+        accept: (ByteArray) -> Boolean,
+        cacheTtlMs: Long,
+    ): ByteArray? {
+        val value = result?.value
+        return when {
+            result?.status == Libp2pNative.STATUS_SUCCESS && value != null -> {
+                if (!accept(value)) return null
+                cache.putFound(key, value, cacheTtlMs)
+                value
+            }
+            result?.status == Libp2pNative.STATUS_NOT_FOUND -> {
+                cache.putNotFound(key)
+                null
+            }
+            else -> null
+        }
+    }
+
+    fun put(key: ByteArray, value: ByteArray, ttlSeconds: Long): Int =
+        putAll(listOf(PutRequest(key, value, ttlSeconds)))[0]
+
+    fun get(key: ByteArray): ByteArray? = getAll(listOf(key))[0]
+
+    /**
+     * First non-null value in key order. Pipelined, all keys cost one round trip together;
+     * with the blocking calls keys are fetched one by one and the lookup stops at the first hit.
+     * Values failing [accept] are skipped and not cached.
+     */
+    fun getFirst(keys: List<ByteArray>, accept: (ByteArray) -> Boolean = { true }): ByteArray? {
+        if (isPipelined) return getAll(keys, accept = accept).firstOrNull { it != null }
+        for (key in keys) {
+            getAll(listOf(key), accept = accept)[0]?.let { return it }
+        }
+        return null
+    }
+
+    /** Drops cached outcomes so the next get of these keys asks the network */
+    fun invalidate(vararg keys: ByteArray) {
+        keys.forEach { cache.invalidate(it) }
+    }
+
+    override fun close() {
+        if (!running.getAndSet(false)) return
+        pump?.join()
+        pending.values.forEach { it.cancel(false) }
+        pending.clear()
+    }
+
+    private fun start(launch: () -> Long): CompletableFuture<Libp2pNative.DhtResult>? {
+        synchronized(routeLock) {
+            val requestId = launch()
+            if (requestId == 0L) return null
+            return CompletableFuture<Libp2pNative.DhtResult>().also { pending[requestId] = it }
+        }
+    }
+
+    private fun await(
+        futures: List<CompletableFuture<Libp2pNative.DhtResult>?>,
+        timeoutMs: Long,
+    ): List<Libp2pNative.DhtResult?> {
+        val deadline = System.nanoTime() + TimeUnit.MILLISECONDS.toNanos(timeoutMs)
+        return futures.map { future ->
+            if (future == null) return@map null
+            try {
+                future.get((deadline - System.nanoTime()).coerceAtLeast(0L), TimeUnit.NANOSECONDS)
+            } catch (_: TimeoutException) {
+                pending.values.remove(future)
+                null
+            } catch (_: Exception) {
+                null
+            }
+        }
+    }
+
+    private fun pumpLoop() {
+        while (running.get()) {
+            val result = Libp2pNative.cabiNodeDequeueDhtResult(handle, PUMP_WAIT_MS) ?: continue
+            val future = synchronized(routeLock) { pending.remove(result.requestId) }
+            if (future == null) {
+                Log.d(TAG, "Dropping result for unknown or expired request ${result.requestId}")
+                continue
+            }
+            future.complete(result)
+        }
+    }
+}
@@ -0,0 +1,94 @@
+package com.fidonext.messenger.service
+
+import android.os.SystemClock
+
+/**
+ * LRU cache of DHT records keyed by record key. Found records live for a bounded TTL; keys the
+ * network reported as NOT_FOUND are remembered for a much shorter time so a burst of lookups
+ * for a contact that has not published yet costs one network query. Thread-safe.
+ */
+class DhtRecordCache(
+    private val capacity: Int = DEFAULT_CAPACITY,
+    private val negativeTtlMs: Long = DEFAULT_NEGATIVE_TTL_MS,
+) {
+
+    companion object {
+        const val DEFAULT_CAPACITY = 256
+        /** Shorter than the prekey retry interval, so retries still reach the network */
+        const val DEFAULT_NEGATIVE_TTL_MS = 1_000L
+        /** Found records are re-fetched at least this often (DEFAULT_DELIVERY_TTL_SECONDS) */
+        const val MAX_POSITIVE_TTL_MS = 300_000L
+        /** Floor for caller-supplied TTLs (MIN_DELIVERY_TTL_SECONDS) */
+        const val MIN_POSITIVE_TTL_MS = 10_000L
+    }
+
+    /** Outcome of [lookup]; [value] is null for a cached NOT_FOUND */
+    class Hit(val value: ByteArray?)
+
+    private class Entry(val value: ByteArray?, val expiresAtMs: Long)
+
+    // Access-ordered, so iteration starts at the least recently used entry
+    private val entries = LinkedHashMap<String, Entry>(16, 0.75f, true)
+
+    private var hits = 0L
+    private var negativeHits = 0L
+    private var misses = 0L
+    private var evictions = 0L
+
+    /** @return the cached outcome for [key], or null when the network must be asked */
+    fun lookup(key: ByteArray): Hit? = synchronized(this) {
+        val id = idOf(key)
+        val entry = entries[id]
+        if (entry == null || entry.expiresAtMs <= SystemClock.elapsedRealtime()) {
+            if (entry != null) entries.remove(id)
+            misses++
+            return null
+        }
+        if (entry.value == null) negativeHits++ else hits++
+        Hit(entry.value)
+    }
+
+    /** Caches a found record for [ttlMs], clamped to the delivery TTL bounds */
+    fun putFound(key: ByteArray, value: ByteArray, ttlMs: Long = MAX_POSITIVE_TTL_MS) {
+        val ttl = ttlMs.coerceIn(MIN_POSITIVE_TTL_MS, MAX_POSITIVE_TTL_MS)
+        store(key, Entry(value, SystemClock.elapsedRealtime() + ttl))
+    }
+
+    fun putNotFound(key: ByteArray) {
+        store(key, Entry(null, SystemClock.elapsedRealtime() + negativeTtlMs))
+    }
+
+    fun invalidate(key: ByteArray) {
+        synchronized(this) { entries.remove(idOf(key)) }
+    }
+
+    fun clear() {
+        synchronized(this) { entries.clear() }
+    }
+
+    /** Counters and size in the node metrics text format, so they can be dumped alongside it */
+    fun metricsText(): String = synchronized(this) {
+        buildString {
+            append("counter dht_cache_hit ").append(hits).append('\n')
+            append("counter dht_cache_negative_hit ").append(negativeHits).append('\n')
+            append("counter dht_cache_miss ").append(misses).append('\n')
+            append("counter dht_cache_eviction ").append(evictions).append('\n')
+            append("gauge dht_cache_entries ").append(entries.size).append('\n')
+        }
+    }
+
+    private fun store(key: ByteArray, entry: Entry) {
+        synchronized(this) {
+            entries[idOf(key)] = entry
+            val oldest = entries.keys.iterator()
+            while (entries.size > capacity && oldest.hasNext()) {
+                oldest.next()
+                oldest.remove()
+                evictions++
+            }
+        }
+    }
+
+    // ISO-8859-1 maps every byte to one char, so distinct keys stay distinct
+    private fun idOf(key: ByteArray): String = String(key, Charsets.ISO_8859_1)
+}
@@ -0,0 +1,162 @@
+package com.fidonext.messenger.service
+
+import android.util.Log
+import com.fidonext.messenger.rust.Libp2pNative
+import java.util.concurrent.ConcurrentHashMap
+import java.util.concurrent.LinkedBlockingQueue
+import java.util.concurrent.TimeUnit
+import java.util.concurrent.atomic.AtomicBoolean
+
+/**
+ * Kademlia find_peer / get_closest_peers for one node handle. The node has a single discovery
+ * queue, so one pump thread drains it and routes every event to the queue of the request that
+ * started it; concurrent queries no longer consume each other's events. While no query is
+ * running the pump is parked and never calls into native. Otherwise, with the blocking dequeue
+ * ABI it sleeps in native until an event arrives; older libraries are polled at
+ * [FALLBACK_POLL_MS], once for all queries.
+ *
+ * Close before the node handle is freed.
+ */
+class DiscoveryClient(private val handle: Long) : AutoCloseable {
+
+    companion object {
+        private const val TAG = "DiscoveryClient"
+        /** How long the pump blocks in native per wait; bounds close() latency */
+        private const val PUMP_WAIT_MS = 200L
+        private const val FALLBACK_POLL_MS = 20L
+    }
+
+    /**
+     * One running query, or several merged into one stream; events arrive in [events] until
+     * every request id has FINISHED or [close]
+     */
+    inner class Query internal constructor(val requestIds: List<Long>) : AutoCloseable {
+        internal val events = LinkedBlockingQueue<Libp2pNative.DiscoveryEvent>()
+
+        /**
+         * Hands every event to [onEvent] until all requests FINISHED or [deadlineMs] (wall clock).
+         * Events already queued are delivered even past the deadline.
+         * @return true when every request finished successfully before the deadline
+         */
+        fun collect(deadlineMs: Long, onEvent: (Libp2pNative.DiscoveryEvent) -> Unit): Boolean {
+            var running = requestIds.size
+            var completed = true
+            try {
+                while (running > 0) {
+                    val remaining = deadlineMs - System.currentTimeMillis()
+                    val event = (if (remaining > 0) events.poll(remaining, TimeUnit.MILLISECONDS) else events.poll())
+                        ?: return false
+                    if (event.eventKind == Libp2pNative.DISCOVERY_EVENT_FINISHED) {
+                        Log.d(TAG, "Discovery finished for request_id=${event.requestId} status=${event.statusCode}")
+                        if (event.statusCode != Libp2pNative.STATUS_SUCCESS) completed = false
+                        running--
+                        continue
+                    }
+                    onEvent(event)
+                }
+                return completed
+            } finally {
+                close()
+            }
+        }
+
+        override fun close() {
+            synchronized(routeLock) { requestIds.forEach { queries.remove(it) } }
+        }
+    }
+
+    val isWaitNative: Boolean = Libp2pNative.cabiNodeDiscoveryWaitIsNative()
+    val hasNeighborhood: Boolean = Libp2pNative.cabiNodeDiscoverNeighborhoodIsNative()
+
+    private val queries = ConcurrentHashMap<Long, Query>()
+    // Held while starting a query and while routing an event, so an event that
+    // arrives before its query is registered cannot be dropped. Also the monitor
+    // the pump parks on while no query is running.
+    private val routeLock = Object()
+    private val running = AtomicBoolean(true)
+    private val pump = Thread({ pumpLoop() }, "discovery-events").apply {
+        isDaemon = true
+        start()
+    }
+
+    /** @return the running query, or null when the node refused to start it */
+    fun findPeer(peerId: String): Query? = start { Libp2pNative.cabiNodeFindPeer(handle, peerId) }
+
+    /** @return the running query, or null when the node refused to start it */
+    fun getClosestPeers(peerId: String): Query? = start { Libp2pNative.cabiNodeGetClosestPeers(handle, peerId) }
+
+    /**
+     * Peers closest to any of [targets], each reported once to [onPeer] as soon as a query
+     * returns it, until all queries finish or [timeoutMs] passes. Uses the native aggregate
+     * when present; otherwise one get_closest_peers per target merged into one stream.
+     * @return every peer id found, excluding [excludePeerId]
+     */
+    fun discoverNeighborhood(
+        targets: List<String>,
+        excludePeerId: String?,
+        timeoutMs: Long,
+        onPeer: (peerId: String, address: String) -> Unit = { _, _ -> },
+    ): Set<String> {
+        if (targets.isEmpty()) return emptySet()
+        val deadline = System.currentTimeMillis() + timeoutMs
+        val query = if (hasNeighborhood) {
+            start { Libp2pNative.cabiNodeDiscoverNeighborhood(handle, targets.toTypedArray(), timeoutMs) }
+        } else {
+            startAll(targets.map { target -> { Libp2pNative.cabiNodeGetClosestPeers(handle, target) } })
+        } ?: return emptySet()
+
+        val found = LinkedHashSet<String>()
+        query.collect(deadline) { event ->
+            if (event.eventKind != Libp2pNative.DISCOVERY_EVENT_ADDRESS) return@collect
+            val pid = event.peerId.trim()
+            if (pid.isEmpty() || pid == excludePeerId || !found.add(pid)) return@collect
+            onPeer(pid, event.address.trim())
+        }
+        return found
+    }
+
+    override fun close() {
+        if (!running.getAndSet(false)) return
+        synchronized(routeLock) { routeLock.notifyAll() }
+        pump.join()
+        queries.clear()
+    }
+
+    private fun start(launch: () -> Long): Query? = startAll(listOf(launch))
+
+    /** Starts every query under one [Query]; null when none started */
+    private fun startAll(launches: List<() -> Long>): Query? {
+        synchronized(routeLock) {
+            val requestIds = launches.map { it() }.filter { it != 0L }
+            if (requestIds.isEmpty()) return null
+            return Query(requestIds).also { query ->
+                requestIds.forEach { queries[it] = query }
+                routeLock.notifyAll()
+            }
+        }
+    }
+
+    private fun pumpLoop() {
+        while (running.get()) {
+            synchronized(routeLock) {
+                while (running.get() && queries.isEmpty()) routeLock.wait()
+            }
+            if (!running.get()) break
+            val event = if (isWaitNative) {
+                Libp2pNative.cabiNodeDequeueDiscoveryEventTimeout(handle, PUMP_WAIT_MS)
+            } else {
+                Libp2pNative.cabiNodeDequeueDiscoveryEvent(handle)
+            }
+            if (event == null) {
+                if (!isWaitNative) Thread.sleep(FALLBACK_POLL_MS)
+                continue
+            }
+            val query = synchronized(routeLock) { queries[event.requestId] }
+            if (query == null) {
+                Log.d(TAG, "Dropping discovery event for unknown or expired request ${event.requestId}")
+                continue
+            }
+            query.events.add(event)
+        }
+    }
+}
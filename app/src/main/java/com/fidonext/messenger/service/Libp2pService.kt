@@ -5,15 +5,19 @@ import android.app.NotificationChannel
 import android.app.NotificationManager
 import android.app.Service
 import android.content.Intent
+import android.content.pm.ApplicationInfo
 import android.os.Build
 import android.os.IBinder
 import android.util.Log
 import androidx.core.app.NotificationCompat
 import com.fidonext.messenger.ILibp2pService
 import com.fidonext.messenger.R
+import com.fidonext.messenger.bench.MicroBenchmarks
+import com.fidonext.messenger.protocol.ChatPacketCodec
 import com.fidonext.messenger.rust.Libp2pNative
 import kotlinx.coroutines.*
 import org.json.JSONObject
+import java.nio.ByteBuffer
 import java.nio.charset.StandardCharsets
 import java.util.UUID
 import java.util.concurrent.ConcurrentHashMap
@@ -27,6 +31,9 @@ import java.util.concurrent.atomic.AtomicLong
 class Libp2pService : Service() {
 
     companion object {
+        /** Boolean start extra: run [MicroBenchmarks] once (debuggable builds only) */
+        const val EXTRA_RUN_BENCHMARKS = "run_benchmarks"
+
         private const val TAG = "Libp2pService"
         private const val NOTIFICATION_ID = 1001
         private const val CHANNEL_ID = "libp2p_service_channel"
@@ -34,6 +41,23 @@ class Libp2pService : Service() {
        // private const val MESSAGE_POLL_INTERVAL_MS = 100L
         /** Re-announce directory+prekey to DHT periodically (mirrors Python _announce_loop) */
         private const val DIRECTORY_REANNOUNCE_INTERVAL_MS = 10 * 60 * 1000L
+        /** Routing table / address book snapshot written at this interval and before the node is freed */
+        private const val PEER_STORE_SAVE_INTERVAL_MS = 5 * 60 * 1000L
+        /** Session/prekey changes held by an in-memory E2EE context are persisted at this interval */
+        private const val E2EE_FLUSH_INTERVAL_MS = 30 * 1000L
+        /** Node metrics snapshot dumped to logcat at this interval */
+        private const val METRICS_DUMP_INTERVAL_MS = 60 * 1000L
+        /** Initial size of the pooled inbound buffer; grows to the largest message seen */
+        private const val INBOUND_BUFFER_INITIAL_BYTES = 64 * 1024
+        /** Most chat packets decrypted per native call when a backlog is waiting */
+        private const val DECRYPT_BATCH_MAX = 64
+        /** Deadline for one cabi_node_dial_peer race */
+        private const val DIAL_TIMEOUT_MS = 10_000L
+        /**
+         * Node tuning passed to cabiNodeNewWithConfig. All zero: the library defaults, until
+         * phone-sized values have been measured on devices.
+         */
+        private val NODE_CONFIG = Libp2pNative.NodeConfig()
 
         init {
             // Load native libraries
@@ -43,18 +67,41 @@ class Libp2pService : Service() {
     }
 
     private var nodeHandle: Long = 0
+    /** Held by every peer store save and by the final save + free, so saves never overlap or outlive the handle */
+    private val peerStoreLock = Any()
+    /** Pipelined DHT access for nodeHandle; closed before the node is freed */
+    @Volatile
+    private var dht: DhtClient? = null
+    /** DHT records seen by this service; outlives node restarts since records live in the network */
+    private val dhtCache = DhtRecordCache()
+    /** Routes discovery events to their find_peer / get_closest_peers query; closed before the node is freed */
+    @Volatile
+    private var discovery: DiscoveryClient? = null
+    /** AutoNAT / address / connection / reservation changes pushed by the node; closed before it is freed */
+    @Volatile
+    private var nodeEvents: NodeEventStream? = null
     private val isRunning = AtomicBoolean(false)
     private val lastHealthCheck = AtomicLong(0)
     private val serviceScope = CoroutineScope(Dispatchers.Default + SupervisorJob())
     /** Bootstrap peers used at init; restored on health-check restart */
     private var lastBootstrapPeers: Array<String> = emptyArray()
     private var profilePath: String? = null
+    /** E2EE context over [profilePath], opened once so messages don't reload the profile */
+    @Volatile
+    private var e2eeContext: Long = 0
     private var localAccountId: String? = null
     private var localDeviceId: String? = null
     private var localPeerId: String? = null
     private var activeRecipientPeerId: String? = null
     /** Cached prekey bundle per peer_id (filled when opening chat / setActiveRecipient), used when sending. */
     private val recipientPrekeyCache = ConcurrentHashMap<String, ByteArray>()
+    /** Peers that advertised the binary chat packet format ([ChatPacketCodec.FORMAT_BINARY_V1]). */
+    private val binaryPacketPeers = ConcurrentHashMap.newKeySet<String>()
+    /** Pooled direct buffer the native layer dequeues into; guarded by [inboundLock]. */
+    private var inboundBuffer: ByteBuffer = ByteBuffer.allocateDirect(INBOUND_BUFFER_INITIAL_BYTES)
+    private val inboundLock = Any()
+    /** Decrypted chat JSON not yet handed to the UI; guarded by [inboundLock]. */
+    private val decryptedBacklog = ArrayDeque<String>()
 
     /** Returns cached account ID; use from binder to avoid getter name clash with getLocalAccountId(). */
     private fun cachedAccountId(): String? = localAccountId
@@ -125,9 +172,9 @@ class Libp2pService : Service() {
                 Log.w(TAG, "sendEncryptedMessage failed: no active recipient set")
                 return false
             }
-            val profile = profilePath
-            if (profile == null) {
-                Log.w(TAG, "sendEncryptedMessage failed: no profile path")
+            val context = e2eeContext
+            if (context == 0L) {
+                Log.w(TAG, "sendEncryptedMessage failed: no E2EE context")
                 return false
             }
             val fromPeerId = Libp2pNative.cabiNodeLocalPeerId(nodeHandle)
@@ -142,28 +189,35 @@ class Libp2pService : Service() {
                 return false
             }
 
-            val encrypted = Libp2pNative.cabiE2eeBuildMessageAuto(
-                profilePath = profile,
+            val encrypted = Libp2pNative.cabiE2eeBuildMessageAutoCtx(
+                context = context,
                 recipientPrekeyBundle = prekeyBundle,
                 plaintext = (plaintext ?: "").toByteArray(StandardCharsets.UTF_8),
                 aad = ByteArray(0),
             )
             if (encrypted == null) {
-                Log.w(TAG, "sendEncryptedMessage failed: cabiE2eeBuildMessageAuto returned null for peer_id=$toPeerId")
+                Log.w(TAG, "sendEncryptedMessage failed: cabiE2eeBuildMessageAutoCtx returned null for peer_id=$toPeerId")
                 return false
             }
 
-            val packet = JSONObject().apply {
-                put("schema", "fidonext-chat-v1")
-                put("message_id", UUID.randomUUID().toString().replace("-", ""))
-                put("created_at_unix", System.currentTimeMillis() / 1000L)
-                put("from_peer_id", fromPeerId)
-                put("to_peer_id", toPeerId)
-                put("payload_type", "libsignal")
-                put("payload_b64", android.util.Base64.encodeToString(encrypted, android.util.Base64.NO_WRAP))
-            }
+            val messageId = UUID.randomUUID()
+            val packet = ChatPacketCodec.ChatPacket(
+                messageId = ByteBuffer.allocate(ChatPacketCodec.MESSAGE_ID_BYTES)
+                    .putLong(messageId.mostSignificantBits)
+                    .putLong(messageId.leastSignificantBits)
+                    .array(),
+                createdAtUnix = System.currentTimeMillis() / 1000L,
+                fromPeerId = fromPeerId,
+                toPeerId = toPeerId,
+                payload = encrypted,
+            )
 
-            val bytes = packet.toString().toByteArray(StandardCharsets.UTF_8)
+            // Binary framing only for peers that said they read it; everyone else gets JSON
+            val bytes = if (toPeerId in binaryPacketPeers) {
+                ChatPacketCodec.encodeBinary(packet)
+            } else {
+                ChatPacketCodec.encodeJson(packet)
+            }
             val status = Libp2pNative.cabiNodeEnqueueMessage(nodeHandle, bytes)
             if (status != Libp2pNative.STATUS_SUCCESS) {
                 Log.w(TAG, "sendEncryptedMessage failed: cabiNodeEnqueueMessage returned $status")
@@ -174,9 +228,9 @@ class Libp2pService : Service() {
 
         override fun receiveDecryptedMessage(): String? {
             if (nodeHandle == 0L) return null
-            val profile = profilePath ?: return null
-            val payload = Libp2pNative.cabiNodeDequeueMessage(nodeHandle) ?: return null
-            return this@Libp2pService.tryDecryptChatPacket(profile, payload)
+            val context = e2eeContext
+            if (context == 0L) return null
+            return this@Libp2pService.nextDecryptedMessage(nodeHandle, context)
         }
 
         override fun getAutonatStatus(): Int {
@@ -209,10 +263,20 @@ class Libp2pService : Service() {
         // Start health monitoring
         startHealthMonitoring()
         startPeriodicReannounce()
+        startMetricsDump()
+        startPeerStoreSave()
+        startE2eeFlush()
     }
 
     override fun onStartCommand(intent: Intent?, flags: Int, startId: Int): Int {
         Log.d(TAG, "Service started")
+        if (intent?.getBooleanExtra(EXTRA_RUN_BENCHMARKS, false) == true) {
+            if (applicationInfo.flags and ApplicationInfo.FLAG_DEBUGGABLE != 0) {
+                serviceScope.launch(Dispatchers.IO) { MicroBenchmarks.runAll() }
+            } else {
+                Log.w(TAG, "Ignoring benchmark request in a non-debuggable build")
+            }
+        }
         return START_STICKY // Restart service if killed
     }
 
@@ -227,9 +291,17 @@ class Libp2pService : Service() {
         isRunning.set(false)
         serviceScope.cancel()
 
-        if (nodeHandle != 0L) {
-            Libp2pNative.cabiNodeFree(nodeHandle)
-            nodeHandle = 0
+        dht?.close()
+        dht = null
+        discovery?.close()
+        discovery = null
+        nodeEvents?.close()
+        nodeEvents = null
+        // Saves the peer store and frees the node; waits for any periodic save in flight
+        saveAndFreeNode()
+        if (e2eeContext != 0L) {
+            Libp2pNative.cabiE2eeContextClose(e2eeContext)
+            e2eeContext = 0
         }
     }
 
@@ -253,18 +325,38 @@ class Libp2pService : Service() {
             }
             localAccountId = identity.accountId
             localDeviceId = identity.deviceId
+            if (e2eeContext == 0L) {
+                e2eeContext = Libp2pNative.cabiE2eeContextOpen(profile)
+                if (e2eeContext == 0L) {
+                    Log.e(TAG, "Failed to open E2EE context")
+                    return false
+                }
+                Log.i(TAG, "E2EE context opened (in-memory=${Libp2pNative.cabiE2eeContextIsNative(e2eeContext)})")
+            }
 
-            nodeHandle = Libp2pNative.cabiNodeNewWithSeed(
+            nodeHandle = Libp2pNative.cabiNodeNewWithConfig(
                 useQuic = false,
                 enableRelayHop = false,
                 bootstrapPeers = bootstrapPeers,
-                identitySeed = identity.libp2pSeed
+                identitySeed = identity.libp2pSeed,
+                tuning = NODE_CONFIG.toNativeArray()
             )
 
             if (nodeHandle == 0L) {
                 Log.e(TAG, "Failed to create node")
                 return false
             }
+            dht = DhtClient(nodeHandle, dhtCache).also {
+                Log.i(TAG, "DHT client ready (pipelined=${it.isPipelined})")
+            }
+            discovery = DiscoveryClient(nodeHandle).also {
+                Log.i(TAG, "Discovery client ready (blocking wait=${it.isWaitNative})")
+            }
+            nodeEvents = NodeEventStream(nodeHandle, ::onNodeEvent).also {
+                Log.i(TAG, "Node events ready (pushed=${it.isNative})")
+            }
+            // Before the first lookup, so it starts from the buckets the last run filled
+            loadPeerStore(nodeHandle)
 
             isRunning.set(true)
 
@@ -356,8 +448,64 @@ class Libp2pService : Service() {
     private fun prekeyKeyForAccount(accountId: String): ByteArray =
         "fidonext/prekey/v1/account/$accountId".toByteArray(StandardCharsets.UTF_8)
 
+    /**
+     * First value in key order that passes [accept]. One DHT round trip for all keys when
+     * pipelined; otherwise one per key tried, stopping at the first hit. Only accepted
+     * values are cached.
+     */
+    private fun dhtGetFirst(vararg keys: ByteArray, accept: (ByteArray) -> Boolean = { true }): ByteArray? {
+        val client = dht ?: return null
+        return client.getFirst(keys.toList(), accept)
+    }
+
+    /** Drops cached directory cards of [ids] (peer or account ids) so the next lookup refetches them */
+    private fun invalidateDirectory(vararg ids: String) {
+        val client = dht ?: return
+        ids.forEach { client.invalidate(directoryKeyForPeer(it), directoryKeyForAccount(it)) }
+    }
+
+    /** Drops cached prekey records of [ids] (peer or account ids) */
+    private fun invalidatePrekeys(vararg ids: String) {
+        val client = dht ?: return
+        ids.forEach { client.invalidate(prekeyKeyForPeer(it), prekeyKeyForAccount(it)) }
+    }
+
+    private fun isDirectoryCard(raw: ByteArray): Boolean = try {
+        JSONObject(String(raw, StandardCharsets.UTF_8)).optString("schema") == "fidonext-directory-v1"
+    } catch (_: Exception) {
+        false
+    }
+
+    /**
+     * Checks schema, bundle_b64 and the bundle itself.
+     * @return the card and the decoded bundle, or null (logged) when any check fails
+     */
+    private fun parsePrekeyRecord(raw: ByteArray, what: String): Pair<JSONObject, ByteArray>? {
+        return try {
+            val card = JSONObject(String(raw, StandardCharsets.UTF_8))
+            if (card.optString("schema") != "fidonext-prekey-bundle-v1") {
+                Log.w(TAG, "fetchRecipientPrekeyBundle: invalid schema in DHT record for $what")
+                return null
+            }
+            val bundleB64 = card.optString("bundle_b64")
+            if (bundleB64.isNullOrBlank()) {
+                Log.w(TAG, "fetchRecipientPrekeyBundle: empty bundle_b64 in DHT record for $what")
+                return null
+            }
+            val bundle = android.util.Base64.decode(bundleB64, android.util.Base64.DEFAULT)
+            val status = Libp2pNative.cabiE2eeValidatePrekeyBundle(bundle, 0L)
+            if (status != Libp2pNative.STATUS_SUCCESS) {
+                Log.w(TAG, "fetchRecipientPrekeyBundle: bundle validation failed for $what status=$status")
+                return null
+            }
+            card to bundle
+        } catch (e: Exception) {
+            Log.w(TAG, "fetchRecipientPrekeyBundle: exception parsing DHT record for $what", e)
+            null
+        }
+    }
+
     private fun announceSelf(): Boolean {
-        val handle = nodeHandle
         val peerId = localPeerId ?: run {
             Log.w(TAG, "announceSelf: localPeerId is null")
             return false
@@ -370,8 +518,9 @@ class Libp2pService : Service() {
             Log.w(TAG, "announceSelf: localDeviceId is null")
             return false
         }
-        val profile = profilePath ?: run {
-            Log.w(TAG, "announceSelf: profilePath is null")
+        val context = e2eeContext
+        if (context == 0L) {
+            Log.w(TAG, "announceSelf: no E2EE context")
             return false
         }
 
@@ -386,12 +535,12 @@ class Libp2pService : Service() {
             put("addresses", org.json.JSONArray())
         }.toString().toByteArray(StandardCharsets.UTF_8)
 
-        val bundle = Libp2pNative.cabiE2eeBuildPrekeyBundle(
-            profilePath = profile,
+        val bundle = Libp2pNative.cabiE2eeBuildPrekeyBundleCtx(
+            context = context,
             oneTimePrekeyCount = 32,
             ttlSeconds = 24 * 60 * 60L,
         ) ?: run {
-            Log.e(TAG, "announceSelf: cabiE2eeBuildPrekeyBundle returned null")
+            Log.e(TAG, "announceSelf: cabiE2eeBuildPrekeyBundleCtx returned null")
             return false
         }
 
@@ -402,13 +551,29 @@ class Libp2pService : Service() {
             put("account_id", accountId)
             put("device_id", deviceId)
             put("bundle_b64", android.util.Base64.encodeToString(bundle, android.util.Base64.NO_WRAP))
+            put("packet_formats", org.json.JSONArray(ChatPacketCodec.SUPPORTED_FORMATS))
         }.toString().toByteArray(StandardCharsets.UTF_8)
 
+        val client = dht ?: run {
+            Log.w(TAG, "announceSelf: node not initialized")
+            return false
+        }
+
         Log.d(TAG, "announceSelf: Publishing DHT records for peer_id=$peerId account_id=$accountId")
-        val ok1 = Libp2pNative.cabiNodeDhtPutRecord(handle, directoryKeyForPeer(peerId), directoryCard, 30 * 60L) == Libp2pNative.STATUS_SUCCESS
-        val ok2 = Libp2pNative.cabiNodeDhtPutRecord(handle, directoryKeyForAccount(accountId), directoryCard, 30 * 60L) == Libp2pNative.STATUS_SUCCESS
-        val ok3 = Libp2pNative.cabiNodeDhtPutRecord(handle, prekeyKeyForPeer(peerId), prekeyCard, 24 * 60 * 60L) == Libp2pNative.STATUS_SUCCESS
-        val ok4 = Libp2pNative.cabiNodeDhtPutRecord(handle, prekeyKeyForAccount(accountId), prekeyCard, 24 * 60 * 60L) == Libp2pNative.STATUS_SUCCESS
+        val started = System.nanoTime()
+        val statuses = client.putAll(
+            listOf(
+                DhtClient.PutRequest(directoryKeyForPeer(peerId), directoryCard, 30 * 60L),
+                DhtClient.PutRequest(directoryKeyForAccount(accountId), directoryCard, 30 * 60L),
+                DhtClient.PutRequest(prekeyKeyForPeer(peerId), prekeyCard, 24 * 60 * 60L),
+                DhtClient.PutRequest(prekeyKeyForAccount(accountId), prekeyCard, 24 * 60 * 60L),
+            )
+        )
+        Log.d(TAG, "announceSelf: puts finished in ${(System.nanoTime() - started) / 1_000_000} ms (multi-put=${client.hasMultiPut})")
+        val ok1 = statuses[0] == Libp2pNative.STATUS_SUCCESS
+        val ok2 = statuses[1] == Libp2pNative.STATUS_SUCCESS
+        val ok3 = statuses[2] == Libp2pNative.STATUS_SUCCESS
+        val ok4 = statuses[3] == Libp2pNative.STATUS_SUCCESS
 
         if (ok1 && ok2 && ok3 && ok4) {
             Log.i(TAG, "announceSelf: Successfully published all 4 DHT records (directory x2, prekey x2)")
@@ -422,9 +587,7 @@ class Libp2pService : Service() {
     private fun resolvePeerId(identifier: String): String? {
         // If it's already a peer id (heuristic), use it.
         if (identifier.startsWith("12D3") || identifier.startsWith("Qm")) return identifier
-        val handle = nodeHandle
-        val raw = Libp2pNative.cabiNodeDhtGetRecord(handle, directoryKeyForAccount(identifier))
-            ?: Libp2pNative.cabiNodeDhtGetRecord(handle, directoryKeyForPeer(identifier))
+        val raw = dhtGetFirst(directoryKeyForAccount(identifier), directoryKeyForPeer(identifier), accept = ::isDirectoryCard)
             ?: return null
         return try {
             val card = JSONObject(String(raw, StandardCharsets.UTF_8))
@@ -438,9 +601,7 @@ class Libp2pService : Service() {
      * Get addresses from DHT directory card for peer_id or account_id, if present.
      */
     private fun getDirectoryAddresses(identifier: String): List<String> {
-        val handle = nodeHandle
-        val raw = Libp2pNative.cabiNodeDhtGetRecord(handle, directoryKeyForAccount(identifier))
-            ?: Libp2pNative.cabiNodeDhtGetRecord(handle, directoryKeyForPeer(identifier))
+        val raw = dhtGetFirst(directoryKeyForAccount(identifier), directoryKeyForPeer(identifier), accept = ::isDirectoryCard)
             ?: return emptyList()
         return try {
             val card = JSONObject(String(raw, StandardCharsets.UTF_8))
@@ -458,31 +619,17 @@ class Libp2pService : Service() {
      * Mirrors Python resolve_peer_addresses.
      */
     private fun resolvePeerAddresses(peerId: String, timeoutMs: Long): List<String> {
-        val handle = nodeHandle
-        val requestId = Libp2pNative.cabiNodeFindPeer(handle, peerId)
-        if (requestId == 0L) {
+        val client = discovery ?: return emptyList()
+        val query = client.findPeer(peerId) ?: run {
             Log.w(TAG, "find_peer failed for peer_id=$peerId")
             return emptyList()
         }
         val deadline = System.currentTimeMillis() + timeoutMs.coerceAtLeast(1000L)
         val addresses = mutableListOf<String>()
-        while (System.currentTimeMillis() < deadline) {
-            val event = Libp2pNative.cabiNodeDequeueDiscoveryEvent(handle)
-            if (event == null) {
-                Thread.sleep(100)
-                continue
-            }
-            if (event.requestId != requestId) continue
-            when (event.eventKind) {
-                Libp2pNative.DISCOVERY_EVENT_ADDRESS -> {
-                    val addr = event.address.trim()
-                    if (addr.isNotEmpty() && addr !in addresses) addresses.add(addr)
-                }
-                Libp2pNative.DISCOVERY_EVENT_FINISHED -> {
-                    Log.d(TAG, "Discovery finished for request_id=$requestId status=${event.statusCode}")
-                    break
-                }
-            }
+        query.collect(deadline) { event ->
+            if (event.eventKind != Libp2pNative.DISCOVERY_EVENT_ADDRESS) return@collect
+            val addr = event.address.trim()
+            if (addr.isNotEmpty() && addr !in addresses) addresses.add(addr)
         }
         return addresses
     }
@@ -497,69 +644,43 @@ class Libp2pService : Service() {
         return multiaddr.substring(idx + p2p.length).trim().takeIf { it.isNotEmpty() }
     }
 
-    /**
-     * Run get_closest_peers for one target and collect peer IDs until deadline or FINISHED.
-     */
-    private fun collectClosestPeers(handle: Long, targetPeerId: String, excludePeerId: String?, deadlineMs: Long): Set<String> {
-        val requestId = Libp2pNative.cabiNodeGetClosestPeers(handle, targetPeerId)
-        if (requestId == 0L) return emptySet()
-        val result = mutableSetOf<String>()
-        while (System.currentTimeMillis() < deadlineMs) {
-            val event = Libp2pNative.cabiNodeDequeueDiscoveryEvent(handle)
-            if (event == null) {
-                Thread.sleep(60)
-                continue
-            }
-            if (event.requestId != requestId) continue
-            when (event.eventKind) {
-                Libp2pNative.DISCOVERY_EVENT_ADDRESS -> {
-                    val pid = event.peerId.trim()
-                    if (pid.isNotEmpty() && pid != excludePeerId) result.add(pid)
-                }
-                Libp2pNative.DISCOVERY_EVENT_FINISHED -> break
-            }
-        }
-        return result
-    }
-
     /**
      * Discover peers via DHT: get_closest_peers(self) and get_closest_peers(bootstrap relay).
-     * Returns peer_id strings excluding our own. Blocks for up to ~30s (longer timeout for relay/NAT).
+     * All queries run at once and share one deadline, so this blocks for at most ~15s however
+     * many relays there are (longer timeout for relay/NAT).
      * Mirrors Python resolve_peer_addresses timeout of 12s + Rust discovery patterns.
      */
     private fun getDiscoveredPeers(discoveryTimeoutMs: Long = 15_000L): Array<String> {
-        val handle = nodeHandle
+        val client = discovery
         val me = localPeerId
-        if (handle == 0L || me.isNullOrBlank()) {
+        if (client == null || me.isNullOrBlank()) {
             Log.w(TAG, "getDiscoveredPeers: nodeHandle or localPeerId invalid")
             return emptyArray()
         }
-        val all = mutableSetOf<String>()
-        // 1) Peers close to us (longer timeout - examples show DHT can be slow behind relay)
-        val deadline1 = System.currentTimeMillis() + discoveryTimeoutMs.coerceAtLeast(10_000L)
-        Log.d(TAG, "getDiscoveredPeers: querying closest peers to self ($me)")
-        all.addAll(collectClosestPeers(handle, me, me, deadline1))
-        Log.d(TAG, "getDiscoveredPeers: found ${all.size} peers close to self")
-
-        // 2) Peers close to each bootstrap relay (increases chance to see other clients via same relay)
-        for (multiaddr in lastBootstrapPeers) {
-            val relayPeerId = peerIdFromMultiaddr(multiaddr) ?: continue
-            if (relayPeerId == me) continue
-            val deadline2 = System.currentTimeMillis() + 10_000L
-            Log.d(TAG, "getDiscoveredPeers: querying closest peers to relay ($relayPeerId)")
-            val relayPeers = collectClosestPeers(handle, relayPeerId, me, deadline2)
-            Log.d(TAG, "getDiscoveredPeers: found ${relayPeers.size} peers close to relay")
-            all.addAll(relayPeers)
-        }
-        Log.d(TAG, "getDiscoveredPeers: total found ${all.size} peers")
+        // Peers close to us, plus peers close to each bootstrap relay (increases chance to see
+        // other clients via same relay)
+        val targets = (listOf(me) + lastBootstrapPeers.mapNotNull { peerIdFromMultiaddr(it) }).distinct()
+        Log.d(TAG, "getDiscoveredPeers: querying closest peers to ${targets.size} targets (native=${client.hasNeighborhood})")
+        val started = System.currentTimeMillis()
+        val all = client.discoverNeighborhood(targets, me, discoveryTimeoutMs.coerceAtLeast(10_000L)) { peerId, _ ->
+            Log.d(TAG, "getDiscoveredPeers: found $peerId after ${System.currentTimeMillis() - started} ms")
+        }
+        Log.d(TAG, "getDiscoveredPeers: total found ${all.size} peers in ${System.currentTimeMillis() - started} ms")
         return all.toTypedArray()
     }
 
     private fun lookupAndDial(identifier: String): Boolean {
         val handle = nodeHandle
-        // Direct multiaddr: dial immediately.
+        // Direct multiaddr: dial immediately (through dial_peer when it names the peer, so an
+        // existing connection is reused).
         if (identifier.startsWith("/")) {
-            val ok = Libp2pNative.cabiNodeDial(handle, identifier) == Libp2pNative.STATUS_SUCCESS
+            // Circuit addresses name the relay first; those keep the plain dial
+            val pid = peerIdFromMultiaddr(identifier)?.takeIf { '/' !in it }
+            val ok = if (pid != null) {
+                dialPeer(handle, pid, listOf(identifier), "multiaddr")
+            } else {
+                Libp2pNative.cabiNodeDial(handle, identifier) == Libp2pNative.STATUS_SUCCESS
+            }
             if (ok) Log.i(TAG, "Dialed multiaddr: $identifier")
             return ok
         }
@@ -568,35 +689,55 @@ class Libp2pService : Service() {
             Log.w(TAG, "Could not resolve peer_id for identifier=$identifier")
             return false
         }
+        // Circuits via our bootstrap relays; both peers must use the same relay. With the racing
+        // dial they run alongside the direct addresses (started last), not after every direct
+        // address has failed.
+        val circuitAddrs = lastBootstrapPeers.filter { it.isNotBlank() }.mapNotNull { buildCircuitAddr(it, peerId) }
+        val raceCircuits = Libp2pNative.cabiNodeDialPeerIsNative()
+        val racedCircuits = if (raceCircuits) circuitAddrs else emptyList()
         // 1) Try directory card addresses first (e.g. from Python client that publishes listen addr).
-        val directoryAddrs = getDirectoryAddresses(identifier) + getDirectoryAddresses(peerId)
-        for (addr in directoryAddrs.distinct()) {
-            if (Libp2pNative.cabiNodeDial(handle, addr) == Libp2pNative.STATUS_SUCCESS) {
-                Log.i(TAG, "Dialed via directory: $addr")
-                return true
-            }
-        }
+        val directoryAddrs = (getDirectoryAddresses(identifier) + getDirectoryAddresses(peerId)).distinct()
+        if (dialPeer(handle, peerId, directoryAddrs + racedCircuits, "directory")) return true
+        // The card's addresses may be stale; refetch it next time
+        if (directoryAddrs.isNotEmpty()) invalidateDirectory(identifier, peerId)
         // 2) Resolve via find_peer + discovery events, then dial (longer timeout for DHT behind NAT/relay).
         val discoveredAddrs = resolvePeerAddresses(peerId, 12_000L)
-        for (addr in discoveredAddrs) {
-            if (Libp2pNative.cabiNodeDial(handle, addr) == Libp2pNative.STATUS_SUCCESS) {
-                Log.i(TAG, "Dialed via discovery: $addr")
-                return true
-            }
-        }
-        // 3) Fallback: dial target via bootstrap relay (p2p-circuit). Both peers must use the same relay.
-        for (bootstrap in lastBootstrapPeers) {
-            if (bootstrap.isBlank()) continue
-            val circuitAddr = buildCircuitAddr(bootstrap, peerId) ?: continue
-            if (Libp2pNative.cabiNodeDial(handle, circuitAddr) == Libp2pNative.STATUS_SUCCESS) {
-                Log.i(TAG, "Dialed via relay circuit: $circuitAddr")
-                return true
-            }
+        if (discoveredAddrs.isNotEmpty() && dialPeer(handle, peerId, discoveredAddrs + racedCircuits, "discovery")) {
+            return true
         }
+        // 3) Fallback: dial target via bootstrap relay (p2p-circuit).
+        if (!raceCircuits && dialPeer(handle, peerId, circuitAddrs, "relay circuit")) return true
         Log.w(TAG, "lookupAndDial: no dialable address for peer_id=$peerId (dir=${directoryAddrs.size}, discovered=${discoveredAddrs.size})")
+        // The cached card may have resolved to a stale peer_id, with stale prekeys
+        invalidateDirectory(identifier, peerId)
+        invalidatePrekeys(identifier, peerId)
         return false
     }
 
+    /**
+     * One connection to [peerId] over the best of [addrs]: reuses an existing connection and
+     * races the addresses when the library can, otherwise dials them in order.
+     */
+    private fun dialPeer(handle: Long, peerId: String, addrs: List<String>, source: String): Boolean {
+        if (addrs.isEmpty()) return false
+        val result = Libp2pNative.cabiNodeDialPeer(handle, peerId, addrs.toTypedArray(), DIAL_TIMEOUT_MS)
+        if (result == null || result.status != Libp2pNative.STATUS_SUCCESS) return false
+        if (result.transport == Libp2pNative.TRANSPORT_EXISTING) {
+            Log.i(TAG, "Dial via $source: already connected to $peerId")
+        } else if (result.connectMicros < 0) {
+            Log.i(TAG, "Dial via $source started to $peerId over ${addrs.size} addresses")
+        } else {
+            val transport = when (result.transport) {
+                Libp2pNative.TRANSPORT_TCP -> "tcp"
+                Libp2pNative.TRANSPORT_QUIC -> "quic"
+                Libp2pNative.TRANSPORT_RELAY -> "relay"
+                else -> "transport ${result.transport}"
+            }
+            Log.i(TAG, "Dialed via $source over $transport in ${result.connectMicros}us: ${result.address}")
+        }
+        return true
+    }
+
     /** Build libp2p circuit relay addr: relay_multiaddr/p2p-circuit/p2p/dest_peer_id */
     private fun buildCircuitAddr(relayMultiaddr: String, destPeerId: String): String? {
         val trimmed = relayMultiaddr.trim()
@@ -606,13 +747,10 @@ class Libp2pService : Service() {
 
     /** Get account_id from DHT directory card for peer_id (mirrors Python lookup_directory). */
     private fun getAccountIdFromDirectory(peerId: String): String? {
-        val handle = nodeHandle
-        val raw = Libp2pNative.cabiNodeDhtGetRecord(handle, directoryKeyForPeer(peerId))
-            ?: Libp2pNative.cabiNodeDhtGetRecord(handle, directoryKeyForAccount(peerId))
+        val raw = dhtGetFirst(directoryKeyForPeer(peerId), directoryKeyForAccount(peerId), accept = ::isDirectoryCard)
             ?: return null
         return try {
             val card = JSONObject(String(raw, StandardCharsets.UTF_8))
-            if (card.optString("schema") != "fidonext-directory-v1") return null
             card.optString("account_id").takeIf { it.isNotBlank() }
         } catch (_: Exception) {
             null
@@ -624,41 +762,28 @@ class Libp2pService : Service() {
      */
     private fun fetchRecipientPrekeyBundle(identifier: String): ByteArray? {
         fun tryFetch(id: String, label: String): ByteArray? {
-            val handle = nodeHandle
             Log.d(TAG, "fetchRecipientPrekeyBundle: trying DHT lookup for $label=$id")
-            val rawPeer = Libp2pNative.cabiNodeDhtGetRecord(handle, prekeyKeyForPeer(id))
-            val rawAccount = if (rawPeer == null) {
-                Libp2pNative.cabiNodeDhtGetRecord(handle, prekeyKeyForAccount(id))
-            } else null
-            val raw = rawPeer ?: rawAccount
+            // Records failing validation are skipped and never cached. Cache hits
+            // bypass the check, so only they are parsed below
+            val accepted = ArrayList<Pair<ByteArray, Pair<JSONObject, ByteArray>>>(2)
+            val raw = dhtGetFirst(prekeyKeyForPeer(id), prekeyKeyForAccount(id)) { candidate ->
+                val parsed = parsePrekeyRecord(candidate, "$label=$id") ?: return@dhtGetFirst false
+                accepted.add(candidate to parsed)
+                true
+            }
             if (raw == null) {
-                Log.d(TAG, "fetchRecipientPrekeyBundle: DHT returned null for $label=$id (checked peer and account keys)")
+                Log.d(TAG, "fetchRecipientPrekeyBundle: DHT returned no valid record for $label=$id (checked peer and account keys)")
                 return null
             }
-            return try {
-                val card = JSONObject(String(raw, StandardCharsets.UTF_8))
-                if (card.optString("schema") != "fidonext-prekey-bundle-v1") {
-                    Log.w(TAG, "fetchRecipientPrekeyBundle: invalid schema in DHT record for $label=$id")
-                    return null
-                }
-                val bundleB64 = card.optString("bundle_b64")
-                if (bundleB64.isNullOrBlank()) {
-                    Log.w(TAG, "fetchRecipientPrekeyBundle: empty bundle_b64 in DHT record for $label=$id")
-                    return null
-                }
-                val bundle = android.util.Base64.decode(bundleB64, android.util.Base64.DEFAULT)
-                val status = Libp2pNative.cabiE2eeValidatePrekeyBundle(bundle, 0L)
-                if (status == Libp2pNative.STATUS_SUCCESS) {
-                    Log.d(TAG, "fetchRecipientPrekeyBundle: Successfully fetched and validated bundle for $label=$id")
-                    bundle
-                } else {
-                    Log.w(TAG, "fetchRecipientPrekeyBundle: bundle validation failed for $label=$id status=$status")
-                    null
-                }
-            } catch (e: Exception) {
-                Log.w(TAG, "fetchRecipientPrekeyBundle: exception parsing DHT record for $label=$id", e)
-                null
+            val fetched = accepted.firstOrNull { it.first === raw }?.second
+            val (card, bundle) = fetched ?: parsePrekeyRecord(raw, "$label=$id") ?: run {
+                // A cached record that no longer validates (e.g. its bundle expired)
+                invalidatePrekeys(id)
+                return null
             }
+            rememberPacketFormats(card.optString("peer_id"), card)
+            Log.d(TAG, "fetchRecipientPrekeyBundle: Successfully fetched and validated bundle for $label=$id")
+            return bundle
         }
         tryFetch(identifier, "identifier")?.let { return it }
         if (identifier.startsWith("12D3") || identifier.startsWith("Qm")) {
@@ -702,11 +827,11 @@ class Libp2pService : Service() {
     private fun requestPrekeyBundle(peerId: String): Boolean {
         val handle = nodeHandle
         val myPeerId = localPeerId ?: return false
-        val profile = profilePath ?: return false
+        val context = e2eeContext.takeIf { it != 0L } ?: return false
 
         // Build our own prekey bundle to send
-        val myBundle = Libp2pNative.cabiE2eeBuildPrekeyBundle(
-            profilePath = profile,
+        val myBundle = Libp2pNative.cabiE2eeBuildPrekeyBundleCtx(
+            context = context,
             oneTimePrekeyCount = 32,
             ttlSeconds = 24 * 60 * 60L,
         ) ?: return false
@@ -718,6 +843,7 @@ class Libp2pService : Service() {
             put("to_peer_id", peerId)
             put("my_bundle_b64", android.util.Base64.encodeToString(myBundle, android.util.Base64.NO_WRAP))
             put("timestamp", System.currentTimeMillis() / 1000L)
+            put("packet_formats", org.json.JSONArray(ChatPacketCodec.SUPPORTED_FORMATS))
         }.toString().toByteArray(StandardCharsets.UTF_8)
 
         val status = Libp2pNative.cabiNodeEnqueueMessage(handle, requestPacket)
@@ -731,6 +857,8 @@ class Libp2pService : Service() {
      */
     private fun prefetchRecipientPrekey(peerId: String) {
         recipientPrekeyCache.remove(peerId)
+        // Opening a chat asks for a fresh bundle, not one cached from an earlier lookup
+        dht?.invalidate(prekeyKeyForPeer(peerId), prekeyKeyForAccount(peerId))
         serviceScope.launch(Dispatchers.IO) {
             // Try DHT first (works if both peers are on public DHT)
             val bundle = fetchRecipientPrekeyBundleWithRetry(peerId, maxAttempts = 2, delayBetweenAttemptsMs = 1500L)
@@ -772,11 +900,11 @@ class Libp2pService : Service() {
      * Handle prekey exchange messages (request/response) to bypass DHT for isolated networks.
      * Returns true if message was handled (prekey exchange), false if it should be processed normally.
      */
-    private fun tryHandlePrekeyExchange(payload: ByteArray): Boolean {
+    private fun tryHandlePrekeyExchange(payload: String): Boolean {
         val local = localPeerId ?: return false
-        val profile = profilePath ?: return false
+        val context = e2eeContext.takeIf { it != 0L } ?: return false
         try {
-            val packet = JSONObject(String(payload, StandardCharsets.UTF_8))
+            val packet = JSONObject(payload)
             if (packet.optString("schema") != "fidonext-prekey-exchange-v1") return false
 
             val type = packet.optString("type")
@@ -784,6 +912,7 @@ class Libp2pService : Service() {
             val toPeerId = packet.optString("to_peer_id")
 
             if (toPeerId != local) return true // Not for us, but still a prekey exchange message
+            rememberPacketFormats(fromPeerId, packet)
 
             when (type) {
                 "request" -> {
@@ -802,7 +931,7 @@ class Libp2pService : Service() {
                     }
 
                     // Send our bundle in response
-                    val myBundle = Libp2pNative.cabiE2eeBuildPrekeyBundle(profile, 32, 24 * 60 * 60L)
+                    val myBundle = Libp2pNative.cabiE2eeBuildPrekeyBundleCtx(context, 32, 24 * 60 * 60L)
                     if (myBundle != null) {
                         val responsePacket = JSONObject().apply {
                             put("schema", "fidonext-prekey-exchange-v1")
@@ -811,6 +940,7 @@ class Libp2pService : Service() {
                             put("to_peer_id", fromPeerId)
                             put("my_bundle_b64", android.util.Base64.encodeToString(myBundle, android.util.Base64.NO_WRAP))
                             put("timestamp", System.currentTimeMillis() / 1000L)
+                            put("packet_formats", org.json.JSONArray(ChatPacketCodec.SUPPORTED_FORMATS))
                         }.toString().toByteArray(StandardCharsets.UTF_8)
                         Libp2pNative.cabiNodeEnqueueMessage(nodeHandle, responsePacket)
                         Log.d(TAG, "Sent prekey bundle response to $fromPeerId")
@@ -840,38 +970,117 @@ class Libp2pService : Service() {
         return false
     }
 
-    private fun tryDecryptChatPacket(profile: String, payload: ByteArray): String? {
-        val local = localPeerId ?: return null
+    private fun rememberPacketFormats(peerId: String, document: JSONObject) {
+        if (peerId.isBlank()) return
+        val formats = document.optJSONArray("packet_formats") ?: return
+        val binary = (0 until formats.length()).any { formats.optString(it) == ChatPacketCodec.FORMAT_BINARY_V1 }
+        if (binary) binaryPacketPeers.add(peerId) else binaryPacketPeers.remove(peerId)
+    }
 
-        // First check if this is a prekey exchange message
-        if (tryHandlePrekeyExchange(payload)) {
-            return null // Handled as prekey exchange, don't process as chat
+    /**
+     * Dequeue the next inbound payload into the pooled direct buffer. The returned buffer
+     * spans exactly the payload and is only valid until the next dequeue; callers hold
+     * [inboundLock]. No ByteArray is allocated per message. Returns null when the queue is empty.
+     */
+    private fun dequeueInbound(handle: Long): ByteBuffer? {
+        synchronized(inboundLock) {
+            while (true) {
+                val buffer = inboundBuffer
+                val length = Libp2pNative.cabiNodeDequeueMessageDirect(handle, buffer)
+                if (length == -1) return null
+                if (length < -1) {
+                    // Message stays queued; retry with a buffer that fits it
+                    inboundBuffer = ByteBuffer.allocateDirect(maxOf(buffer.capacity() * 2, -length))
+                    continue
+                }
+                buffer.clear()
+                buffer.limit(length)
+                return buffer
+            }
         }
+    }
 
-        return try {
-            val packet = JSONObject(String(payload, StandardCharsets.UTF_8))
-            if (packet.optString("schema") != "fidonext-chat-v1") return null
-            if (packet.optString("payload_type") != "libsignal") return null
-            val toPeerId = packet.optString("to_peer_id")
-            if (toPeerId != local) return null
-            val fromPeerId = packet.optString("from_peer_id")
-            val encryptedB64 = packet.optString("payload_b64")
-            val encrypted = android.util.Base64.decode(encryptedB64, android.util.Base64.DEFAULT)
-            val decrypted = Libp2pNative.cabiE2eeDecryptMessageAuto(profile, encrypted) ?: return null
-            val kindName = when (decrypted.kind) {
-                Libp2pNative.E2EE_MESSAGE_KIND_PREKEY -> "prekey"
-                Libp2pNative.E2EE_MESSAGE_KIND_SESSION -> "session"
-                else -> "unknown"
-            }
-            JSONObject().apply {
-                put("from_peer_id", fromPeerId)
-                put("to_peer_id", toPeerId)
-                put("kind", kindName)
-                put("text", String(decrypted.plaintext, StandardCharsets.UTF_8))
-            }.toString()
-        } catch (_: Exception) {
-            null
+    private class InboundChatPacket(
+        val fromPeerId: String,
+        val toPeerId: String,
+        val encrypted: ByteArray,
+    )
+
+    /**
+     * Returns the next decrypted chat message. Drains up to [DECRYPT_BATCH_MAX] queued
+     * payloads and decrypts them in one native call on the E2EE context.
+     */
+    private fun nextDecryptedMessage(handle: Long, context: Long): String? {
+        synchronized(inboundLock) {
+            decryptedBacklog.removeFirstOrNull()?.let { return it }
+
+            val packets = ArrayList<InboundChatPacket>()
+            val localBytes = localPeerId?.toByteArray(StandardCharsets.US_ASCII) ?: return null
+            while (packets.size < DECRYPT_BATCH_MAX) {
+                val buffer = dequeueInbound(handle) ?: break
+                if (ChatPacketCodec.isBinary(buffer)) {
+                    // Validated in place; packets for other peers are dropped before any copy
+                    val view = ChatPacketCodec.parseBinary(buffer) ?: continue
+                    if (!view.isAddressedTo(localBytes)) continue
+                    packets.add(InboundChatPacket(view.fromPeerId(), view.toPeerId(), view.copyPayload()))
+                    continue
+                }
+                val payload = StandardCharsets.UTF_8.decode(buffer).toString()
+                // Prekey exchanges are handled here and never reach the chat
+                if (tryHandlePrekeyExchange(payload)) continue
+                parseChatPacket(payload)?.let { packets.add(it) }
+            }
+            if (packets.isEmpty()) return null
+
+            val batch = Libp2pNative.cabiE2eeDecryptMessagesAutoCtx(
+                context,
+                Array(packets.size) { packets[it].encrypted }
+            )
+            if (batch == null) {
+                // The batch call itself failed (e.g. out of memory); the packets are already
+                // off the queue, so each still gets its own decrypt instead of being dropped
+                Log.w(TAG, "Batch decrypt failed; decrypting ${packets.size} packets one by one")
+                packets.forEach { packet ->
+                    val decrypted = Libp2pNative.cabiE2eeDecryptMessageAutoCtx(context, packet.encrypted)
+                    if (decrypted != null) {
+                        decryptedBacklog.addLast(formatChatMessage(packet, decrypted.kind, decrypted.plaintext))
+                    } else {
+                        Log.w(TAG, "Decrypt failed from ${packet.fromPeerId}")
+                    }
+                }
+                return decryptedBacklog.removeFirstOrNull()
+            }
+            packets.forEachIndexed { i, packet ->
+                val plaintext = batch.plaintexts[i]
+                if (batch.statuses[i] == 0 && plaintext != null) {
+                    decryptedBacklog.addLast(formatChatMessage(packet, batch.kinds[i], plaintext))
+                } else {
+                    Log.w(TAG, "Decrypt failed from ${packet.fromPeerId}: status ${batch.statuses[i]}")
+                }
+            }
+            return decryptedBacklog.removeFirstOrNull()
+        }
+    }
+
+    private fun parseChatPacket(payload: String): InboundChatPacket? {
+        val local = localPeerId ?: return null
+        val packet = ChatPacketCodec.parseJson(payload) ?: return null
+        if (packet.toPeerId != local) return null
+        return InboundChatPacket(packet.fromPeerId, packet.toPeerId, packet.payload)
+    }
+
+    private fun formatChatMessage(packet: InboundChatPacket, kind: Int, plaintext: ByteArray): String {
+        val kindName = when (kind) {
+            Libp2pNative.E2EE_MESSAGE_KIND_PREKEY -> "prekey"
+            Libp2pNative.E2EE_MESSAGE_KIND_SESSION -> "session"
+            else -> "unknown"
         }
+        return JSONObject().apply {
+            put("from_peer_id", packet.fromPeerId)
+            put("to_peer_id", packet.toPeerId)
+            put("kind", kindName)
+            put("text", String(plaintext, StandardCharsets.UTF_8))
+        }.toString()
     }
 
     private fun startHealthMonitoring() {
@@ -883,6 +1092,79 @@ class Libp2pService : Service() {
         }
     }
 
+    /** Dumps the node's counters and latency histograms, plus DHT cache counters, to logcat, one record per line. */
+    private fun startMetricsDump() {
+        serviceScope.launch {
+            while (isActive) {
+                delay(METRICS_DUMP_INTERVAL_MS)
+                val handle = nodeHandle
+                if (handle == 0L || !isRunning.get()) continue
+                val snapshot = listOfNotNull(Libp2pNative.cabiNodeMetricsSnapshot(handle), dhtCache.metricsText())
+                    .joinToString("\n")
+                // Separate lines: logcat truncates long entries
+                snapshot.lineSequence()
+                    .filter { it.isNotBlank() }
+                    .forEach { Log.d("$TAG.metrics", it) }
+            }
+        }
+    }
+
+    private val peerStorePath: String
+        get() = java.io.File(filesDir, "fidonext.peerstore.bin").absolutePath
+
+    private fun loadPeerStore(handle: Long) {
+        if (!Libp2pNative.cabiNodePeerStoreIsNative()) return
+        when (val status = Libp2pNative.cabiNodeLoadPeerStore(handle, peerStorePath)) {
+            Libp2pNative.STATUS_SUCCESS -> Log.i(TAG, "Warm start from saved peer store")
+            Libp2pNative.STATUS_NOT_FOUND -> Log.i(TAG, "No saved peer store yet; cold start")
+            else -> Log.w(TAG, "Failed to load peer store: $status")
+        }
+    }
+
+    private fun savePeerStore(handle: Long) {
+        if (!Libp2pNative.cabiNodePeerStoreIsNative()) return
+        val status = synchronized(peerStoreLock) { Libp2pNative.cabiNodeSavePeerStore(handle, peerStorePath) }
+        if (status != Libp2pNative.STATUS_SUCCESS) Log.w(TAG, "Failed to save peer store: $status")
+    }
+
+    /** Last save, then free; a periodic save cannot start in between or run against the freed handle. */
+    private fun saveAndFreeNode() {
+        synchronized(peerStoreLock) {
+            val handle = nodeHandle
+            if (handle == 0L) return
+            savePeerStore(handle)
+            Libp2pNative.cabiNodeFree(handle)
+            nodeHandle = 0
+        }
+    }
+
+    /** Snapshot the routing table periodically, so a killed process still warm-starts. */
+    private fun startPeerStoreSave() {
+        serviceScope.launch(Dispatchers.IO) {
+            while (isActive) {
+                delay(PEER_STORE_SAVE_INTERVAL_MS)
+                // Read the handle under the lock so it cannot be freed mid-save
+                synchronized(peerStoreLock) {
+                    val handle = nodeHandle
+                    if (handle != 0L && isRunning.get()) savePeerStore(handle)
+                }
+            }
+        }
+    }
+
+    /** Persist the E2EE context periodically, so a killed process keeps its ratchet state. */
+    private fun startE2eeFlush() {
+        serviceScope.launch(Dispatchers.IO) {
+            while (isActive) {
+                delay(E2EE_FLUSH_INTERVAL_MS)
+                val context = e2eeContext
+                if (context == 0L || !Libp2pNative.cabiE2eeContextIsNative(context)) continue
+                val status = Libp2pNative.cabiE2eeContextFlush(context)
+                if (status != Libp2pNative.STATUS_SUCCESS) Log.w(TAG, "Failed to flush E2EE context: $status")
+            }
+        }
+    }
+
     /** Re-announce directory+prekey to DHT periodically (mirrors Python fidonext_chat_client _announce_loop). */
     private fun startPeriodicReannounce() {
         serviceScope.launch {
@@ -910,11 +1192,17 @@ class Libp2pService : Service() {
             // Check if node is still responsive
             val status = Libp2pNative.cabiAutonatStatus(nodeHandle)
             Log.d(TAG, "Health check passed. AutoNAT status: $status")
+            Libp2pNative.cabiJniAllocStats()?.let { stats ->
+                Log.d(
+                    TAG,
+                    "JNI buffers: acquires=${stats[Libp2pNative.JNI_STATS_SCRATCH_ACQUIRES]} " +
+                        "allocations=${stats[Libp2pNative.JNI_STATS_NATIVE_ALLOCATIONS]} " +
+                        "reserved=${stats[Libp2pNative.JNI_STATS_NATIVE_BYTES_RESERVED]}B"
+                )
+            }
 
             // Update notification with status
-            val notification = createNotification()
-            val notificationManager = getSystemService(NotificationManager::class.java)
-            notificationManager?.notify(NOTIFICATION_ID, notification)
+            updateNotification()
 
         } catch (e: Exception) {
             Log.e(TAG, "Health check failed", e)
@@ -922,12 +1210,48 @@ class Libp2pService : Service() {
         }
     }
 
+    private fun updateNotification() {
+        val notification = createNotification()
+        val notificationManager = getSystemService(NotificationManager::class.java)
+        notificationManager?.notify(NOTIFICATION_ID, notification)
+    }
+
+    /** Runs on the node-events thread; the notification follows AutoNAT without waiting for a health check */
+    private fun onNodeEvent(event: Libp2pNative.NodeEvent) {
+        val latencyUs = (System.nanoTime() - event.timestampNs) / 1_000
+        when (event.kind) {
+            Libp2pNative.NODE_EVENT_AUTONAT_CHANGED -> {
+                Log.i(TAG, "AutoNAT status changed to ${event.value} (+${latencyUs}us)")
+                updateNotification()
+            }
+            Libp2pNative.NODE_EVENT_LISTEN_ADDR_ADDED ->
+                Log.d(TAG, "Listening on ${event.text} (+${latencyUs}us)")
+            Libp2pNative.NODE_EVENT_LISTEN_ADDR_REMOVED ->
+                Log.d(TAG, "Stopped listening on ${event.text} (+${latencyUs}us)")
+            Libp2pNative.NODE_EVENT_CONNECTION_OPENED ->
+                Log.d(TAG, "Connected to ${event.peerId} via ${event.text}, ${event.value} open (+${latencyUs}us)")
+            Libp2pNative.NODE_EVENT_CONNECTION_CLOSED ->
+                Log.d(TAG, "Disconnected from ${event.peerId}, ${event.value} open (+${latencyUs}us)")
+            Libp2pNative.NODE_EVENT_RESERVATION_ACCEPTED ->
+                Log.i(TAG, "Relay reservation accepted by ${event.peerId}: ${event.text} (+${latencyUs}us)")
+            Libp2pNative.NODE_EVENT_RESERVATION_EXPIRED ->
+                Log.w(TAG, "Relay reservation on ${event.peerId} expired (+${latencyUs}us)")
+            else -> Log.d(TAG, "Node event kind=${event.kind}")
+        }
+    }
+
     private fun restartNode() {
         Log.w(TAG, "Attempting to restart node...")
 
+        dht?.close()
+        dht = null
+        discovery?.close()
+        discovery = null
+        nodeEvents?.close()
+        nodeEvents = null
         if (nodeHandle != 0L) {
             try {
-                Libp2pNative.cabiNodeFree(nodeHandle)
+                saveAndFreeNode()
             } catch (e: Exception) {
                 Log.e(TAG, "Error freeing node during restart", e)
             }
@@ -0,0 +1,52 @@
+package com.fidonext.messenger.service
+
+import android.util.Log
+import com.fidonext.messenger.rust.Libp2pNative
+import java.util.concurrent.atomic.AtomicBoolean
+
+/**
+ * Node state changes (AutoNAT, listen addresses, connections, relay reservations) for one node
+ * handle, delivered to [onEvent] on a single pump thread as the node reports them. Without the
+ * events ABI no thread is started and [isNative] is false; callers keep polling as before.
+ *
+ * Close before the node handle is freed.
+ */
+class NodeEventStream(
+    private val handle: Long,
+    private val onEvent: (Libp2pNative.NodeEvent) -> Unit,
+) : AutoCloseable {
+
+    companion object {
+        private const val TAG = "NodeEventStream"
+        /** How long the pump blocks in native per wait; bounds close() latency */
+        private const val PUMP_WAIT_MS = 200L
+    }
+
+    val isNative: Boolean = Libp2pNative.cabiNodeEventsIsNative()
+
+    private val running = AtomicBoolean(isNative)
+    private val pump: Thread? = if (isNative) {
+        Thread({ pumpLoop() }, "node-events").apply {
+            isDaemon = true
+            start()
+        }
+    } else {
+        null
+    }
+
+    override fun close() {
+        if (!running.getAndSet(false)) return
+        pump?.join()
+    }
+
+    private fun pumpLoop() {
+        while (running.get()) {
+            val event = Libp2pNative.cabiNodeDequeueNodeEvent(handle, PUMP_WAIT_MS) ?: continue
+            try {
+                onEvent(event)
+            } catch (e: Exception) {
+                Log.e(TAG, "Node event handler failed for kind=${event.kind}", e)
+            }
+        }
+    }
+}
@@ -0,0 +1,451 @@
+﻿#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Crossplatform
+#ifdef _WIN32
+#include <windows.h>
+#undef max
+#undef min
+using LibHandle = HMODULE;
+#define LOAD_LIB(path) LoadLibraryA(path)
+#define GET_PROC(lib, name) GetProcAddress(lib, name)
+#define CLOSE_LIB(lib) FreeLibrary(lib)
+constexpr auto LIB_NAME = "cabi_rust_libp2p.dll";
+#else
+#include <dlfcn.h>
+using LibHandle = void*;
+#define LOAD_LIB(path) dlopen(path, RTLD_LAZY)
+#define GET_PROC(lib, name) dlsym(lib, name)
+#define CLOSE_LIB(lib) dlclose(lib)
+constexpr auto LIB_NAME = "./libcabi_rust_libp2p.so";
+#endif
+
+// Statuses, constants and structs of the C-ABI; functions are resolved at runtime
+#include "cabi-rust-libp2p.h"
+
+using std::cout;
+using std::cerr;
+using std::string;
+
+// Compares draining an inbound E2EE backlog through one
+// cabi_e2ee_decrypt_messages_auto call against one
+// cabi_e2ee_decrypt_message_auto call per payload, and, when the library has
+// them, per-payload calls on a context that keeps the profile in memory.
+
+using BuildPrekeyBundleFunc = int (*)(
+  const char* profilePath,
+  size_t oneTimePrekeyCount,
+  uint64_t ttlSeconds,
+  uint8_t* outBuffer,
+  size_t outBufferLen,
+  size_t* writtenLen);
+using BuildMessageAutoFunc = int (*)(
+  const char* profilePath,
+  const uint8_t* recipientPrekeyBundlePtr,
+  size_t recipientPrekeyBundleLen,
+  const uint8_t* plaintextPtr,
+  size_t plaintextLen,
+  const uint8_t* aadPtr,
+  size_t aadLen,
+  uint8_t* outBuffer,
+  size_t outBufferLen,
+  size_t* writtenLen);
+using DecryptMessageAutoFunc = int (*)(
+  const char* profilePath,
+  const uint8_t* payloadPtr,
+  size_t payloadLen,
+  uint8_t* outPlaintextBuffer,
+  size_t outPlaintextBufferLen,
+  size_t* writtenLen,
+  int* messageKind);
+// Optional, exported by newer library builds only
+using DecryptMessagesAutoFunc = int (*)(
+  const char* profilePath,
+  const CabiBuffer* payloads,
+  size_t count,
+  uint8_t* outArena,
+  size_t arenaLen,
+  size_t* outOffsets,
+  size_t* outLengths,
+  int* outKinds,
+  int* outStatuses,
+  size_t* outProcessed);
+
+using ContextOpenFunc = int (*)(const char* profilePath, CabiE2eeContext** outCtx);
+using ContextCloseFunc = void (*)(CabiE2eeContext* ctx);
+using DecryptMessageAutoCtxFunc = int (*)(
+  CabiE2eeContext* ctx,
+  const uint8_t* payloadPtr,
+  size_t payloadLen,
+  uint8_t* outPlaintextBuffer,
+  size_t outPlaintextBufferLen,
+  size_t* writtenLen,
+  int* messageKind);
+
+struct E2eeAbi
+{
+  BuildPrekeyBundleFunc  BuildPrekeyBundle{};
+  BuildMessageAutoFunc   BuildMessageAuto{};
+  DecryptMessageAutoFunc DecryptMessageAuto{};
+
+  // Optional: null when the library does not export them
+  DecryptMessagesAutoFunc   DecryptMessagesAuto{};
+  ContextOpenFunc           ContextOpen{};
+  ContextCloseFunc          ContextClose{};
+  DecryptMessageAutoCtxFunc DecryptMessageAutoCtx{};
+};
+
+bool loadAbi(LibHandle lib, E2eeAbi& abi)
+{
+  abi.BuildPrekeyBundle = reinterpret_cast<BuildPrekeyBundleFunc>(GET_PROC(lib, "cabi_e2ee_build_prekey_bundle"));
+  abi.BuildMessageAuto = reinterpret_cast<BuildMessageAutoFunc>(GET_PROC(lib, "cabi_e2ee_build_message_auto"));
+  abi.DecryptMessageAuto = reinterpret_cast<DecryptMessageAutoFunc>(GET_PROC(lib, "cabi_e2ee_decrypt_message_auto"));
+
+  // Optional ones. Older builds lack them and callers fall back
+  abi.DecryptMessagesAuto = reinterpret_cast<DecryptMessagesAutoFunc>(GET_PROC(lib, "cabi_e2ee_decrypt_messages_auto"));
+  abi.ContextOpen = reinterpret_cast<ContextOpenFunc>(GET_PROC(lib, "cabi_e2ee_context_open"));
+  abi.ContextClose = reinterpret_cast<ContextCloseFunc>(GET_PROC(lib, "cabi_e2ee_context_close"));
+  abi.DecryptMessageAutoCtx = reinterpret_cast<DecryptMessageAutoCtxFunc>(GET_PROC(lib, "cabi_e2ee_decrypt_message_auto_ctx"));
+
+  return abi.BuildPrekeyBundle && abi.BuildMessageAuto && abi.DecryptMessageAuto;
+}
+
+using Bytes = std::vector<uint8_t>;
+
+struct DecryptResult
+{
+  int status = CABI_STATUS_INTERNAL_ERROR;
+  int kind = 0;
+  Bytes plaintext;
+};
+
+// Decrypts payloads in order. One library call when the batch ABI is exported
+// (resuming if it stops early on a full arena), otherwise one call per payload.
+std::vector<DecryptResult> decryptBatch(const E2eeAbi& abi, const string& profile, const std::vector<Bytes>& payloads)
+{
+  const size_t count = payloads.size();
+  std::vector<DecryptResult> results(count);
+  size_t inputLen = 0;
+  for (const auto& payload : payloads)
+  {
+    inputLen += payload.size();
+  }
+  // Plaintexts are never larger than their ciphertexts
+  Bytes arena(std::max<size_t>(inputLen, 1));
+
+  if (!abi.DecryptMessagesAuto)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      size_t written = 0;
+      results[i].status = abi.DecryptMessageAuto(
+        profile.c_str(), payloads[i].data(), payloads[i].size(),
+        arena.data(), arena.size(), &written, &results[i].kind);
+      if (results[i].status == CABI_STATUS_SUCCESS)
+      {
+        results[i].plaintext.assign(arena.begin(), arena.begin() + written);
+      }
+    }
+    return results;
+  }
+
+  std::vector<CabiBuffer> buffers(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    buffers[i] = CabiBuffer{ payloads[i].data(), payloads[i].size() };
+  }
+  std::vector<size_t> offsets(count), lengths(count);
+  std::vector<int> kinds(count), statuses(count, CABI_STATUS_INTERNAL_ERROR);
+
+  size_t done = 0;
+  while (done < count)
+  {
+    size_t processed = 0;
+    const int status = abi.DecryptMessagesAuto(
+      profile.c_str(), buffers.data() + done, count - done,
+      arena.data(), arena.size(),
+      offsets.data() + done, lengths.data() + done,
+      kinds.data() + done, statuses.data() + done,
+      &processed);
+    processed = std::min(processed, count - done);
+
+    for (size_t i = done; i < done + processed; ++i)
+    {
+      results[i].status = statuses[i];
+      results[i].kind = kinds[i];
+      if (statuses[i] == CABI_STATUS_SUCCESS)
+      {
+        results[i].plaintext.assign(arena.begin() + offsets[i], arena.begin() + offsets[i] + lengths[i]);
+      }
+    }
+    done += processed;
+
+    if (status == CABI_STATUS_BUFFER_TOO_SMALL)
+    {
+      if (processed == 0)
+      {
+        arena.resize(arena.size() * 2);
+      }
+      continue;
+    }
+    if (status != CABI_STATUS_SUCCESS)
+    {
+      break;
+    }
+  }
+  return results;
+}
+
+struct Arguments
+{
+  string receiverProfile = "e2ee-bench-receiver.json";
+  string senderProfile = "e2ee-bench-sender.json";
+  size_t messages = 200;
+  size_t payloadSize = 256;
+};
+
+Arguments parseArgs(int argc, char** argv)
+{
+  Arguments args;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const string arg = argv[i];
+
+    if (arg == "--receiver-profile" && i + 1 < argc)
+    {
+      args.receiverProfile = argv[++i];
+    }
+    else if (arg == "--sender-profile" && i + 1 < argc)
+    {
+      args.senderProfile = argv[++i];
+    }
+    else if (arg == "--messages" && i + 1 < argc)
+    {
+      args.messages = std::strtoul(argv[++i], nullptr, 10);
+      if (args.messages == 0)
+      {
+        throw std::invalid_argument("--messages must be a positive number");
+      }
+    }
+    else if (arg == "--size" && i + 1 < argc)
+    {
+      args.payloadSize = std::strtoul(argv[++i], nullptr, 10);
+      if (args.payloadSize == 0)
+      {
+        throw std::invalid_argument("--size must be a positive number");
+      }
+    }
+    else if (arg == "--help" || arg == "-h")
+    {
+      cout << "Usage: e2ee_bench [options]\n"
+           << "  --receiver-profile <path>  Profile that decrypts (default e2ee-bench-receiver.json)\n"
+           << "  --sender-profile <path>    Profile that encrypts (default e2ee-bench-sender.json)\n"
+           << "  --messages <n>             Messages per run (default 200)\n"
+           << "  --size <bytes>             Plaintext size (default 256)\n";
+      std::exit(0);
+    }
+    else
+    {
+      throw std::invalid_argument("Unknown argument: " + arg);
+    }
+  }
+
+  return args;
+}
+
+Bytes buildPrekeyBundle(const E2eeAbi& abi, const string& profile)
+{
+  Bytes buffer(64 * 1024);
+  size_t written = 0;
+  const int status = abi.BuildPrekeyBundle(profile.c_str(), 16, 3600, buffer.data(), buffer.size(), &written);
+  if (status != CABI_STATUS_SUCCESS)
+  {
+    throw std::runtime_error("build_prekey_bundle failed: " + std::to_string(status));
+  }
+  buffer.resize(written);
+  return buffer;
+}
+
+// Encrypts `count` messages from sender to the bundle's owner, in send order
+std::vector<Bytes> buildMessages(const E2eeAbi& abi, const string& sender, const Bytes& bundle,
+                                 size_t count, size_t payloadSize)
+{
+  std::vector<Bytes> messages;
+  messages.reserve(count);
+  Bytes out(2 * payloadSize + bundle.size() + 4096);
+  for (size_t i = 0; i < count; ++i)
+  {
+    Bytes plaintext(payloadSize, static_cast<uint8_t>('a' + i % 26));
+    size_t written = 0;
+    const int status = abi.BuildMessageAuto(
+      sender.c_str(), bundle.data(), bundle.size(),
+      plaintext.data(), plaintext.size(), nullptr, 0,
+      out.data(), out.size(), &written);
+    if (status != CABI_STATUS_SUCCESS)
+    {
+      throw std::runtime_error("build_message_auto failed: " + std::to_string(status));
+    }
+    messages.emplace_back(out.begin(), out.begin() + written);
+  }
+  return messages;
+}
+
+struct RunResult
+{
+  double elapsedMs = 0;
+  size_t ok = 0;
+};
+
+template <typename Fn>
+RunResult timeRun(Fn&& fn)
+{
+  const auto start = std::chrono::steady_clock::now();
+  const auto ok = fn();
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return RunResult{ std::chrono::duration<double, std::milli>(elapsed).count(), ok };
+}
+
+void printRun(const char* name, const RunResult& run, size_t messages)
+{
+  cout << name << ": " << run.ok << "/" << messages << " ok, "
+       << run.elapsedMs << " ms, "
+       << (run.elapsedMs * 1000.0 / static_cast<double>(messages)) << " us/msg\n";
+}
+
+int main(int argc, char** argv)
+{
+  // Step 1. Load lib
+  LibHandle lib = LOAD_LIB(LIB_NAME);
+  if (!lib)
+  {
+    cerr << "Error loading lib: " << LIB_NAME << "\n";
+    return 1;
+  }
+
+  // Step 2. Load functions from lib
+  E2eeAbi abi{};
+  if (!loadAbi(lib, abi))
+  {
+    cerr << "Missing required functions in library\n";
+    CLOSE_LIB(lib);
+    return 1;
+  }
+
+  // Step 3. Parse args
+  Arguments args;
+  try
+  {
+    args = parseArgs(argc, argv);
+  }
+  catch (const std::exception& ex)
+  {
+    cerr << "Argument error: " << ex.what() << "\n";
+    CLOSE_LIB(lib);
+    return 1;
+  }
+
+  try
+  {
+    // Step 4. Encrypt disjoint backlogs; decrypting the same payload twice
+    // would be rejected as a replay
+    const bool hasContext = abi.ContextOpen && abi.ContextClose && abi.DecryptMessageAutoCtx;
+    const auto bundle = buildPrekeyBundle(abi, args.receiverProfile);
+    const auto singles = buildMessages(abi, args.senderProfile, bundle, args.messages, args.payloadSize);
+    const auto batched = buildMessages(abi, args.senderProfile, bundle, args.messages, args.payloadSize);
+    const auto contextual = hasContext
+      ? buildMessages(abi, args.senderProfile, bundle, args.messages, args.payloadSize)
+      : std::vector<Bytes>{};
+
+    // Step 5. Drain one backlog call-by-call, then the other in one batch
+    const auto singleRun = timeRun([&]
+    {
+      size_t ok = 0;
+      Bytes out(args.payloadSize + 4096);
+      for (const auto& payload : singles)
+      {
+        size_t written = 0;
+        int kind = 0;
+        if (abi.DecryptMessageAuto(args.receiverProfile.c_str(), payload.data(), payload.size(),
+                                   out.data(), out.size(), &written, &kind) == CABI_STATUS_SUCCESS)
+        {
+          ++ok;
+        }
+      }
+      return ok;
+    });
+    const auto batchRun = timeRun([&]
+    {
+      size_t ok = 0;
+      for (const auto& result : decryptBatch(abi, args.receiverProfile, batched))
+      {
+        if (result.status == CABI_STATUS_SUCCESS && result.plaintext.size() == args.payloadSize)
+        {
+          ++ok;
+        }
+      }
+      return ok;
+    });
+
+    // Step 6. Same per-call loop on an open context, if the library has one
+    RunResult contextRun{};
+    if (hasContext)
+    {
+      CabiE2eeContext* ctx = nullptr;
+      if (abi.ContextOpen(args.receiverProfile.c_str(), &ctx) != CABI_STATUS_SUCCESS || !ctx)
+      {
+        throw std::runtime_error("cabi_e2ee_context_open failed");
+      }
+      contextRun = timeRun([&]
+      {
+        size_t ok = 0;
+        Bytes out(args.payloadSize + 4096);
+        for (const auto& payload : contextual)
+        {
+          size_t written = 0;
+          int kind = 0;
+          if (abi.DecryptMessageAutoCtx(ctx, payload.data(), payload.size(),
+                                        out.data(), out.size(), &written, &kind) == CABI_STATUS_SUCCESS)
+          {
+            ++ok;
+          }
+        }
+        return ok;
+      });
+      abi.ContextClose(ctx);
+    }
+
+    cout << "Batch ABI: " << (abi.DecryptMessagesAuto ? "exported" : "missing, per-call fallback") << "\n";
+    printRun("single ", singleRun, args.messages);
+    printRun("batch  ", batchRun, args.messages);
+    if (hasContext)
+    {
+      printRun("context", contextRun, args.messages);
+    }
+    else
+    {
+      cout << "context: not exported by this library\n";
+    }
+    if (batchRun.elapsedMs > 0)
+    {
+      cout << "batch speedup over single: " << (singleRun.elapsedMs / batchRun.elapsedMs) << "x\n";
+    }
+  }
+  catch (const std::exception& ex)
+  {
+    cerr << "Benchmark failed: " << ex.what() << "\n";
+    CLOSE_LIB(lib);
+    return 1;
+  }
+
+  CLOSE_LIB(lib);
+  return 0;
+}
@@ -0,0 +1,618 @@
+﻿#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Crossplatform
+#ifdef _WIN32
+#include <windows.h>
+#undef max
+#undef min
+using LibHandle = HMODULE;
+#define LOAD_LIB(path) LoadLibraryA(path)
+#define GET_PROC(lib, name) GetProcAddress(lib, name)
+#define CLOSE_LIB(lib) FreeLibrary(lib)
+constexpr auto LIB_NAME = "cabi_rust_libp2p.dll";
+#else
+#include <dlfcn.h>
+using LibHandle = void*;
+#define LOAD_LIB(path) dlopen(path, RTLD_LAZY)
+#define GET_PROC(lib, name) dlsym(lib, name)
+#define CLOSE_LIB(lib) dlclose(lib)
+constexpr auto LIB_NAME = "./libcabi_rust_libp2p.so";
+#endif
+
+// Statuses, constants and structs of the C-ABI; functions are resolved at runtime
+#include "cabi-rust-libp2p.h"
+
+using std::cout;
+using std::cerr;
+using std::string;
+
+// Starts N nodes in this process on loopback, dials them into a full mesh and
+// has every sender publish timestamped payloads at a fixed rate. Each node
+// drains its inbound queue on its own thread and records end-to-end latency,
+// so the run reports sent/delivered msgs/s, delivered bytes/s and
+// p50/p99/p999 latency without any external relay.
+
+using NewNodeFunc = void* (*)(
+  bool useQuic,
+  bool enableRelayHop,
+  const char* const* bootstrapPeers,
+  size_t bootstrapPeersLen,
+  const uint8_t* identitySeedPtr,
+  size_t identitySeedLen);
+using ListenNodeFunc = int (*)(void* handle, const char* multiaddr);
+using DialNodeFunc = int (*)(void* handle, const char* multiaddr);
+using EnqueueMessageFunc = int (*)(void* handle, const uint8_t* data_ptr, size_t data_len);
+using DequeueMessageFunc = int (*)(void* handle, uint8_t* out_buffer, size_t buffer_len, size_t* written_len);
+using LocalPeerIdFunc = int (*)(void* handle, char* out_buffer, size_t buffer_len, size_t* written_len);
+using FreeNodeFunc = void (*)(void* handle);
+// Optional, exported by newer library builds only
+using DequeueMessageTimeoutFunc = int (*)(void* handle, uint8_t* out_buffer, size_t buffer_len, size_t* written_len, uint64_t timeout_ms);
+using NewNodeWithConfigFunc = void* (*)(const struct CabiNodeConfig* config);
+using NewRuntimeFunc = CabiRuntime* (*)(const struct CabiRuntimeConfig* config);
+using FreeRuntimeFunc = void (*)(CabiRuntime* runtime);
+
+struct LoadgenAbi
+{
+  NewNodeFunc        NewNode{};
+  ListenNodeFunc     ListenNode{};
+  DialNodeFunc       DialNode{};
+  EnqueueMessageFunc EnqueueMessage{};
+  DequeueMessageFunc DequeueMessage{};
+  LocalPeerIdFunc    LocalPeerId{};
+  FreeNodeFunc       FreeNode{};
+
+  // Optional: null when the library does not export them
+  DequeueMessageTimeoutFunc DequeueMessageTimeout{};
+  NewNodeWithConfigFunc     NewNodeWithConfig{};
+  NewRuntimeFunc            NewRuntime{};
+  FreeRuntimeFunc           FreeRuntime{};
+};
+
+bool loadAbi(LibHandle lib, LoadgenAbi& abi)
+{
+  abi.NewNode = reinterpret_cast<NewNodeFunc>(GET_PROC(lib, "cabi_node_new"));
+  abi.ListenNode = reinterpret_cast<ListenNodeFunc>(GET_PROC(lib, "cabi_node_listen"));
+  abi.DialNode = reinterpret_cast<DialNodeFunc>(GET_PROC(lib, "cabi_node_dial"));
+  abi.EnqueueMessage = reinterpret_cast<EnqueueMessageFunc>(GET_PROC(lib, "cabi_node_enqueue_message"));
+  abi.DequeueMessage = reinterpret_cast<DequeueMessageFunc>(GET_PROC(lib, "cabi_node_dequeue_message"));
+  abi.LocalPeerId = reinterpret_cast<LocalPeerIdFunc>(GET_PROC(lib, "cabi_node_local_peer_id"));
+  abi.FreeNode = reinterpret_cast<FreeNodeFunc>(GET_PROC(lib, "cabi_node_free"));
+
+  // Optional ones. Older builds lack them and callers fall back
+  abi.DequeueMessageTimeout = reinterpret_cast<DequeueMessageTimeoutFunc>(GET_PROC(lib, "cabi_node_dequeue_message_timeout"));
+  abi.NewNodeWithConfig = reinterpret_cast<NewNodeWithConfigFunc>(GET_PROC(lib, "cabi_node_new_with_config"));
+  abi.NewRuntime = reinterpret_cast<NewRuntimeFunc>(GET_PROC(lib, "cabi_runtime_new"));
+  abi.FreeRuntime = reinterpret_cast<FreeRuntimeFunc>(GET_PROC(lib, "cabi_runtime_free"));
+
+  return abi.NewNode && abi.ListenNode && abi.DialNode && abi.EnqueueMessage &&
+         abi.DequeueMessage && abi.LocalPeerId && abi.FreeNode;
+}
+
+enum class Transport
+{
+  Tcp,
+  Quic,
+  Both,
+};
+
+struct Arguments
+{
+  size_t nodes = 4;
+  // 0 = every node sends
+  size_t senders = 0;
+  size_t payloadSize = 256;
+  // Messages per second per sender; 0 = as fast as the queue accepts
+  size_t rate = 100;
+  uint32_t durationSec = 10;
+  uint32_t warmupMs = 3000;
+  uint32_t basePort = 43000;
+  Transport transport = Transport::Tcp;
+};
+
+Arguments parseArgs(int argc, char** argv)
+{
+  Arguments args;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const string arg = argv[i];
+
+    if (arg == "--nodes" && i + 1 < argc)
+    {
+      args.nodes = std::strtoul(argv[++i], nullptr, 10);
+      if (args.nodes < 2)
+      {
+        throw std::invalid_argument("--nodes must be at least 2");
+      }
+    }
+    else if (arg == "--senders" && i + 1 < argc)
+    {
+      args.senders = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else if (arg == "--size" && i + 1 < argc)
+    {
+      args.payloadSize = std::strtoul(argv[++i], nullptr, 10);
+      if (args.payloadSize == 0)
+      {
+        throw std::invalid_argument("--size must be a positive number");
+      }
+    }
+    else if (arg == "--rate" && i + 1 < argc)
+    {
+      args.rate = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else if (arg == "--duration" && i + 1 < argc)
+    {
+      args.durationSec = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      if (args.durationSec == 0)
+      {
+        throw std::invalid_argument("--duration must be a positive number");
+      }
+    }
+    else if (arg == "--warmup-ms" && i + 1 < argc)
+    {
+      args.warmupMs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    }
+    else if (arg == "--base-port" && i + 1 < argc)
+    {
+      args.basePort = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+      if (args.basePort == 0 || args.basePort > 65535)
+      {
+        throw std::invalid_argument("--base-port must be a port number");
+      }
+    }
+    else if (arg == "--transport" && i + 1 < argc)
+    {
+      const string value = argv[++i];
+      if (value == "tcp")
+      {
+        args.transport = Transport::Tcp;
+      }
+      else if (value == "quic")
+      {
+        args.transport = Transport::Quic;
+      }
+      else if (value == "both")
+      {
+        args.transport = Transport::Both;
+      }
+      else
+      {
+        throw std::invalid_argument("--transport must be 'tcp', 'quic' or 'both'");
+      }
+    }
+    else if (arg == "--help" || arg == "-h")
+    {
+      cout << "Usage: loadgen [options]\n"
+           << "  --nodes <n>          Nodes in the loopback mesh (default 4)\n"
+           << "  --senders <n>        Nodes that publish (default: all)\n"
+           << "  --size <bytes>       Payload size, header included (default 256)\n"
+           << "  --rate <n>           Messages/s per sender, 0 = unthrottled (default 100)\n"
+           << "  --duration <s>       Send phase length (default 10)\n"
+           << "  --warmup-ms <ms>     Wait after dialing for the mesh to form (default 3000)\n"
+           << "  --base-port <port>   Node i listens on base-port + i (default 43000)\n"
+           << "  --transport tcp|quic|both (default tcp)\n";
+      std::exit(0);
+    }
+    else
+    {
+      throw std::invalid_argument("Unknown argument: " + arg);
+    }
+  }
+
+  if (args.senders == 0 || args.senders > args.nodes)
+  {
+    args.senders = args.nodes;
+  }
+
+  // Node i listens on basePort + i
+  if (static_cast<uint64_t>(args.basePort) + args.nodes - 1 > 65535)
+  {
+    throw std::invalid_argument("--base-port + --nodes - 1 must not exceed 65535");
+  }
+
+  return args;
+}
+
+// Prefix of every load payload; anything else on the topic is ignored
+constexpr uint8_t LOAD_MAGIC[4] = { 'L', 'G', 'E', 'N' };
+
+struct LoadHeader
+{
+  uint8_t magic[4];
+  uint32_t sender;
+  uint64_t seq;
+  // steady_clock at enqueue; comparable because all nodes share the process
+  uint64_t sentNs;
+};
+
+uint64_t steadyNowNs()
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+string readPeerId(const LoadgenAbi& abi, void* node)
+{
+  std::vector<char> buffer(128);
+  size_t written = 0;
+  const auto status = abi.LocalPeerId(node, buffer.data(), buffer.size(), &written);
+  if (status != CABI_STATUS_SUCCESS)
+  {
+    throw std::runtime_error("cabi_node_local_peer_id failed: " + std::to_string(status));
+  }
+  return string(buffer.data(), written);
+}
+
+string listenAddress(Transport transport, uint32_t port)
+{
+  if (transport == Transport::Quic)
+  {
+    return "/ip4/127.0.0.1/udp/" + std::to_string(port) + "/quic-v1";
+  }
+
+  return "/ip4/127.0.0.1/tcp/" + std::to_string(port);
+}
+
+// Owns the nodes of one run and the shared runtime they sit on; nodes are
+// freed before the runtime
+class Mesh
+{
+public:
+  Mesh(const LoadgenAbi& abi, Transport transport, const Arguments& args)
+    : abi_(abi)
+  {
+    try
+    {
+      start(transport, args);
+    }
+    catch (...)
+    {
+      release();
+      throw;
+    }
+  }
+
+  ~Mesh()
+  {
+    release();
+  }
+
+  Mesh(const Mesh&) = delete;
+  Mesh& operator=(const Mesh&) = delete;
+
+  const std::vector<void*>& nodes() const { return nodes_; }
+  bool sharedRuntime() const { return runtime_ != nullptr; }
+
+private:
+  void start(Transport transport, const Arguments& args)
+  {
+    const auto& abi = abi_;
+    if (abi.NewRuntime && abi.FreeRuntime && abi.NewNodeWithConfig)
+    {
+      CabiRuntimeConfig config{};
+      config.struct_size = sizeof(config);
+      runtime_ = abi.NewRuntime(&config);
+    }
+
+    std::vector<string> addresses;
+    for (size_t i = 0; i < args.nodes; ++i)
+    {
+      void* node = createNode(transport == Transport::Quic);
+      if (!node)
+      {
+        throw std::runtime_error("failed to create node #" + std::to_string(i));
+      }
+      nodes_.push_back(node);
+
+      const auto address = listenAddress(transport, args.basePort + static_cast<uint32_t>(i));
+      const auto status = abi.ListenNode(node, address.c_str());
+      if (status != CABI_STATUS_SUCCESS)
+      {
+        throw std::runtime_error("cabi_node_listen " + address + " failed: " + std::to_string(status));
+      }
+      addresses.push_back(address + "/p2p/" + readPeerId(abi, node));
+    }
+
+    // Full mesh: every node dials the ones started before it
+    for (size_t i = 1; i < nodes_.size(); ++i)
+    {
+      for (size_t j = 0; j < i; ++j)
+      {
+        const auto status = abi.DialNode(nodes_[i], addresses[j].c_str());
+        if (status != CABI_STATUS_SUCCESS)
+        {
+          cerr << "Node #" << i << " failed to dial " << addresses[j] << ": " << status << "\n";
+        }
+      }
+    }
+  }
+
+  void release()
+  {
+    for (auto* node : nodes_)
+    {
+      abi_.FreeNode(node);
+    }
+    nodes_.clear();
+    if (runtime_)
+    {
+      abi_.FreeRuntime(runtime_);
+      runtime_ = nullptr;
+    }
+  }
+
+  void* createNode(bool useQuic)
+  {
+    if (!runtime_)
+    {
+      return abi_.NewNode(useQuic, false, nullptr, 0, nullptr, 0);
+    }
+
+    CabiNodeConfig config{};
+    config.struct_size = sizeof(config);
+    config.use_quic = useQuic;
+    config.runtime = runtime_;
+    return abi_.NewNodeWithConfig(&config);
+  }
+
+  const LoadgenAbi& abi_;
+  CabiRuntime* runtime_ = nullptr;
+  std::vector<void*> nodes_;
+};
+
+struct SenderStats
+{
+  uint64_t sent = 0;
+  uint64_t rejected = 0;
+  uint64_t failed = 0;
+};
+
+// Publishes timestamped payloads at args.rate until `deadline`
+void sendLoop(const LoadgenAbi& abi, void* node, uint32_t senderIndex, const Arguments& args,
+              std::chrono::steady_clock::time_point deadline, SenderStats& stats)
+{
+  std::vector<uint8_t> payload(std::max(args.payloadSize, sizeof(LoadHeader)), 0x5a);
+  const auto interval = args.rate > 0
+    ? std::chrono::nanoseconds(1000000000ull / args.rate)
+    : std::chrono::nanoseconds(0);
+  auto next = std::chrono::steady_clock::now();
+
+  for (uint64_t seq = 0; std::chrono::steady_clock::now() < deadline; ++seq)
+  {
+    if (interval.count() > 0)
+    {
+      std::this_thread::sleep_until(next);
+      next += interval;
+    }
+
+    LoadHeader header{};
+    std::memcpy(header.magic, LOAD_MAGIC, sizeof(LOAD_MAGIC));
+    header.sender = senderIndex;
+    header.seq = seq;
+    header.sentNs = steadyNowNs();
+    std::memcpy(payload.data(), &header, sizeof(header));
+
+    const auto status = abi.EnqueueMessage(node, payload.data(), payload.size());
+    if (status == CABI_STATUS_SUCCESS)
+    {
+      ++stats.sent;
+    }
+    else if (status == CABI_STATUS_QUEUE_FULL)
+    {
+      ++stats.rejected;
+    }
+    else
+    {
+      ++stats.failed;
+    }
+  }
+}
+
+struct ReceiverStats
+{
+  uint64_t delivered = 0;
+  uint64_t bytes = 0;
+  std::vector<uint64_t> latenciesNs;
+};
+
+// Drains one node until `stop`, blocking in the library when it can
+void recvLoop(const LoadgenAbi& abi, void* node, const std::atomic<bool>& stop, ReceiverStats& stats)
+{
+  std::vector<uint8_t> buffer(64 * 1024);
+
+  while (!stop.load(std::memory_order_acquire))
+  {
+    size_t written = 0;
+    const auto status = abi.DequeueMessageTimeout
+      ? abi.DequeueMessageTimeout(node, buffer.data(), buffer.size(), &written, 50)
+      : abi.DequeueMessage(node, buffer.data(), buffer.size(), &written);
+
+    if (status == CABI_STATUS_QUEUE_EMPTY)
+    {
+      if (!abi.DequeueMessageTimeout)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      continue;
+    }
+    if (status == CABI_STATUS_BUFFER_TOO_SMALL)
+    {
+      buffer.resize(std::max(buffer.size() * 2, written));
+      continue;
+    }
+    if (status != CABI_STATUS_SUCCESS)
+    {
+      continue;
+    }
+
+    const auto receivedNs = steadyNowNs();
+    if (written < sizeof(LoadHeader) || std::memcmp(buffer.data(), LOAD_MAGIC, sizeof(LOAD_MAGIC)) != 0)
+    {
+      continue;
+    }
+
+    LoadHeader header{};
+    std::memcpy(&header, buffer.data(), sizeof(header));
+    ++stats.delivered;
+    stats.bytes += written;
+    stats.latenciesNs.push_back(receivedNs - header.sentNs);
+  }
+}
+
+// Nearest-rank percentile of sorted samples, in microseconds
+double percentileUs(const std::vector<uint64_t>& sorted, double percentile)
+{
+  if (sorted.empty())
+  {
+    return 0;
+  }
+  const auto rank = static_cast<size_t>(percentile / 100.0 * static_cast<double>(sorted.size()));
+  return static_cast<double>(sorted[std::min(rank, sorted.size() - 1)]) / 1000.0;
+}
+
+void runLoad(const LoadgenAbi& abi, Transport transport, const Arguments& args)
+{
+  const char* name = transport == Transport::Quic ? "quic" : "tcp";
+  Mesh mesh(abi, transport, args);
+  const auto& nodes = mesh.nodes();
+  cout << "[" << name << "] " << nodes.size() << " nodes, " << args.senders << " senders, "
+       << args.payloadSize << " B payloads, "
+       << (args.rate > 0 ? std::to_string(args.rate) + " msg/s per sender" : string("unthrottled"))
+       << (mesh.sharedRuntime() ? ", shared runtime" : ", runtime per node") << "\n";
+
+  // Step 1. Let connections and gossipsub meshes settle
+  std::this_thread::sleep_for(std::chrono::milliseconds(args.warmupMs));
+
+  // Step 2. Start every receiver, then every sender
+  std::atomic<bool> stop(false);
+  std::vector<ReceiverStats> receiverStats(nodes.size());
+  std::vector<std::thread> receivers;
+  for (size_t i = 0; i < nodes.size(); ++i)
+  {
+    receivers.emplace_back(recvLoop, std::cref(abi), nodes[i], std::cref(stop), std::ref(receiverStats[i]));
+  }
+
+  const auto started = std::chrono::steady_clock::now();
+  const auto deadline = started + std::chrono::seconds(args.durationSec);
+  std::vector<SenderStats> senderStats(args.senders);
+  std::vector<std::thread> senders;
+  for (size_t i = 0; i < args.senders; ++i)
+  {
+    senders.emplace_back(sendLoop, std::cref(abi), nodes[i], static_cast<uint32_t>(i), std::cref(args),
+                         deadline, std::ref(senderStats[i]));
+  }
+  for (auto& sender : senders)
+  {
+    sender.join();
+  }
+  const auto sendSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  // Step 3. Give in-flight messages a moment, then stop draining
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  const auto elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+  stop.store(true, std::memory_order_release);
+  for (auto& receiver : receivers)
+  {
+    receiver.join();
+  }
+
+  // Step 4. Report
+  SenderStats sent;
+  for (const auto& stats : senderStats)
+  {
+    sent.sent += stats.sent;
+    sent.rejected += stats.rejected;
+    sent.failed += stats.failed;
+  }
+  ReceiverStats received;
+  for (auto& stats : receiverStats)
+  {
+    received.delivered += stats.delivered;
+    received.bytes += stats.bytes;
+    received.latenciesNs.insert(received.latenciesNs.end(), stats.latenciesNs.begin(), stats.latenciesNs.end());
+  }
+  std::sort(received.latenciesNs.begin(), received.latenciesNs.end());
+
+  // Every publish should reach the other nodes - 1 receivers
+  const auto expected = sent.sent * (nodes.size() - 1);
+  cout << "[" << name << "] sent " << sent.sent << " (" << (sent.sent / sendSec) << " msg/s)";
+  if (sent.rejected > 0 || sent.failed > 0)
+  {
+    cout << ", rejected " << sent.rejected << ", failed " << sent.failed;
+  }
+  cout << "\n";
+  cout << "[" << name << "] delivered " << received.delivered << "/" << expected << " ("
+       << (received.delivered / elapsedSec) << " msg/s, "
+       << (received.bytes / elapsedSec / (1024.0 * 1024.0)) << " MiB/s)\n";
+  cout << "[" << name << "] latency us: p50 " << percentileUs(received.latenciesNs, 50)
+       << ", p99 " << percentileUs(received.latenciesNs, 99)
+       << ", p999 " << percentileUs(received.latenciesNs, 99.9)
+       << ", max " << (received.latenciesNs.empty() ? 0.0 : received.latenciesNs.back() / 1000.0) << "\n";
+}
+
+int main(int argc, char** argv)
+{
+  // Step 1. Load lib
+  LibHandle lib = LOAD_LIB(LIB_NAME);
+  if (!lib)
+  {
+    cerr << "Error loading lib: " << LIB_NAME << "\n";
+    return 1;
+  }
+
+  // Step 2. Load functions from lib
+  LoadgenAbi abi{};
+  if (!loadAbi(lib, abi))
+  {
+    cerr << "Missing required functions in library\n";
+    CLOSE_LIB(lib);
+    return 1;
+  }
+
+  // Step 3. Parse args
+  Arguments args;
+  try
+  {
+    args = parseArgs(argc, argv);
+  }
+  catch (const std::exception& ex)
+  {
+    cerr << "Argument error: " << ex.what() << "\n";
+    CLOSE_LIB(lib);
+    return 1;
+  }
+
+  // Step 4. One run per transport, each on a fresh mesh
+  try
+  {
+    if (args.transport != Transport::Quic)
+    {
+      runLoad(abi, Transport::Tcp, args);
+    }
+    if (args.transport != Transport::Tcp)
+    {
+      runLoad(abi, Transport::Quic, args);
+    }
+  }
+  catch (const std::exception& ex)
+  {
+    cerr << "Load run failed: " << ex.what() << "\n";
+    CLOSE_LIB(lib);
+    return 1;
+  }
+
+  CLOSE_LIB(lib);
+  return 0;
+}
@@ -1,18 +1,35 @@
 ﻿#include <algorithm>
 #include <cerrno>
 #include <chrono>
+#include <condition_variable>
 #include <csignal>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <exception>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <sstream>
 #include <optional>
 #include <string>
 #include <vector>
 #include <array>
 #include <thread>
 #include <atomic>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 // Crossplatform
 #ifdef _WIN32
@@ -33,35 +50,16 @@ using LibHandle = void*;
 constexpr auto LIB_NAME = "./libcabi_rust_libp2p.so";
 #endif
 
+// Statuses, constants and structs of the C-ABI. Functions are resolved at
+// runtime through GET_PROC, so optional ones can be missing from the library.
+#include "cabi-rust-libp2p.h"
+
 using std::cout;
 using std::cerr;
 using std::string;
 
-// General statuses
-// Operation completed successfully.
-constexpr int CABI_STATUS_SUCCESS = 0;
-// One of the provided pointers was null.
-constexpr int CABI_STATUS_NULL_POINTER = 1;
-// Invalid argument supplied (e.g. malformed multiaddr).
-constexpr int CABI_STATUS_INVALID_ARGUMENT = 2;
-// Internal runtime error – check logs for details.
-constexpr int CABI_STATUS_INTERNAL_ERROR = 3;
-
-// AutoNAT statuses
-// AutoNAT status has not yet been determined.
-constexpr int CABI_AUTONAT_UNKNOWN = 0;
-// AutoNAT reports the node as privately reachable only.
-constexpr int CABI_AUTONAT_PRIVATE = 1;
-// AutoNAT reports the node as publicly reachable.
-constexpr int CABI_AUTONAT_PUBLIC  = 2;
-
-// Payload statuses
-// Queue contains no new messages.
-constexpr int CABI_STATUS_QUEUE_EMPTY = -1;
-// Provided buffer too small to hold the next message.
-constexpr int CABI_STATUS_BUFFER_TOO_SMALL = -2;
-// Default capacity for the message queue.
-constexpr int DEFAULT_MESSAGE_QUEUE_CAPACITY = 64;
+// Default deadline for one cabi_node_dial_peer race.
+constexpr uint64_t DEFAULT_DIAL_TIMEOUT_MS = 10000;
 
 using InitTracingFunc = int (*)();
 using NewNodeFunc = void* (*)(
@@ -80,6 +78,169 @@ using DequeueMessageFunc = int (*)(void* handle, uint8_t* out_buffer, size_t buf
 using GetAddrsSnapshotFunc = int (*)(void* handle, uint64_t* out_version, char* out_buf, size_t out_buf_len, size_t* out_written);
 using LocalPeerIdFunc = int (*)(void* handle, char* out_buffer, size_t buffer_len, size_t* written_len);
 using FreeNodeFunc = void (*)(void* handle);
+// Optional, exported by newer library builds only
+using GetWaitFdFunc = int (*)(void* handle, int source, int* out_fd);
+using DequeueMessageTimeoutFunc = int (*)(void* handle, uint8_t* out_buffer, size_t buffer_len, size_t* written_len, uint64_t timeout_ms);
+// Statuses are written for the first *out_accepted buffers only, the prefix the
+// library processed; the rest were not enqueued.
+using EnqueueMessagesFunc = int (*)(
+  void* handle,
+  const struct CabiBuffer* buffers,
+  size_t count,
+  int* out_statuses,
+  size_t* out_accepted);
+// Copies up to max_messages queued messages into out_arena; message i is
+// out_lengths[i] bytes at out_offsets[i]. QUEUE_EMPTY (or SUCCESS with
+// *out_count == 0) means nothing is queued. BUFFER_TOO_SMALL means the head
+// message alone does not fit: out_lengths[0] holds its size and it stays queued.
+using DequeueMessagesFunc = int (*)(
+  void* handle,
+  uint8_t* out_arena,
+  size_t arena_len,
+  size_t* out_offsets,
+  size_t* out_lengths,
+  size_t max_messages,
+  size_t* out_count);
+using NewNodeWithConfigFunc = void* (*)(const struct CabiNodeConfig* config);
+using QueueStatsFunc = int (*)(void* handle, struct CabiQueueStats* out_stats);
+// Metrics snapshot text, one record per line:
+//   counter <name> <value>
+//   gauge <name> <value>
+//   histogram <name> <count> <sum_us> <min_us> <max_us> <le_us>:<cumulative> ...
+// Histogram buckets are log-linear (HDR style, ~3% relative error) with upper
+// bounds in microseconds; empty buckets are omitted. Histograms: dial,
+// relay_reservation, dht_put, dht_get, enqueue_to_wire, wire_to_dequeue.
+// Relay-side records: gauges relay_active_circuits, relay_reservations,
+// routing_table_size, connections_tcp, connections_quic, connections_relayed
+// and counter relay_bytes.
+using MetricsSnapshotFunc = int (*)(void* handle, char* out_buf, size_t out_buf_len, size_t* out_written);
+using NewRuntimeFunc = CabiRuntime* (*)(const struct CabiRuntimeConfig* config);
+using DhtPutRecordFunc = int (*)(
+  void* handle,
+  const uint8_t* key_ptr,
+  size_t key_len,
+  const uint8_t* value_ptr,
+  size_t value_len,
+  uint64_t ttl_seconds);
+using DhtGetRecordFunc = int (*)(
+  void* handle,
+  const uint8_t* key_ptr,
+  size_t key_len,
+  uint8_t* out_buffer,
+  size_t buffer_len,
+  size_t* written_len);
+// Start the query and return at once; the outcome is queued for
+// cabi_node_dequeue_dht_result under *out_request_id
+using DhtPutRecordAsyncFunc = int (*)(
+  void* handle,
+  const uint8_t* key_ptr,
+  size_t key_len,
+  const uint8_t* value_ptr,
+  size_t value_len,
+  uint64_t ttl_seconds,
+  uint64_t* out_request_id);
+using DhtGetRecordAsyncFunc = int (*)(
+  void* handle,
+  const uint8_t* key_ptr,
+  size_t key_len,
+  uint64_t* out_request_id);
+// Waits up to timeout_ms (0 = poll). BUFFER_TOO_SMALL leaves the result queued
+// and sets value_written to the size it needs.
+using DequeueDhtResultFunc = int (*)(
+  void* handle,
+  uint64_t timeout_ms,
+  uint64_t* request_id,
+  int* op_kind,
+  int* op_status,
+  uint8_t* value_buf,
+  size_t value_buf_len,
+  size_t* value_written);
+// Blocks until every record is stored or has failed. Keys routed to the same
+// region share one closest-peers lookup; one status per record.
+using DhtPutRecordsFunc = int (*)(
+  void* handle,
+  const CabiDhtRecord* records,
+  size_t count,
+  int* out_statuses);
+using GetClosestPeersFunc = int (*)(void* handle, const char* peer_id, uint64_t* request_id);
+using DequeueDiscoveryEventFunc = int (*)(
+  void* handle,
+  int* event_kind,
+  uint64_t* request_id,
+  int* status_code,
+  char* peer_id_buffer,
+  size_t peer_id_buffer_len,
+  size_t* peer_id_written_len,
+  char* address_buffer,
+  size_t address_buffer_len,
+  size_t* address_written_len);
+// Same as above but waits up to timeout_ms (0 = poll)
+using DequeueDiscoveryEventTimeoutFunc = int (*)(
+  void* handle,
+  uint64_t timeout_ms,
+  int* event_kind,
+  uint64_t* request_id,
+  int* status_code,
+  char* peer_id_buffer,
+  size_t peer_id_buffer_len,
+  size_t* peer_id_written_len,
+  char* address_buffer,
+  size_t address_buffer_len,
+  size_t* address_written_len);
+// Runs get_closest_peers for every target at once under one request id and
+// one deadline. Each newly seen peer (never the local one) is queued as an
+// ADDRESS event as soon as any query returns it; FINISHED follows when all
+// queries are done (SUCCESS) or the deadline passes (TIMEOUT).
+using DiscoverNeighborhoodFunc = int (*)(
+  void* handle,
+  const char* const* target_peer_ids,
+  size_t target_count,
+  uint64_t timeout_ms,
+  uint64_t* out_request_id);
+// Peer store: the Kademlia routing table, known peer addresses and the relays
+// holding a reservation, in a compact library-defined file. Save writes a temp
+// file and renames it over `path`; load merges the entries into a running
+// node (NOT_FOUND when the file does not exist) and redials the relays.
+using SavePeerStoreFunc = int (*)(void* handle, const char* path, size_t* out_peers);
+using LoadPeerStoreFunc = int (*)(void* handle, const char* path, size_t* out_peers);
+// Turns the circuit relay hop protocol on or off on a running node: no new
+// handle, no re-listen, and existing connections and queues are kept
+using SetRelayHopFunc = int (*)(void* handle, bool enable);
+// Waits up to timeout_ms (0 = poll) for the next node event. timestamp_ns is
+// CLOCK_MONOTONIC when the node saw it. The queue is bounded and drops its
+// oldest events when full; the wait fd for CABI_WAIT_SOURCE_NODE_EVENTS is an
+// eventfd counter to read before draining.
+using DequeueNodeEventFunc = int (*)(
+  void* handle,
+  uint64_t timeout_ms,
+  int* kind,
+  uint64_t* timestamp_ns,
+  int64_t* value,
+  char* peer_id_buffer,
+  size_t peer_id_buffer_len,
+  size_t* peer_id_written_len,
+  char* text_buffer,
+  size_t text_buffer_len,
+  size_t* text_written_len);
+// Connects to peer_id over the best of `addrs`. Returns at once when a
+// connection already exists, and concurrent calls for the same peer share one
+// attempt. Otherwise the addresses race happy-eyeballs style: direct QUIC,
+// then direct TCP, then relayed circuits, each started after a short stagger
+// or as soon as the previous one fails. The first connection wins and the
+// others are cancelled. Reports the winner's CABI_TRANSPORT_*, the time to
+// connect and the winning address.
+using DialPeerFunc = int (*)(
+  void* handle,
+  const char* peer_id,
+  const char* const* addrs,
+  size_t addr_count,
+  uint64_t timeout_ms,
+  int* out_transport,
+  uint64_t* out_connect_us,
+  char* winner_buffer,
+  size_t winner_buffer_len,
+  size_t* winner_written_len);
+using FreeRuntimeFunc = void (*)(CabiRuntime* runtime);
 
 struct CabiRustLibp2p
 {
@@ -94,6 +255,32 @@ struct CabiRustLibp2p
   GetAddrsSnapshotFunc  GetAddrsSnapshot{};
   LocalPeerIdFunc       LocalPeerId{};
   FreeNodeFunc          FreeNode{};
+
+  // Optional: null when the library does not export them
+  GetWaitFdFunc             GetWaitFd{};
+  DequeueMessageTimeoutFunc DequeueMessageTimeout{};
+  DequeueMessagesFunc       DequeueMessages{};
+  EnqueueMessagesFunc       EnqueueMessages{};
+  NewNodeWithConfigFunc     NewNodeWithConfig{};
+  QueueStatsFunc            QueueStats{};
+  NewRuntimeFunc            NewRuntime{};
+  FreeRuntimeFunc           FreeRuntime{};
+  MetricsSnapshotFunc       MetricsSnapshot{};
+  DhtPutRecordFunc          DhtPutRecord{};
+  DhtGetRecordFunc          DhtGetRecord{};
+  DhtPutRecordAsyncFunc     DhtPutRecordAsync{};
+  DhtGetRecordAsyncFunc     DhtGetRecordAsync{};
+  DequeueDhtResultFunc      DequeueDhtResult{};
+  DhtPutRecordsFunc         DhtPutRecords{};
+  GetClosestPeersFunc       GetClosestPeers{};
+  DequeueDiscoveryEventFunc DequeueDiscoveryEvent{};
+  DequeueDiscoveryEventTimeoutFunc DequeueDiscoveryEventTimeout{};
+  DiscoverNeighborhoodFunc  DiscoverNeighborhood{};
+  SavePeerStoreFunc         SavePeerStore{};
+  LoadPeerStoreFunc         LoadPeerStore{};
+  SetRelayHopFunc           SetRelayHop{};
+  DequeueNodeEventFunc      DequeueNodeEvent{};
+  DialPeerFunc              DialPeer{};
 };
 
 enum class Role
@@ -102,11 +289,72 @@ enum class Role
   Leaf,
 };
 
+enum class RecvMode
+{
+  // Event fd when exported, then blocking dequeue, then polling
+  Auto,
+  // Legacy 100 ms sleep-poll loop
+  Poll,
+  // Event-driven only; fails when the library has no wait ABI
+  Wait,
+};
+
+// Queue settings for cabi_node_new_with_config; all zero keeps cabi_node_new
+struct QueueSettings
+{
+  size_t messageCapacity = 0;
+  size_t discoveryCapacity = 0;
+  int overflowPolicy = CABI_OVERFLOW_DEFAULT;
+  uint32_t blockTimeoutMs = 0;
+
+  bool isDefault() const
+  {
+    return messageCapacity == 0 && discoveryCapacity == 0 &&
+           overflowPolicy == CABI_OVERFLOW_DEFAULT && blockTimeoutMs == 0;
+  }
+};
+
+// Transport, muxer, DHT and runtime knobs; zero keeps the library default
+struct NodeTuning
+{
+  uint32_t maxConnections = 0;
+  uint32_t maxConnectionsPerPeer = 0;
+  uint32_t maxPendingIncoming = 0;
+  uint32_t maxPendingOutgoing = 0;
+  uint64_t idleTimeoutMs = 0;
+  uint32_t yamuxWindow = 0;
+  uint32_t kadAlpha = 0;
+  uint32_t kadReplication = 0;
+  uint32_t workerThreads = 0;
+
+  bool isDefault() const
+  {
+    return maxConnections == 0 && maxConnectionsPerPeer == 0 &&
+           maxPendingIncoming == 0 && maxPendingOutgoing == 0 &&
+           idleTimeoutMs == 0 && yamuxWindow == 0 &&
+           kadAlpha == 0 && kadReplication == 0 && workerThreads == 0;
+  }
+};
+
 struct Arguments
 {
   Role role = Role::Leaf;
   bool useQuic = false;
   bool forceHop = false;
+  RecvMode recvMode = RecvMode::Auto;
+  size_t sendBatch = 1;
+  QueueSettings queues{};
+  NodeTuning tuning{};
+  // Fleet mode: N nodes sharing one runtime
+  size_t nodeCount = 1;
+  uint32_t runtimeThreads = 0;
+  bool pinCores = false;
+  // Loopback Prometheus endpoint; 0 = off
+  uint16_t metricsPort = 0;
+  // Routing table / address book file; empty = cold start every time
+  string peerStorePath;
+  // Compare time to first lookup without and with the peer store, then exit
+  bool warmStartBench = false;
   string listen;
   std::vector<string> bootstrapPeers{};
   std::vector<string> targetPeers{};
@@ -135,6 +383,28 @@ struct NodeHandle
   const CabiRustLibp2p* abi = nullptr;
 };
 
+// RAII for a shared runtime; free only after every node attached to it
+struct RuntimeHandle
+{
+  void reset(CabiRuntime* newHandle = nullptr)
+  {
+    if (handle && abi && abi->FreeRuntime)
+    {
+      abi->FreeRuntime(handle);
+    }
+
+    handle = newHandle;
+  }
+
+  ~RuntimeHandle()
+  {
+    reset();
+  }
+
+  CabiRuntime* handle = nullptr;
+  const CabiRustLibp2p* abi = nullptr;
+};
+
 string statusMessage(int status)
 {
   switch (status)
@@ -149,6 +419,12 @@ string statusMessage(int status)
     return "Queue empty";
   case CABI_STATUS_BUFFER_TOO_SMALL:
     return "Provided buffer too small";
+  case CABI_STATUS_QUEUE_FULL:
+    return "Queue full (overflow policy rejected the message)";
+  case CABI_STATUS_TIMEOUT:
+    return "Timed out";
+  case CABI_STATUS_NOT_FOUND:
+    return "Not found";
   default:
     return "Internal error - inspect Rust logs for details";
   }
@@ -168,6 +444,33 @@ bool loadAbi(LibHandle lib, CabiRustLibp2p& abi)
   abi.LocalPeerId = reinterpret_cast<LocalPeerIdFunc>(GET_PROC(lib, "cabi_node_local_peer_id"));
   abi.FreeNode = reinterpret_cast<FreeNodeFunc>(GET_PROC(lib, "cabi_node_free"));
 
+  // Optional ones. Older builds lack them and callers fall back
+  abi.GetWaitFd = reinterpret_cast<GetWaitFdFunc>(GET_PROC(lib, "cabi_node_get_wait_fd"));
+  abi.DequeueMessageTimeout = reinterpret_cast<DequeueMessageTimeoutFunc>(GET_PROC(lib, "cabi_node_dequeue_message_timeout"));
+  abi.DequeueMessages = reinterpret_cast<DequeueMessagesFunc>(GET_PROC(lib, "cabi_node_dequeue_messages"));
+  abi.EnqueueMessages = reinterpret_cast<EnqueueMessagesFunc>(GET_PROC(lib, "cabi_node_enqueue_messages"));
+  abi.NewNodeWithConfig = reinterpret_cast<NewNodeWithConfigFunc>(GET_PROC(lib, "cabi_node_new_with_config"));
+  abi.NewRuntime = reinterpret_cast<NewRuntimeFunc>(GET_PROC(lib, "cabi_runtime_new"));
+  abi.FreeRuntime = reinterpret_cast<FreeRuntimeFunc>(GET_PROC(lib, "cabi_runtime_free"));
+  abi.MetricsSnapshot = reinterpret_cast<MetricsSnapshotFunc>(GET_PROC(lib, "cabi_node_metrics_snapshot"));
+  abi.DhtPutRecord = reinterpret_cast<DhtPutRecordFunc>(GET_PROC(lib, "cabi_node_dht_put_record"));
+  abi.DhtGetRecord = reinterpret_cast<DhtGetRecordFunc>(GET_PROC(lib, "cabi_node_dht_get_record"));
+  abi.DhtPutRecordAsync = reinterpret_cast<DhtPutRecordAsyncFunc>(GET_PROC(lib, "cabi_node_dht_put_record_async"));
+  abi.DhtGetRecordAsync = reinterpret_cast<DhtGetRecordAsyncFunc>(GET_PROC(lib, "cabi_node_dht_get_record_async"));
+  abi.DequeueDhtResult = reinterpret_cast<DequeueDhtResultFunc>(GET_PROC(lib, "cabi_node_dequeue_dht_result"));
+  abi.DhtPutRecords = reinterpret_cast<DhtPutRecordsFunc>(GET_PROC(lib, "cabi_node_dht_put_records"));
+  abi.QueueStats = reinterpret_cast<QueueStatsFunc>(GET_PROC(lib, "cabi_node_queue_stats"));
+  abi.GetClosestPeers = reinterpret_cast<GetClosestPeersFunc>(GET_PROC(lib, "cabi_node_get_closest_peers"));
+  abi.DequeueDiscoveryEvent = reinterpret_cast<DequeueDiscoveryEventFunc>(GET_PROC(lib, "cabi_node_dequeue_discovery_event"));
+  abi.DequeueDiscoveryEventTimeout =
+    reinterpret_cast<DequeueDiscoveryEventTimeoutFunc>(GET_PROC(lib, "cabi_node_dequeue_discovery_event_timeout"));
+  abi.DiscoverNeighborhood = reinterpret_cast<DiscoverNeighborhoodFunc>(GET_PROC(lib, "cabi_node_discover_neighborhood"));
+  abi.SavePeerStore = reinterpret_cast<SavePeerStoreFunc>(GET_PROC(lib, "cabi_node_save_peer_store"));
+  abi.LoadPeerStore = reinterpret_cast<LoadPeerStoreFunc>(GET_PROC(lib, "cabi_node_load_peer_store"));
+  abi.SetRelayHop = reinterpret_cast<SetRelayHopFunc>(GET_PROC(lib, "cabi_node_set_relay_hop"));
+  abi.DequeueNodeEvent = reinterpret_cast<DequeueNodeEventFunc>(GET_PROC(lib, "cabi_node_dequeue_node_event"));
+  abi.DialPeer = reinterpret_cast<DialPeerFunc>(GET_PROC(lib, "cabi_node_dial_peer"));
+
   return  abi.InitTracing && abi.NewNode && abi.ListenNode &&
           abi.DialNode && abi.AutonatStatus && abi.EnqueueMessage &&
           abi.DequeueMessage && abi.GetAddrsSnapshot && abi.LocalPeerId &&
@@ -184,6 +487,16 @@ string defaultListen(bool useQuic)
   return "/ip4/127.0.0.1/tcp/41000";
 }
 
+string ephemeralListen(bool useQuic)
+{
+  if (useQuic)
+  {
+    return "/ip4/127.0.0.1/udp/0/quic-v1";
+  }
+
+  return "/ip4/127.0.0.1/tcp/0";
+}
+
 std::array<uint8_t, 32> parseSeed(const string& hexSeed)
 {
   if (hexSeed.size() != 64)
@@ -248,6 +561,16 @@ std::array<uint8_t, 32> deriveSeedFromString(const string& seedPhrase)
   return seed;
 }
 
+uint32_t parsePositiveU32(const string& flag, const char* value)
+{
+  const auto parsed = std::strtoul(value, nullptr, 10);
+  if (parsed == 0 || parsed > std::numeric_limits<uint32_t>::max())
+  {
+    throw std::invalid_argument(flag + " must be a positive 32-bit number");
+  }
+  return static_cast<uint32_t>(parsed);
+}
+
 Arguments parseArgs(int argc, char** argv)
 {
   Arguments args;
@@ -282,6 +605,140 @@ Arguments parseArgs(int argc, char** argv)
     {
       args.forceHop = true;
     }
+    else if (arg == "--recv-mode" && i + 1 < argc)
+    {
+      const string modeValue = argv[++i];
+      if (modeValue == "auto")
+      {
+        args.recvMode = RecvMode::Auto;
+      }
+      else if (modeValue == "poll")
+      {
+        args.recvMode = RecvMode::Poll;
+      }
+      else if (modeValue == "wait")
+      {
+        args.recvMode = RecvMode::Wait;
+      }
+      else
+      {
+        throw std::invalid_argument("--recv-mode must be 'auto', 'poll' or 'wait'");
+      }
+    }
+    else if (arg == "--send-batch" && i + 1 < argc)
+    {
+      const auto value = std::strtoul(argv[++i], nullptr, 10);
+      if (value == 0)
+      {
+        throw std::invalid_argument("--send-batch must be a positive number");
+      }
+      args.sendBatch = value;
+    }
+    else if (arg == "--queue-capacity" && i + 1 < argc)
+    {
+      args.queues.messageCapacity = std::strtoul(argv[++i], nullptr, 10);
+      if (args.queues.messageCapacity == 0)
+      {
+        throw std::invalid_argument("--queue-capacity must be a positive number");
+      }
+    }
+    else if (arg == "--discovery-queue-capacity" && i + 1 < argc)
+    {
+      args.queues.discoveryCapacity = std::strtoul(argv[++i], nullptr, 10);
+      if (args.queues.discoveryCapacity == 0)
+      {
+        throw std::invalid_argument("--discovery-queue-capacity must be a positive number");
+      }
+    }
+    else if (arg == "--overflow" && i + 1 < argc)
+    {
+      const string policyValue = argv[++i];
+      if (policyValue == "drop-oldest")
+      {
+        args.queues.overflowPolicy = CABI_OVERFLOW_DROP_OLDEST;
+      }
+      else if (policyValue == "drop-newest")
+      {
+        args.queues.overflowPolicy = CABI_OVERFLOW_DROP_NEWEST;
+      }
+      else if (policyValue == "block")
+      {
+        args.queues.overflowPolicy = CABI_OVERFLOW_BLOCK;
+      }
+      else
+      {
+        throw std::invalid_argument("--overflow must be 'drop-oldest', 'drop-newest' or 'block'");
+      }
+    }
+    else if (arg == "--block-timeout-ms" && i + 1 < argc)
+    {
+      args.queues.blockTimeoutMs = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+    }
+    else if (arg == "--max-connections" && i + 1 < argc)
+    {
+      args.tuning.maxConnections = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--max-connections-per-peer" && i + 1 < argc)
+    {
+      args.tuning.maxConnectionsPerPeer = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--max-pending-incoming" && i + 1 < argc)
+    {
+      args.tuning.maxPendingIncoming = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--max-pending-outgoing" && i + 1 < argc)
+    {
+      args.tuning.maxPendingOutgoing = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--idle-timeout-ms" && i + 1 < argc)
+    {
+      args.tuning.idleTimeoutMs = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--yamux-window" && i + 1 < argc)
+    {
+      args.tuning.yamuxWindow = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--kad-alpha" && i + 1 < argc)
+    {
+      args.tuning.kadAlpha = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--kad-replication" && i + 1 < argc)
+    {
+      args.tuning.kadReplication = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--worker-threads" && i + 1 < argc)
+    {
+      args.tuning.workerThreads = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--nodes" && i + 1 < argc)
+    {
+      args.nodeCount = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--runtime-threads" && i + 1 < argc)
+    {
+      args.runtimeThreads = parsePositiveU32(arg, argv[++i]);
+    }
+    else if (arg == "--pin-cores")
+    {
+      args.pinCores = true;
+    }
+    else if (arg == "--metrics-port" && i + 1 < argc)
+    {
+      const auto port = parsePositiveU32(arg, argv[++i]);
+      if (port > 65535)
+      {
+        throw std::invalid_argument("--metrics-port must be a port number");
+      }
+      args.metricsPort = static_cast<uint16_t>(port);
+    }
+    else if (arg == "--peer-store" && i + 1 < argc)
+    {
+      args.peerStorePath = argv[++i];
+    }
+    else if (arg == "--warm-start-bench")
+    {
+      args.warmStartBench = true;
+    }
     else if (arg == "--listen" && i + 1 < argc)
     {
       args.listen = argv[++i];
@@ -322,6 +779,24 @@ Arguments parseArgs(int argc, char** argv)
             << "  --bootstrap <multiaddr> (repeatable)\n"
             << "  --force-hop (relay only; start with hop enabled without waiting for AutoNAT)\n"
             << "  --target <multiaddr> (repeatable)\n"
+            << "  --recv-mode auto|poll|wait (default: auto; poll is the legacy 100 ms loop)\n"
+            << "  --send-batch <N> (submit typed payloads N at a time; default: 1)\n"
+            << "  --queue-capacity <N> (inbound/outbound message queues; default: 64)\n"
+            << "  --discovery-queue-capacity <N> (default: 64)\n"
+            << "  --overflow drop-oldest|drop-newest|block (queue overflow policy)\n"
+            << "  --block-timeout-ms <N> (how long 'block' waits for room)\n"
+            << "  --max-connections <N>, --max-connections-per-peer <N>\n"
+            << "  --max-pending-incoming <N>, --max-pending-outgoing <N>\n"
+            << "  --idle-timeout-ms <N> (close connections idle this long)\n"
+            << "  --yamux-window <bytes> (per-stream receive window)\n"
+            << "  --kad-alpha <N>, --kad-replication <N> (Kademlia parallelism, k)\n"
+            << "  --worker-threads <N> (tokio runtime threads)\n"
+            << "  --nodes <N> (start N nodes on one shared runtime and report threads/memory)\n"
+            << "  --runtime-threads <N> (workers of the shared runtime; default: one per core)\n"
+            << "  --pin-cores (pin shared runtime workers to cores)\n"
+            << "  --metrics-port <port> (serve Prometheus metrics on 127.0.0.1:<port>/metrics)\n"
+            << "  --peer-store <path> (load routing table/addresses at start, save periodically and on exit)\n"
+            << "  --warm-start-bench (time first lookup cold vs. from --peer-store, then exit)\n"
             << "  --seed <64-hex-bytes> (deterministic PeerId)\n"
             << "  --seed-phrase <string> (derive 32-byte seed deterministically)\n";
 
@@ -335,7 +810,24 @@ Arguments parseArgs(int argc, char** argv)
 
   if (!listenProvided)
   {
-    args.listen = defaultListen(args.useQuic);
+    // A fleet binds ephemeral ports so its nodes do not collide, and the
+    // warm-start bench so its second node does not wait for the first's port
+    args.listen = args.nodeCount > 1 || args.warmStartBench ? ephemeralListen(args.useQuic) : defaultListen(args.useQuic);
+  }
+
+  if (args.warmStartBench && (args.peerStorePath.empty() || args.bootstrapPeers.empty()))
+  {
+    throw std::invalid_argument("--warm-start-bench requires --peer-store and at least one --bootstrap");
+  }
+
+  if ((args.runtimeThreads != 0 || args.pinCores) && args.nodeCount < 2)
+  {
+    throw std::invalid_argument("--runtime-threads/--pin-cores require --nodes 2 or more");
+  }
+
+  if (args.queues.blockTimeoutMs != 0 && args.queues.overflowPolicy != CABI_OVERFLOW_BLOCK)
+  {
+    throw std::invalid_argument("--block-timeout-ms requires --overflow block");
   }
 
   return args;
@@ -359,7 +851,10 @@ void* createNode(
   bool useQuic,
   bool enableRelayHop,
   const std::vector<string>& bootstrapPeers,
-  const std::optional<std::array<uint8_t, 32>>& seed)
+  const std::optional<std::array<uint8_t, 32>>& seed,
+  const QueueSettings& queues,
+  const NodeTuning& tuning,
+  CabiRuntime* runtime = nullptr)
 {
   auto bootstrapPtrs = toCStrVector(bootstrapPeers);
 
@@ -374,13 +869,48 @@ void* createNode(
     seedLen = seedStorage.size();
   }
 
-  void* node = abi.NewNode(
-    useQuic,
-    enableRelayHop,
-    bootstrapPtrs.data(),
-    bootstrapPtrs.size(),
-    seedPtr,
-    seedLen);
+  void* node = nullptr;
+  if (queues.isDefault() && tuning.isDefault() && !runtime)
+  {
+    node = abi.NewNode(
+      useQuic,
+      enableRelayHop,
+      bootstrapPtrs.data(),
+      bootstrapPtrs.size(),
+      seedPtr,
+      seedLen);
+  }
+  else
+  {
+    if (!abi.NewNodeWithConfig)
+    {
+      throw std::runtime_error("queue and tuning flags need cabi_node_new_with_config, which this library lacks");
+    }
+
+    CabiNodeConfig config{};
+    config.struct_size = sizeof(config);
+    config.use_quic = useQuic;
+    config.enable_relay_hop = enableRelayHop;
+    config.bootstrap_peers = bootstrapPtrs.data();
+    config.bootstrap_peers_len = bootstrapPtrs.size();
+    config.identity_seed_ptr = seedPtr;
+    config.identity_seed_len = seedLen;
+    config.message_queue_capacity = queues.messageCapacity;
+    config.discovery_queue_capacity = queues.discoveryCapacity;
+    config.overflow_policy = queues.overflowPolicy;
+    config.block_timeout_ms = queues.blockTimeoutMs;
+    config.max_established_connections = tuning.maxConnections;
+    config.max_connections_per_peer = tuning.maxConnectionsPerPeer;
+    config.max_pending_incoming = tuning.maxPendingIncoming;
+    config.max_pending_outgoing = tuning.maxPendingOutgoing;
+    config.idle_connection_timeout_ms = tuning.idleTimeoutMs;
+    config.yamux_max_receive_window = tuning.yamuxWindow;
+    config.kad_parallelism = tuning.kadAlpha;
+    config.kad_replication_factor = tuning.kadReplication;
+    config.worker_threads = tuning.workerThreads;
+    config.runtime = runtime;
+    node = abi.NewNodeWithConfig(&config);
+  }
 
   if (!node)
   {
@@ -413,6 +943,117 @@ std::string readPeerId(const CabiRustLibp2p& abi, void* node)
   return string(buffer.data(), written);
 }
 
+// Toggles relay hop on the running node; false when the library cannot
+bool setRelayHop(const CabiRustLibp2p& abi, void* node, bool enable)
+{
+  if (!abi.SetRelayHop)
+  {
+    return false;
+  }
+  const auto started = std::chrono::steady_clock::now();
+  const auto status = abi.SetRelayHop(node, enable);
+  if (status != CABI_STATUS_SUCCESS)
+  {
+    cerr << "cabi_node_set_relay_hop failed: " << statusMessage(status) << "\n";
+    return false;
+  }
+  const auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+  cout << "Relay hop " << (enable ? "enabled" : "disabled") << " in " << elapsedUs << " us\n";
+  return true;
+}
+
+// One entry of the node event stream
+struct NodeEvent
+{
+  int kind = 0;
+  uint64_t timestampNs = 0;
+  int64_t value = 0;
+  string peerId;
+  string text;
+};
+
+// Next event from the node's event stream, waiting up to timeoutMs (0 = poll)
+bool nextNodeEvent(const CabiRustLibp2p& abi, void* node, uint64_t timeoutMs, NodeEvent& event)
+{
+  std::array<char, 256> peerId{};
+  std::array<char, 1024> text{};
+  size_t peerIdLen = 0;
+  size_t textLen = 0;
+  const auto status = abi.DequeueNodeEvent(
+    node, timeoutMs, &event.kind, &event.timestampNs, &event.value,
+    peerId.data(), peerId.size(), &peerIdLen, text.data(), text.size(), &textLen);
+  if (status != CABI_STATUS_SUCCESS)
+  {
+    return false;
+  }
+  event.peerId.assign(peerId.data(), std::min(peerIdLen, peerId.size()));
+  event.text.assign(text.data(), std::min(textLen, text.size()));
+  return true;
+}
+
+const char* autonatName(int64_t status)
+{
+  switch (status)
+  {
+  case CABI_AUTONAT_PUBLIC:
+    return "public";
+  case CABI_AUTONAT_PRIVATE:
+    return "private";
+  default:
+    return "unknown";
+  }
+}
+
+// One line per event, with how long it took from the node to this print.
+// steady_clock is CLOCK_MONOTONIC on Linux, the clock the timestamps use.
+void printNodeEvent(const NodeEvent& event)
+{
+  cout << "Event: ";
+  switch (event.kind)
+  {
+  case CABI_NODE_EVENT_AUTONAT_CHANGED:
+    cout << "AutoNAT " << autonatName(event.value);
+    break;
+  case CABI_NODE_EVENT_LISTEN_ADDR_ADDED:
+    cout << "listening on " << event.text;
+    break;
+  case CABI_NODE_EVENT_LISTEN_ADDR_REMOVED:
+    cout << "stopped listening on " << event.text;
+    break;
+  case CABI_NODE_EVENT_CONNECTION_OPENED:
+    cout << "connected to " << event.peerId << " via " << event.text << " (" << event.value << " open)";
+    break;
+  case CABI_NODE_EVENT_CONNECTION_CLOSED:
+    cout << "disconnected from " << event.peerId << " (" << event.value << " open)";
+    break;
+  case CABI_NODE_EVENT_RESERVATION_ACCEPTED:
+    cout << "reservation accepted by " << event.peerId << ": " << event.text;
+    break;
+  case CABI_NODE_EVENT_RESERVATION_EXPIRED:
+    cout << "reservation on " << event.peerId << " expired";
+    break;
+  default:
+    cout << "kind " << event.kind;
+    break;
+  }
+  const auto nowNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+  if (event.timestampNs != 0 && nowNs >= event.timestampNs)
+  {
+    cout << " [+" << (nowNs - event.timestampNs) / 1000 << " us]";
+  }
+  cout << "\n";
+}
+
+void drainNodeEvents(const CabiRustLibp2p& abi, void* node)
+{
+  NodeEvent event;
+  while (nextNodeEvent(abi, node, 0, event))
+  {
+    printNodeEvent(event);
+  }
+}
+
 // Get Autonat status in order to have a possibility
 // to detect whether it is public or private
 bool waitForPublicAutonat(const CabiRustLibp2p& abi, void* node,
@@ -420,6 +1061,30 @@ bool waitForPublicAutonat(const CabiRustLibp2p& abi, void* node,
 {
   auto start = std::chrono::steady_clock::now();
 
+  // With the event stream the transition is seen the moment it happens
+  if (abi.DequeueNodeEvent)
+  {
+    if (abi.AutonatStatus(node) == CABI_AUTONAT_PUBLIC)
+    {
+      return true;
+    }
+    NodeEvent event;
+    for (auto now = start; now - start < timeout; now = std::chrono::steady_clock::now())
+    {
+      const auto leftMs = std::chrono::duration_cast<std::chrono::milliseconds>(timeout - (now - start)).count();
+      if (!nextNodeEvent(abi, node, static_cast<uint64_t>(std::max<int64_t>(leftMs, 1)), event))
+      {
+        continue;
+      }
+      printNodeEvent(event);
+      if (event.kind == CABI_NODE_EVENT_AUTONAT_CHANGED && event.value == CABI_AUTONAT_PUBLIC)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
   while (std::chrono::steady_clock::now() - start < timeout)
   {
     const int status = abi.AutonatStatus(node);
@@ -443,72 +1108,461 @@ bool waitForPublicAutonat(const CabiRustLibp2p& abi, void* node,
   return false;
 }
 
-void recvLoop(
+// Probe payloads carry the sender's steady clock so a receiver
+// on the same host can measure queue-to-print latency
+constexpr auto PROBE_PREFIX = "probe:";
+
+uint64_t steadyNowNs()
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+struct ReceiverStats
+{
+  uint64_t wakeups = 0;
+  uint64_t messages = 0;
+  uint64_t probes = 0;
+  uint64_t probeTotalUs = 0;
+  uint64_t probeMaxUs = 0;
+};
+
+// Wakes the receiver on shutdown so the event-driven wait needs no timeout
+struct StopSignal
+{
+  StopSignal()
+  {
+#ifdef __linux__
+    fd = eventfd(0, EFD_CLOEXEC);
+#endif
+  }
+
+  ~StopSignal()
+  {
+#ifdef __linux__
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+#endif
+  }
+
+  void notify() const
+  {
+#ifdef __linux__
+    if (fd >= 0)
+    {
+      const uint64_t one = 1;
+      [[maybe_unused]] const auto ignored = write(fd, &one, sizeof(one));
+    }
+#endif
+  }
+
+  int fd = -1;
+};
+
+void handlePayload(const uint8_t* data, size_t len, ReceiverStats& stats)
+{
+  ++stats.messages;
+  const string payload(reinterpret_cast<const char*>(data), len);
+
+  if (payload.rfind(PROBE_PREFIX, 0) == 0)
+  {
+    // probe:<sent_ns>:<seq>
+    const uint64_t sentNs = std::strtoull(payload.c_str() + std::strlen(PROBE_PREFIX), nullptr, 10);
+    const uint64_t nowNs = steadyNowNs();
+    const uint64_t latencyUs = nowNs > sentNs ? (nowNs - sentNs) / 1000 : 0;
+    ++stats.probes;
+    stats.probeTotalUs += latencyUs;
+    stats.probeMaxUs = std::max(stats.probeMaxUs, latencyUs);
+    cout << "Received probe '" << payload << "' latency " << latencyUs << " us\n";
+    return;
+  }
+
+  cout << "Received payload: '" << payload << "'\n";
+}
+
+// Most messages drained per cabi_node_dequeue_messages call
+constexpr size_t RECV_BATCH_MAX = 64;
+
+// Drains the queue in bursts: one ABI call fills the arena with as many
+// messages as fit and returns their offsets/lengths
+bool drainMessageBatches(
   const CabiRustLibp2p& abi,
   void* node,
-  std::atomic<bool>& keepRunning)
+  std::vector<uint8_t>& arena,
+  ReceiverStats& stats)
 {
-  std::vector<uint8_t> buffer(1024);
+  std::array<size_t, RECV_BATCH_MAX> offsets{};
+  std::array<size_t, RECV_BATCH_MAX> lengths{};
 
-  while (keepRunning.load(std::memory_order_acquire))
+  while (true)
   {
-    size_t written = 0;
-    // Here you get the message
-    const auto recvStatus = abi.DequeueMessage(
+    size_t count = 0;
+    const auto recvStatus = abi.DequeueMessages(
       node,
-      buffer.data(),
-      buffer.size(),
-      &written);
+      arena.data(),
+      arena.size(),
+      offsets.data(),
+      lengths.data(),
+      offsets.size(),
+      &count);
 
     if (recvStatus == CABI_STATUS_SUCCESS)
     {
-      const string payload(
-        reinterpret_cast<const char*>(buffer.data()),
-        written);
-      cout << "Received payload: '" << payload << "'\n";
+      // SUCCESS with nothing copied means empty, as for the JNI consumer
+      if (count == 0)
+      {
+        return true;
+      }
+      for (size_t i = 0; i < count; ++i)
+      {
+        handlePayload(arena.data() + offsets[i], lengths[i], stats);
+      }
       continue;
     }
 
-    // Wait a lil bit to reduce rquests
     if (recvStatus == CABI_STATUS_QUEUE_EMPTY)
     {
-      std::this_thread::sleep_for(std::chrono::milliseconds(100));
-      continue;
+      return true;
     }
 
-    // Hadle bufer is to small to recieve payload
+    // The head message alone does not fit; lengths[0] holds its size
     if (recvStatus == CABI_STATUS_BUFFER_TOO_SMALL)
     {
-      const auto newSize = std::max(buffer.size() * 2, written);
-      buffer.resize(newSize);
-      cerr << "Resized receive buffer to " << newSize << " bytes\n";
+      const auto newSize = std::max(arena.size() * 2, lengths[0]);
+      arena.resize(newSize);
+      cerr << "Resized receive arena to " << newSize << " bytes\n";
       continue;
     }
 
-    cerr << "Failed to dequeue message: " << statusMessage(recvStatus) << "\n";
-    keepRunning.store(false, std::memory_order_release);
-    break;
+    cerr << "Failed to dequeue messages: " << statusMessage(recvStatus) << "\n";
+    return false;
   }
 }
 
-void getAddrsSnapshot(
+// Dequeues everything currently queued. Returns false on a fatal ABI error
+bool drainMessages(
   const CabiRustLibp2p& abi,
-  void* node)
+  void* node,
+  std::vector<uint8_t>& buffer,
+  ReceiverStats& stats)
 {
-  std::vector<char> buffer(256);
-  uint64_t version = 0;
+  if (abi.DequeueMessages)
+  {
+    return drainMessageBatches(abi, node, buffer, stats);
+  }
 
   while (true)
   {
     size_t written = 0;
-    const auto status = abi.GetAddrsSnapshot(
+    // Here you get the message
+    const auto recvStatus = abi.DequeueMessage(
       node,
-      &version,
       buffer.data(),
       buffer.size(),
       &written);
 
-    if (status == CABI_STATUS_SUCCESS)
+    if (recvStatus == CABI_STATUS_SUCCESS)
+    {
+      handlePayload(buffer.data(), written, stats);
+      continue;
+    }
+
+    if (recvStatus == CABI_STATUS_QUEUE_EMPTY)
+    {
+      return true;
+    }
+
+    // Hadle bufer is to small to recieve payload
+    if (recvStatus == CABI_STATUS_BUFFER_TOO_SMALL)
+    {
+      const auto newSize = std::max(buffer.size() * 2, written);
+      buffer.resize(newSize);
+      cerr << "Resized receive buffer to " << newSize << " bytes\n";
+      continue;
+    }
+
+    cerr << "Failed to dequeue message: " << statusMessage(recvStatus) << "\n";
+    return false;
+  }
+}
+
+// Legacy loop: up to 100 ms extra latency and 10 wakeups/s while idle
+void pollReceive(
+  const CabiRustLibp2p& abi,
+  void* node,
+  std::atomic<bool>& keepRunning,
+  std::vector<uint8_t>& buffer,
+  ReceiverStats& stats)
+{
+  while (keepRunning.load(std::memory_order_acquire))
+  {
+    ++stats.wakeups;
+    if (!drainMessages(abi, node, buffer, stats))
+    {
+      keepRunning.store(false, std::memory_order_release);
+      break;
+    }
+
+    // Wait a lil bit to reduce rquests
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+}
+
+// Blocking dequeue: wakes on arrival, the timeout only bounds shutdown time
+void timedReceive(
+  const CabiRustLibp2p& abi,
+  void* node,
+  std::atomic<bool>& keepRunning,
+  std::vector<uint8_t>& buffer,
+  ReceiverStats& stats)
+{
+  constexpr uint64_t SHUTDOWN_CHECK_MS = 500;
+
+  while (keepRunning.load(std::memory_order_acquire))
+  {
+    size_t written = 0;
+    const auto recvStatus = abi.DequeueMessageTimeout(
+      node,
+      buffer.data(),
+      buffer.size(),
+      &written,
+      SHUTDOWN_CHECK_MS);
+    ++stats.wakeups;
+
+    if (recvStatus == CABI_STATUS_SUCCESS)
+    {
+      handlePayload(buffer.data(), written, stats);
+      // The rest of the burst without further waits
+      if (!drainMessages(abi, node, buffer, stats))
+      {
+        keepRunning.store(false, std::memory_order_release);
+        break;
+      }
+      continue;
+    }
+
+    if (recvStatus == CABI_STATUS_QUEUE_EMPTY)
+    {
+      continue;
+    }
+
+    if (recvStatus == CABI_STATUS_BUFFER_TOO_SMALL)
+    {
+      const auto newSize = std::max(buffer.size() * 2, written);
+      buffer.resize(newSize);
+      cerr << "Resized receive buffer to " << newSize << " bytes\n";
+      continue;
+    }
+
+    cerr << "Failed to dequeue message: " << statusMessage(recvStatus) << "\n";
+    keepRunning.store(false, std::memory_order_release);
+    break;
+  }
+}
+
+#ifdef __linux__
+// Sleeps in epoll until the node signals new messages or shutdown is requested.
+// Returns false when the wait fd could not be set up
+bool epollReceive(
+  const CabiRustLibp2p& abi,
+  void* node,
+  std::atomic<bool>& keepRunning,
+  const StopSignal& stop,
+  std::vector<uint8_t>& buffer,
+  ReceiverStats& stats)
+{
+  int messageFd = -1;
+  const auto fdStatus = abi.GetWaitFd(node, CABI_WAIT_SOURCE_MESSAGES, &messageFd);
+  if (fdStatus != CABI_STATUS_SUCCESS || messageFd < 0 || stop.fd < 0)
+  {
+    cerr << "Message wait fd unavailable: " << statusMessage(fdStatus) << "\n";
+    return false;
+  }
+
+  const int epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0)
+  {
+    cerr << "epoll_create1 failed: " << std::strerror(errno) << "\n";
+    return false;
+  }
+
+  epoll_event messageEvent{};
+  messageEvent.events = EPOLLIN;
+  messageEvent.data.fd = messageFd;
+  epoll_event stopEvent{};
+  stopEvent.events = EPOLLIN;
+  stopEvent.data.fd = stop.fd;
+
+  if (epoll_ctl(epollFd, EPOLL_CTL_ADD, messageFd, &messageEvent) != 0 ||
+      epoll_ctl(epollFd, EPOLL_CTL_ADD, stop.fd, &stopEvent) != 0)
+  {
+    cerr << "epoll_ctl failed: " << std::strerror(errno) << "\n";
+    close(epollFd);
+    return false;
+  }
+
+  // Node events share the same wait; optional, since older libraries lack them
+  int nodeEventFd = -1;
+  if (abi.DequeueNodeEvent &&
+      abi.GetWaitFd(node, CABI_WAIT_SOURCE_NODE_EVENTS, &nodeEventFd) == CABI_STATUS_SUCCESS && nodeEventFd >= 0)
+  {
+    epoll_event nodeEvent{};
+    nodeEvent.events = EPOLLIN;
+    nodeEvent.data.fd = nodeEventFd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, nodeEventFd, &nodeEvent) != 0)
+    {
+      nodeEventFd = -1;
+    }
+    else
+    {
+      drainNodeEvents(abi, node);
+    }
+  }
+
+  // Messages queued before the fd was registered
+  if (!drainMessages(abi, node, buffer, stats))
+  {
+    keepRunning.store(false, std::memory_order_release);
+  }
+
+  std::array<epoll_event, 3> ready{};
+  while (keepRunning.load(std::memory_order_acquire))
+  {
+    const int count = epoll_wait(epollFd, ready.data(), static_cast<int>(ready.size()), -1);
+    if (count < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      cerr << "epoll_wait failed: " << std::strerror(errno) << "\n";
+      break;
+    }
+    ++stats.wakeups;
+
+    bool messagesReady = false;
+    bool eventsReady = false;
+    bool stopRequested = false;
+    for (int i = 0; i < count; ++i)
+    {
+      if (ready[i].data.fd == messageFd)
+      {
+        messagesReady = true;
+      }
+      else if (ready[i].data.fd == nodeEventFd)
+      {
+        eventsReady = true;
+      }
+      else
+      {
+        stopRequested = true;
+      }
+    }
+
+    if (stopRequested)
+    {
+      break;
+    }
+
+    if (eventsReady)
+    {
+      uint64_t counter = 0;
+      [[maybe_unused]] const auto ignored = read(nodeEventFd, &counter, sizeof(counter));
+      drainNodeEvents(abi, node);
+    }
+
+    if (!messagesReady)
+    {
+      continue;
+    }
+
+    // Reset the counter before draining so an enqueue racing
+    // with the drain re-arms the fd instead of being lost
+    uint64_t counter = 0;
+    [[maybe_unused]] const auto ignored = read(messageFd, &counter, sizeof(counter));
+
+    if (!drainMessages(abi, node, buffer, stats))
+    {
+      keepRunning.store(false, std::memory_order_release);
+      break;
+    }
+  }
+
+  close(epollFd);
+  return true;
+}
+#endif
+
+void recvLoop(
+  const CabiRustLibp2p& abi,
+  void* node,
+  RecvMode mode,
+  std::atomic<bool>& keepRunning,
+  const StopSignal& stop,
+  ReceiverStats& stats)
+{
+  // Batched dequeues share one arena across a whole burst
+  std::vector<uint8_t> buffer(abi.DequeueMessages ? 64 * 1024 : 1024);
+
+  if (mode != RecvMode::Poll)
+  {
+#ifdef __linux__
+    if (abi.GetWaitFd && epollReceive(abi, node, keepRunning, stop, buffer, stats))
+    {
+      return;
+    }
+#endif
+
+    if (abi.DequeueMessageTimeout)
+    {
+      timedReceive(abi, node, keepRunning, buffer, stats);
+      return;
+    }
+
+    if (mode == RecvMode::Wait)
+    {
+      cerr << "Library exports no wait ABI; --recv-mode wait is unavailable\n";
+      keepRunning.store(false, std::memory_order_release);
+      return;
+    }
+
+    cout << "Library exports no wait ABI; falling back to polling\n";
+  }
+
+  pollReceive(abi, node, keepRunning, buffer, stats);
+}
+
+void printReceiverStats(const ReceiverStats& stats)
+{
+  cout << "Receiver: " << stats.messages << " messages, " << stats.wakeups << " wakeups";
+  if (stats.probes > 0)
+  {
+    cout << ", probe latency avg " << (stats.probeTotalUs / stats.probes)
+         << " us max " << stats.probeMaxUs << " us over " << stats.probes << " probes";
+  }
+  cout << "\n";
+}
+
+void getAddrsSnapshot(
+  const CabiRustLibp2p& abi,
+  void* node)
+{
+  std::vector<char> buffer(256);
+  uint64_t version = 0;
+
+  while (true)
+  {
+    size_t written = 0;
+    const auto status = abi.GetAddrsSnapshot(
+      node,
+      &version,
+      buffer.data(),
+      buffer.size(),
+      &written);
+
+    if (status == CABI_STATUS_SUCCESS)
     {
       const string snapshot(buffer.data(), written);
       cout << "Addr snapshot v" << version << ":\n";
@@ -518,31 +1572,1129 @@ void getAddrsSnapshot(
       }
       else
       {
-        cout << snapshot << "\n";
+        cout << snapshot << "\n";
+      }
+      break;
+    }
+
+    if (status == CABI_STATUS_BUFFER_TOO_SMALL)
+    {
+      const auto newSize = std::max(buffer.size() * 2, written + 1);
+      buffer.resize(newSize);
+      continue;
+    }
+
+    cerr << "Failed to read addr snapshot: " << statusMessage(status) << "\n";
+    break;
+  }
+}
+
+// Payloads submitted per call by /sendfile when --send-batch is 1
+constexpr size_t DEFAULT_FILE_BATCH = 64;
+
+// Submits all payloads in one cabi_node_enqueue_messages call, or one
+// cabi_node_enqueue_message each on older libraries. Returns false if any failed
+bool enqueueBatch(
+  const CabiRustLibp2p& abi,
+  void* node,
+  const std::vector<string>& payloads)
+{
+  if (payloads.empty())
+  {
+    return true;
+  }
+
+  // Anything the library does not report on counts as not sent
+  std::vector<int> statuses(payloads.size(), CABI_STATUS_INTERNAL_ERROR);
+
+  if (abi.EnqueueMessages)
+  {
+    std::vector<CabiBuffer> buffers;
+    buffers.reserve(payloads.size());
+    for (const auto& payload : payloads)
+    {
+      buffers.push_back({reinterpret_cast<const uint8_t*>(payload.data()), payload.size()});
+    }
+
+    size_t accepted = 0;
+    const auto status = abi.EnqueueMessages(node, buffers.data(), buffers.size(), statuses.data(), &accepted);
+    if (status != CABI_STATUS_SUCCESS)
+    {
+      cerr << "Failed to send batch: " << statusMessage(status) << "\n";
+      return false;
+    }
+    // Statuses past the processed prefix were never enqueued, whatever they hold
+    for (size_t i = std::min(accepted, statuses.size()); i < statuses.size(); ++i)
+    {
+      statuses[i] = CABI_STATUS_INTERNAL_ERROR;
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < payloads.size(); ++i)
+    {
+      statuses[i] = abi.EnqueueMessage(
+        node,
+        reinterpret_cast<const uint8_t*>(payloads[i].data()),
+        payloads[i].size());
+    }
+  }
+
+  bool ok = true;
+  size_t rejected = 0;
+  for (size_t i = 0; i < statuses.size(); ++i)
+  {
+    // Backpressure from the overflow policy is reported, not fatal
+    if (statuses[i] == CABI_STATUS_QUEUE_FULL)
+    {
+      ++rejected;
+    }
+    else if (statuses[i] != CABI_STATUS_SUCCESS)
+    {
+      cerr << "Failed to send message #" << i << " of batch: " << statusMessage(statuses[i]) << "\n";
+      ok = false;
+    }
+  }
+  if (rejected > 0)
+  {
+    cerr << rejected << " of " << statuses.size() << " messages rejected: outbound queue full\n";
+  }
+
+  return ok;
+}
+
+// Sends every line of the file, batchSize payloads per call
+bool sendFile(
+  const CabiRustLibp2p& abi,
+  void* node,
+  const string& path,
+  size_t batchSize)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    cerr << "Failed to open " << path << "\n";
+    return true;
+  }
+
+  std::vector<string> batch;
+  batch.reserve(batchSize);
+  size_t sent = 0;
+  const auto start = std::chrono::steady_clock::now();
+
+  string line;
+  while (std::getline(file, line))
+  {
+    if (line.empty())
+    {
+      continue;
+    }
+
+    batch.push_back(std::move(line));
+    if (batch.size() == batchSize)
+    {
+      if (!enqueueBatch(abi, node, batch))
+      {
+        return false;
+      }
+      sent += batch.size();
+      batch.clear();
+    }
+  }
+
+  if (!enqueueBatch(abi, node, batch))
+  {
+    return false;
+  }
+  sent += batch.size();
+
+  const auto elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  cout << "Sent " << sent << " payloads from " << path << " in " << elapsedUs << " us\n";
+  return true;
+}
+
+void printQueueCounters(const char* name, const CabiQueueCounters& counters)
+{
+  cout << "  " << name << ": depth " << counters.depth << "/" << counters.capacity
+       << ", high-water " << counters.high_water
+       << ", enqueued " << counters.enqueued
+       << ", dropped " << counters.dropped
+       << ", blocked " << counters.blocked << "\n";
+}
+
+void printQueueStats(const CabiRustLibp2p& abi, void* node)
+{
+  if (!abi.QueueStats)
+  {
+    cout << "Queue stats: library does not export cabi_node_queue_stats\n";
+    return;
+  }
+
+  CabiQueueStats stats{};
+  stats.struct_size = sizeof(stats);
+  const int status = abi.QueueStats(node, &stats);
+  if (status != CABI_STATUS_SUCCESS)
+  {
+    cerr << "cabi_node_queue_stats failed: " << statusMessage(status) << "\n";
+    return;
+  }
+
+  cout << "Queue stats:\n";
+  printQueueCounters("inbound  ", stats.inbound);
+  printQueueCounters("outbound ", stats.outbound);
+  printQueueCounters("discovery", stats.discovery);
+}
+
+// One latency distribution from cabi_node_metrics_snapshot
+struct MetricHistogram
+{
+  string name;
+  uint64_t count = 0;
+  uint64_t sumUs = 0;
+  uint64_t minUs = 0;
+  uint64_t maxUs = 0;
+  // (upper bound in us, cumulative count), ascending
+  std::vector<std::pair<uint64_t, uint64_t>> buckets;
+
+  // Upper bound of the bucket holding the given percentile, capped at max
+  uint64_t percentileUs(double percentile) const
+  {
+    if (count == 0)
+    {
+      return 0;
+    }
+    const auto rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(count) + 0.5);
+    for (const auto& [upperUs, cumulative] : buckets)
+    {
+      if (cumulative >= std::max<uint64_t>(rank, 1))
+      {
+        return std::min(upperUs, maxUs);
+      }
+    }
+    return maxUs;
+  }
+};
+
+struct MetricsSnapshot
+{
+  std::vector<std::pair<string, uint64_t>> counters;
+  std::vector<std::pair<string, int64_t>> gauges;
+  std::vector<MetricHistogram> histograms;
+};
+
+// Raw snapshot text, or nothing when the library lacks the ABI or fails
+std::optional<string> readMetricsText(const CabiRustLibp2p& abi, void* node)
+{
+  if (!abi.MetricsSnapshot)
+  {
+    return std::nullopt;
+  }
+
+  // Reused across calls: /stats and the exporter poll this every second
+  thread_local std::vector<char> buffer(4096);
+  while (true)
+  {
+    size_t written = 0;
+    const auto status = abi.MetricsSnapshot(node, buffer.data(), buffer.size(), &written);
+    if (status == CABI_STATUS_SUCCESS)
+    {
+      return string(buffer.data(), std::min(written, buffer.size()));
+    }
+    if (status == CABI_STATUS_BUFFER_TOO_SMALL)
+    {
+      buffer.resize(std::max(buffer.size() * 2, written + 1));
+      continue;
+    }
+
+    cerr << "Failed to read metrics snapshot: " << statusMessage(status) << "\n";
+    return std::nullopt;
+  }
+}
+
+MetricsSnapshot parseMetrics(const string& text)
+{
+  MetricsSnapshot snapshot;
+  std::istringstream lines(text);
+  string line;
+  while (std::getline(lines, line))
+  {
+    std::istringstream fields(line);
+    string kind;
+    string name;
+    fields >> kind >> name;
+    if (kind == "counter")
+    {
+      uint64_t value = 0;
+      fields >> value;
+      snapshot.counters.emplace_back(name, value);
+    }
+    else if (kind == "gauge")
+    {
+      int64_t value = 0;
+      fields >> value;
+      snapshot.gauges.emplace_back(name, value);
+    }
+    else if (kind == "histogram")
+    {
+      MetricHistogram histogram;
+      histogram.name = name;
+      fields >> histogram.count >> histogram.sumUs >> histogram.minUs >> histogram.maxUs;
+      string bucket;
+      while (fields >> bucket)
+      {
+        const auto colon = bucket.find(':');
+        if (colon == string::npos)
+        {
+          continue;
+        }
+        histogram.buckets.emplace_back(
+          std::strtoull(bucket.c_str(), nullptr, 10),
+          std::strtoull(bucket.c_str() + colon + 1, nullptr, 10));
+      }
+      snapshot.histograms.push_back(std::move(histogram));
+    }
+    // Unknown record kinds are skipped so newer libraries stay readable
+  }
+  return snapshot;
+}
+
+void printMetrics(const CabiRustLibp2p& abi, void* node)
+{
+  const auto text = readMetricsText(abi, node);
+  if (!text)
+  {
+    if (!abi.MetricsSnapshot)
+    {
+      cout << "Metrics unavailable: library has no cabi_node_metrics_snapshot\n";
+    }
+    return;
+  }
+
+  const auto snapshot = parseMetrics(*text);
+  for (const auto& [name, value] : snapshot.counters)
+  {
+    cout << "  " << name << ": " << value << "\n";
+  }
+  for (const auto& [name, value] : snapshot.gauges)
+  {
+    cout << "  " << name << ": " << value << "\n";
+  }
+  if (!snapshot.histograms.empty())
+  {
+    cout << "  latency (us)       count      mean       p50       p90       p99      p999       max\n";
+  }
+  for (const auto& histogram : snapshot.histograms)
+  {
+    const auto mean = histogram.count > 0 ? histogram.sumUs / histogram.count : 0;
+    cout << "  " << std::left << std::setw(16) << histogram.name << std::right
+         << std::setw(8) << histogram.count
+         << std::setw(10) << mean
+         << std::setw(10) << histogram.percentileUs(50)
+         << std::setw(10) << histogram.percentileUs(90)
+         << std::setw(10) << histogram.percentileUs(99)
+         << std::setw(10) << histogram.percentileUs(99.9)
+         << std::setw(10) << histogram.maxUs << "\n";
+  }
+}
+
+// Prometheus text exposition of the node's metrics snapshot, queue stats and
+// AutoNAT state
+string renderPrometheus(const CabiRustLibp2p& abi, void* node)
+{
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(6);
+
+  const auto autonat = abi.AutonatStatus(node);
+  out << "# HELP fidonext_autonat_status AutoNAT reachability (0 unknown, 1 private, 2 public)\n"
+      << "# TYPE fidonext_autonat_status gauge\n"
+      << "fidonext_autonat_status " << autonat << "\n";
+
+  if (abi.QueueStats)
+  {
+    CabiQueueStats stats{};
+    stats.struct_size = sizeof(stats);
+    if (abi.QueueStats(node, &stats) == CABI_STATUS_SUCCESS)
+    {
+      const std::pair<const char*, const CabiQueueCounters*> queues[] = {
+        { "inbound", &stats.inbound },
+        { "outbound", &stats.outbound },
+        { "discovery", &stats.discovery },
+      };
+      out << "# TYPE fidonext_queue_depth gauge\n";
+      for (const auto& [name, counters] : queues)
+      {
+        out << "fidonext_queue_depth{queue=\"" << name << "\"} " << counters->depth << "\n";
+      }
+      out << "# TYPE fidonext_queue_capacity gauge\n";
+      for (const auto& [name, counters] : queues)
+      {
+        out << "fidonext_queue_capacity{queue=\"" << name << "\"} " << counters->capacity << "\n";
+      }
+      out << "# TYPE fidonext_queue_dropped_total counter\n";
+      for (const auto& [name, counters] : queues)
+      {
+        out << "fidonext_queue_dropped_total{queue=\"" << name << "\"} " << counters->dropped << "\n";
+      }
+    }
+  }
+
+  const auto text = readMetricsText(abi, node);
+  if (!text)
+  {
+    return out.str();
+  }
+
+  const auto snapshot = parseMetrics(*text);
+  for (const auto& [name, value] : snapshot.counters)
+  {
+    out << "# TYPE fidonext_" << name << "_total counter\n"
+        << "fidonext_" << name << "_total " << value << "\n";
+  }
+  for (const auto& [name, value] : snapshot.gauges)
+  {
+    out << "# TYPE fidonext_" << name << " gauge\n"
+        << "fidonext_" << name << " " << value << "\n";
+  }
+  for (const auto& histogram : snapshot.histograms)
+  {
+    const auto metric = "fidonext_" + histogram.name + "_seconds";
+    out << "# TYPE " << metric << " histogram\n";
+    for (const auto& [upperUs, cumulative] : histogram.buckets)
+    {
+      out << metric << "_bucket{le=\"" << upperUs / 1e6 << "\"} " << cumulative << "\n";
+    }
+    out << metric << "_bucket{le=\"+Inf\"} " << histogram.count << "\n"
+        << metric << "_sum " << histogram.sumUs / 1e6 << "\n"
+        << metric << "_count " << histogram.count << "\n";
+  }
+  return out.str();
+}
+
+// Serves /metrics on a loopback port from its own thread. The page is rendered
+// once a second from atomics-only snapshots and scrapes get the cached copy,
+// so a slow or hostile scraper never reaches the node.
+class MetricsExporter
+{
+public:
+  ~MetricsExporter()
+  {
+    stop();
+  }
+
+  void start(const CabiRustLibp2p& abi, void* node, uint16_t port)
+  {
+#ifdef __linux__
+    listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0)
+    {
+      throw std::runtime_error("metrics exporter: socket() failed: " + string(std::strerror(errno)));
+    }
+    const int reuse = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listenFd_, 8) != 0)
+    {
+      const string error = std::strerror(errno);
+      close(listenFd_);
+      listenFd_ = -1;
+      throw std::runtime_error("metrics exporter: cannot listen on 127.0.0.1:" + std::to_string(port) + ": " + error);
+    }
+
+    running_.store(true, std::memory_order_release);
+    worker_ = std::thread(&MetricsExporter::serve, this, std::cref(abi), node);
+    cout << "Serving Prometheus metrics on http://127.0.0.1:" << port << "/metrics\n";
+#else
+    (void)abi;
+    (void)node;
+    (void)port;
+    cerr << "Metrics exporter is only available on Linux\n";
+#endif
+  }
+
+  // Joins the worker; call before the node is freed
+  void stop()
+  {
+    running_.store(false, std::memory_order_release);
+    if (worker_.joinable())
+    {
+      worker_.join();
+    }
+#ifdef __linux__
+    if (listenFd_ >= 0)
+    {
+      close(listenFd_);
+      listenFd_ = -1;
+    }
+#endif
+  }
+
+private:
+#ifdef __linux__
+  void serve(const CabiRustLibp2p& abi, void* node)
+  {
+    string page = renderPrometheus(abi, node);
+    auto renderedAt = std::chrono::steady_clock::now();
+
+    while (running_.load(std::memory_order_acquire))
+    {
+      if (std::chrono::steady_clock::now() - renderedAt >= std::chrono::seconds(1))
+      {
+        page = renderPrometheus(abi, node);
+        renderedAt = std::chrono::steady_clock::now();
+      }
+
+      pollfd pfd{ listenFd_, POLLIN, 0 };
+      if (poll(&pfd, 1, 250) <= 0)
+      {
+        continue;
+      }
+
+      const int client = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client < 0)
+      {
+        continue;
+      }
+      respond(client, page);
+      close(client);
+    }
+  }
+
+  static void respond(int client, const string& page)
+  {
+    // Only the request line matters; give the scraper 1 s to send it
+    timeval timeout{ 1, 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char request[1024];
+    const auto received = recv(client, request, sizeof(request) - 1, 0);
+    if (received <= 0)
+    {
+      return;
+    }
+    request[received] = '\0';
+
+    const bool isMetrics = std::strncmp(request, "GET /metrics ", 13) == 0 ||
+                           std::strncmp(request, "GET / ", 6) == 0;
+    const string body = isMetrics ? page : string("not found\n");
+    const string response =
+      string(isMetrics ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n") +
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: " + std::to_string(body.size()) + "\r\n"
+      "Connection: close\r\n\r\n" + body;
+
+    size_t sent = 0;
+    while (sent < response.size())
+    {
+      const auto n = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0)
+      {
+        return;
+      }
+      sent += static_cast<size_t>(n);
+    }
+  }
+
+  int listenFd_ = -1;
+#endif
+  std::atomic<bool> running_{ false };
+  std::thread worker_;
+};
+
+// Drains the DHT result queue until every id in `outstanding` has finished or
+// the deadline passes. Returns how many succeeded (and, for gets, matched
+// `expected`).
+size_t collectDhtResults(
+  const CabiRustLibp2p& abi,
+  void* node,
+  std::vector<uint64_t> outstanding,
+  const string& expected,
+  std::chrono::steady_clock::time_point deadline)
+{
+  std::vector<uint8_t> value(expected.size() + 1024);
+  size_t ok = 0;
+  while (!outstanding.empty() && std::chrono::steady_clock::now() < deadline)
+  {
+    uint64_t requestId = 0;
+    int opKind = 0;
+    int opStatus = 0;
+    size_t written = 0;
+    const auto status = abi.DequeueDhtResult(
+      node, 100, &requestId, &opKind, &opStatus, value.data(), value.size(), &written);
+    if (status == CABI_STATUS_BUFFER_TOO_SMALL)
+    {
+      value.resize(std::max(value.size() * 2, written));
+      continue;
+    }
+    if (status != CABI_STATUS_SUCCESS)
+    {
+      continue;
+    }
+
+    const auto it = std::find(outstanding.begin(), outstanding.end(), requestId);
+    if (it == outstanding.end())
+    {
+      continue;
+    }
+    outstanding.erase(it);
+    const bool matches = opKind != CABI_DHT_OP_GET ||
+                         string(reinterpret_cast<const char*>(value.data()), written) == expected;
+    if (opStatus == CABI_STATUS_SUCCESS && matches)
+    {
+      ++ok;
+    }
+  }
+  return ok;
+}
+
+// Times `count` DHT puts and then gets of the same keys, first one blocking
+// call at a time, then all started together through the async ABI and
+// collected from the DHT result queue. Between the two, the same number of
+// puts goes through one multi-put call when the library has it.
+void dhtBench(const CabiRustLibp2p& abi, void* node, size_t count)
+{
+  if (!abi.DhtPutRecord || !abi.DhtGetRecord)
+  {
+    cout << "DHT bench: library does not export cabi_node_dht_put_record/get_record\n";
+    return;
+  }
+
+  // Report here: an exception leaving sendLoop would hit the joinable receiver thread
+  string self;
+  try
+  {
+    self = readPeerId(abi, node);
+  }
+  catch (const std::exception& ex)
+  {
+    cerr << "DHT bench: " << ex.what() << "\n";
+    return;
+  }
+
+  const auto prefix = "ping/dhtbench/" + self + "/" + std::to_string(steadyNowNs()) + "/";
+  const string value(64, 'v');
+  const auto keyFor = [&](const char* run, size_t i) { return prefix + run + "/" + std::to_string(i); };
+  const auto elapsedMs = [](std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+  };
+  const auto asBytes = [](const string& text) { return reinterpret_cast<const uint8_t*>(text.data()); };
+
+  // Step 1. One blocking call per record
+  auto started = std::chrono::steady_clock::now();
+  size_t putOk = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const auto key = keyFor("seq", i);
+    if (abi.DhtPutRecord(node, asBytes(key), key.size(), asBytes(value), value.size(), 60) == CABI_STATUS_SUCCESS)
+    {
+      ++putOk;
+    }
+  }
+  const auto seqPutMs = elapsedMs(started);
+
+  started = std::chrono::steady_clock::now();
+  size_t getOk = 0;
+  std::vector<uint8_t> out(value.size() + 1024);
+  for (size_t i = 0; i < count; ++i)
+  {
+    const auto key = keyFor("seq", i);
+    size_t written = 0;
+    if (abi.DhtGetRecord(node, asBytes(key), key.size(), out.data(), out.size(), &written) == CABI_STATUS_SUCCESS &&
+        string(reinterpret_cast<const char*>(out.data()), written) == value)
+    {
+      ++getOk;
+    }
+  }
+  const auto seqGetMs = elapsedMs(started);
+  cout << "sequential: put " << putOk << "/" << count << " in " << seqPutMs << " ms, get "
+       << getOk << "/" << count << " in " << seqGetMs << " ms\n";
+
+  // Step 2. One multi-put call for the whole batch
+  if (abi.DhtPutRecords)
+  {
+    std::vector<string> keys;
+    std::vector<CabiDhtRecord> records;
+    for (size_t i = 0; i < count; ++i)
+    {
+      keys.push_back(keyFor("multi", i));
+    }
+    for (const auto& key : keys)
+    {
+      records.push_back({ asBytes(key), key.size(), asBytes(value), value.size(), 60 });
+    }
+    std::vector<int> statuses(count, CABI_STATUS_INTERNAL_ERROR);
+    started = std::chrono::steady_clock::now();
+    const auto status = abi.DhtPutRecords(node, records.data(), records.size(), statuses.data());
+    const auto multiPutMs = elapsedMs(started);
+    if (status != CABI_STATUS_SUCCESS)
+    {
+      cout << "multi-put: " << statusMessage(status) << "\n";
+    }
+    else
+    {
+      putOk = static_cast<size_t>(std::count(statuses.begin(), statuses.end(), CABI_STATUS_SUCCESS));
+      cout << "multi-put:  put " << putOk << "/" << count << " in " << multiPutMs << " ms\n";
+    }
+  }
+  else
+  {
+    cout << "multi-put: library does not export cabi_node_dht_put_records\n";
+  }
+
+  if (!abi.DhtPutRecordAsync || !abi.DhtGetRecordAsync || !abi.DequeueDhtResult)
+  {
+    cout << "pipelined: library does not export the async DHT ABI\n";
+    return;
+  }
+
+  // Step 3. Every query in flight at once
+  const auto deadlineFrom = [](std::chrono::steady_clock::time_point start) { return start + std::chrono::seconds(60); };
+  started = std::chrono::steady_clock::now();
+  std::vector<uint64_t> ids;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const auto key = keyFor("async", i);
+    uint64_t requestId = 0;
+    if (abi.DhtPutRecordAsync(node, asBytes(key), key.size(), asBytes(value), value.size(), 60, &requestId) == CABI_STATUS_SUCCESS)
+    {
+      ids.push_back(requestId);
+    }
+  }
+  putOk = collectDhtResults(abi, node, ids, value, deadlineFrom(started));
+  const auto asyncPutMs = elapsedMs(started);
+
+  started = std::chrono::steady_clock::now();
+  ids.clear();
+  for (size_t i = 0; i < count; ++i)
+  {
+    const auto key = keyFor("async", i);
+    uint64_t requestId = 0;
+    if (abi.DhtGetRecordAsync(node, asBytes(key), key.size(), &requestId) == CABI_STATUS_SUCCESS)
+    {
+      ids.push_back(requestId);
+    }
+  }
+  getOk = collectDhtResults(abi, node, ids, value, deadlineFrom(started));
+  const auto asyncGetMs = elapsedMs(started);
+  cout << "pipelined:  put " << putOk << "/" << count << " in " << asyncPutMs << " ms, get "
+       << getOk << "/" << count << " in " << asyncGetMs << " ms\n";
+}
+
+// PeerId after the last /p2p/ of a multiaddr, empty when there is none
+string peerIdOfMultiaddr(const string& multiaddr)
+{
+  const auto pos = multiaddr.rfind("/p2p/");
+  if (pos == string::npos)
+  {
+    return {};
+  }
+  const auto start = pos + std::strlen("/p2p/");
+  return multiaddr.substr(start, multiaddr.find('/', start) - start);
+}
+
+const char* transportName(int transport)
+{
+  switch (transport)
+  {
+  case CABI_TRANSPORT_EXISTING:
+    return "existing connection";
+  case CABI_TRANSPORT_TCP:
+    return "tcp";
+  case CABI_TRANSPORT_QUIC:
+    return "quic";
+  case CABI_TRANSPORT_RELAY:
+    return "relay";
+  default:
+    return "unknown";
+  }
+}
+
+// Same classification the library uses for its race order
+int transportOfMultiaddr(const string& multiaddr)
+{
+  if (multiaddr.find("/p2p-circuit") != string::npos)
+  {
+    return CABI_TRANSPORT_RELAY;
+  }
+  if (multiaddr.find("/quic") != string::npos)
+  {
+    return CABI_TRANSPORT_QUIC;
+  }
+  return CABI_TRANSPORT_TCP;
+}
+
+// One connection to peerId over the best of addrs. Without cabi_node_dial_peer
+// every address is dialed as before; cabi_node_dial only starts a dial, so
+// neither the winner nor the time to connect is known.
+bool dialPeer(const CabiRustLibp2p& abi, void* node, const string& peerId, const std::vector<string>& addrs,
+  const char* label)
+{
+  if (abi.DialPeer)
+  {
+    std::vector<const char*> addrPtrs;
+    addrPtrs.reserve(addrs.size());
+    for (const auto& addr : addrs)
+    {
+      addrPtrs.push_back(addr.c_str());
+    }
+
+    int transport = CABI_TRANSPORT_EXISTING;
+    uint64_t connectUs = 0;
+    std::array<char, 1024> winner{};
+    size_t winnerLen = 0;
+    const auto status = abi.DialPeer(node, peerId.c_str(), addrPtrs.data(), addrPtrs.size(),
+      DEFAULT_DIAL_TIMEOUT_MS, &transport, &connectUs, winner.data(), winner.size(), &winnerLen);
+    if (status != CABI_STATUS_SUCCESS)
+    {
+      cerr << "Failed to dial " << label << " peer " << peerId << " (" << addrs.size() << " addresses) : "
+           << statusMessage(status) << "\n";
+      return false;
+    }
+    cout << "Dialed " << label << " peer " << peerId << " via " << transportName(transport);
+    if (transport != CABI_TRANSPORT_EXISTING)
+    {
+      cout << " in " << connectUs << " us: " << string(winner.data(), std::min(winnerLen, winner.size()));
+    }
+    cout << "\n";
+    return true;
+  }
+
+  bool started = false;
+  for (const auto& addr : addrs)
+  {
+    const auto status = abi.DialNode(node, addr.c_str());
+    if (status == CABI_STATUS_SUCCESS)
+    {
+      cout << "Dialed " << label << " peer: " << addr << " (" << transportName(transportOfMultiaddr(addr)) << ")\n";
+      started = true;
+    }
+    else
+    {
+      cerr << "Failed to dial " << label << " peer " << addr << " : " << statusMessage(status) << "\n";
+    }
+  }
+  return started;
+}
+
+// Initital dial to know that peer is enabled. Addresses of the same peer are
+// dialed together, so a peer listed with several addresses gets one connection.
+void dialPeers(const CabiRustLibp2p& abi, void* node, const std::vector<string>& peers, const char* label)
+{
+  std::vector<std::pair<string, std::vector<string>>> byPeer;
+  for (const auto& addr : peers)
+  {
+    const auto peerId = peerIdOfMultiaddr(addr);
+    auto it = std::find_if(byPeer.begin(), byPeer.end(), [&](const auto& entry) {
+      return !peerId.empty() && entry.first == peerId;
+    });
+    if (it == byPeer.end())
+    {
+      byPeer.emplace_back(peerId, std::vector<string>{addr});
+    }
+    else
+    {
+      it->second.push_back(addr);
+    }
+  }
+
+  for (const auto& [peerId, addrs] : byPeer)
+  {
+    if (peerId.empty())
+    {
+      // Without /p2p/ there is no peer to deduplicate against
+      const auto status = abi.DialNode(node, addrs.front().c_str());
+      if (status == CABI_STATUS_SUCCESS)
+      {
+        cout << "Dialed " << label << " peer: " << addrs.front() << "\n";
+      }
+      else
+      {
+        cerr << "Failed to dial " << label << " peer " << addrs.front() << " : " << statusMessage(status) << "\n";
+      }
+      continue;
+    }
+    dialPeer(abi, node, peerId, addrs, label);
+  }
+}
+
+struct DiscoveryEvent
+{
+  int kind = 0;
+  uint64_t requestId = 0;
+  int status = 0;
+  string peerId;
+  string address;
+};
+
+// Waits for the next discovery event of any request until `deadline`: in
+// native when the library can block, otherwise by polling every 20 ms
+bool nextDiscoveryEvent(
+  const CabiRustLibp2p& abi,
+  void* node,
+  std::chrono::steady_clock::time_point deadline,
+  DiscoveryEvent& event)
+{
+  std::array<char, 256> peerId{};
+  std::array<char, 1024> address{};
+  for (auto now = std::chrono::steady_clock::now(); now < deadline; now = std::chrono::steady_clock::now())
+  {
+    size_t peerIdLen = 0;
+    size_t addressLen = 0;
+    int status = CABI_STATUS_QUEUE_EMPTY;
+    if (abi.DequeueDiscoveryEventTimeout)
+    {
+      const auto waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+      status = abi.DequeueDiscoveryEventTimeout(
+        node, static_cast<uint64_t>(std::min<int64_t>(waitMs, 200)), &event.kind, &event.requestId, &event.status,
+        peerId.data(), peerId.size(), &peerIdLen, address.data(), address.size(), &addressLen);
+    }
+    else
+    {
+      status = abi.DequeueDiscoveryEvent(
+        node, &event.kind, &event.requestId, &event.status,
+        peerId.data(), peerId.size(), &peerIdLen, address.data(), address.size(), &addressLen);
+      if (status == CABI_STATUS_QUEUE_EMPTY)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      }
+    }
+    if (status == CABI_STATUS_SUCCESS)
+    {
+      event.peerId.assign(peerId.data(), std::min(peerIdLen, peerId.size()));
+      event.address.assign(address.data(), std::min(addressLen, address.size()));
+      return true;
+    }
+  }
+  return false;
+}
+
+// Finds the peers closest to this node and to every bootstrap peer, printing
+// each new PeerId as soon as it arrives. Uses the native aggregate when the
+// library has it; otherwise starts one get_closest_peers per target and
+// merges their events under the same single deadline.
+void discoverPeers(
+  const CabiRustLibp2p& abi,
+  void* node,
+  const std::vector<string>& bootstrapPeers,
+  uint64_t timeoutMs)
+{
+  if (!abi.DequeueDiscoveryEvent || (!abi.DiscoverNeighborhood && !abi.GetClosestPeers))
+  {
+    cout << "Peer discovery: library does not export the discovery ABI\n";
+    return;
+  }
+
+  // Report here: an exception leaving sendLoop would hit the joinable receiver thread
+  string self;
+  try
+  {
+    self = readPeerId(abi, node);
+  }
+  catch (const std::exception& ex)
+  {
+    cerr << "Peer discovery: " << ex.what() << "\n";
+    return;
+  }
+
+  std::vector<string> targets{ self };
+  for (const auto& multiaddr : bootstrapPeers)
+  {
+    const auto peerId = peerIdOfMultiaddr(multiaddr);
+    if (!peerId.empty() && std::find(targets.begin(), targets.end(), peerId) == targets.end())
+    {
+      targets.push_back(peerId);
+    }
+  }
+
+  const auto started = std::chrono::steady_clock::now();
+  const auto deadline = started + std::chrono::milliseconds(timeoutMs);
+  std::vector<uint64_t> outstanding;
+  if (abi.DiscoverNeighborhood)
+  {
+    const auto targetPtrs = toCStrVector(targets);
+    uint64_t requestId = 0;
+    const auto status = abi.DiscoverNeighborhood(node, targetPtrs.data(), targetPtrs.size(), timeoutMs, &requestId);
+    if (status != CABI_STATUS_SUCCESS)
+    {
+      cout << "Peer discovery failed: " << statusMessage(status) << "\n";
+      return;
+    }
+    outstanding.push_back(requestId);
+  }
+  else
+  {
+    for (const auto& target : targets)
+    {
+      uint64_t requestId = 0;
+      if (abi.GetClosestPeers(node, target.c_str(), &requestId) == CABI_STATUS_SUCCESS)
+      {
+        outstanding.push_back(requestId);
       }
+    }
+  }
+  cout << "Discovering peers near " << targets.size() << " target(s)"
+       << (abi.DiscoverNeighborhood ? "" : " (one query per target)") << "...\n";
+
+  std::unordered_set<string> seen;
+  bool timedOut = false;
+  DiscoveryEvent event;
+  while (!outstanding.empty())
+  {
+    if (!nextDiscoveryEvent(abi, node, deadline, event))
+    {
+      timedOut = true;
       break;
     }
 
-    if (status == CABI_STATUS_BUFFER_TOO_SMALL)
+    const auto it = std::find(outstanding.begin(), outstanding.end(), event.requestId);
+    if (it == outstanding.end())
     {
-      const auto newSize = std::max(buffer.size() * 2, written + 1);
-      buffer.resize(newSize);
+      continue;
+    }
+    if (event.kind == CABI_DISCOVERY_EVENT_FINISHED)
+    {
+      timedOut = timedOut || event.status == CABI_STATUS_TIMEOUT;
+      outstanding.erase(it);
       continue;
     }
 
-    cerr << "Failed to read addr snapshot: " << statusMessage(status) << "\n";
-    break;
+    if (event.peerId.empty() || event.peerId == self || !seen.insert(event.peerId).second)
+    {
+      continue;
+    }
+    const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    cout << "  [" << std::fixed << std::setprecision(0) << elapsed << " ms] " << event.peerId;
+    if (!event.address.empty())
+    {
+      cout << " " << event.address;
+    }
+    cout << "\n" << std::defaultfloat << std::setprecision(6);
+  }
+
+  const auto totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+  cout << "Found " << seen.size() << " peer(s) in " << std::fixed << std::setprecision(0) << totalMs << " ms"
+       << (timedOut ? " (deadline reached)" : "") << "\n" << std::defaultfloat << std::setprecision(6);
+}
+
+// Merges a saved routing table/address book into the node; a missing file is
+// the normal first start and not an error
+void loadPeerStore(const CabiRustLibp2p& abi, void* node, const string& path)
+{
+  if (!abi.LoadPeerStore)
+  {
+    cerr << "Library has no cabi_node_load_peer_store; starting cold\n";
+    return;
+  }
+  size_t peers = 0;
+  const auto status = abi.LoadPeerStore(node, path.c_str(), &peers);
+  if (status == CABI_STATUS_SUCCESS)
+  {
+    cout << "Loaded " << peers << " peers from " << path << "\n";
+  }
+  else if (status == CABI_STATUS_NOT_FOUND)
+  {
+    cout << "No peer store at " << path << " yet; starting cold\n";
+  }
+  else
+  {
+    cerr << "Failed to load peer store " << path << ": " << statusMessage(status) << "\n";
   }
 }
 
+bool savePeerStore(const CabiRustLibp2p& abi, void* node, const string& path, bool verbose)
+{
+  if (!abi.SavePeerStore)
+  {
+    return false;
+  }
+  size_t peers = 0;
+  const auto status = abi.SavePeerStore(node, path.c_str(), &peers);
+  if (status != CABI_STATUS_SUCCESS)
+  {
+    cerr << "Failed to save peer store " << path << ": " << statusMessage(status) << "\n";
+    return false;
+  }
+  if (verbose)
+  {
+    cout << "Saved " << peers << " peers to " << path << "\n";
+  }
+  return true;
+}
+
+// Saves the peer store every `interval` on its own thread so a crash loses at
+// most one interval of routing state. stop() before the node is freed.
+class PeerStoreSaver
+{
+public:
+  ~PeerStoreSaver()
+  {
+    stop();
+  }
+
+  void start(const CabiRustLibp2p& abi, void* node, string path, std::chrono::seconds interval)
+  {
+    if (!abi.SavePeerStore)
+    {
+      cerr << "Library has no cabi_node_save_peer_store; the peer store is not written\n";
+      return;
+    }
+    running_ = true;
+    thread_ = std::thread([this, &abi, node, path = std::move(path), interval] {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (!wake_.wait_for(lock, interval, [this] { return !running_; }))
+      {
+        savePeerStore(abi, node, path, false);
+      }
+    });
+  }
+
+  void stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_ = false;
+    }
+    wake_.notify_all();
+    if (thread_.joinable())
+    {
+      thread_.join();
+    }
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool running_ = false;
+  std::thread thread_;
+};
+
 void sendLoop(
   const CabiRustLibp2p& abi,
   void* node,
+  const std::vector<string>& bootstrapPeers,
+  size_t sendBatch,
   std::atomic<bool>& keepRunning)
 {
   cout << "Enter payload (empty line or /quit to exit):\n";
   cout << "Enter /addrs to read your address snapshot\n";
+  cout << "Enter /probe [count] to send latency probes\n";
+  cout << "Enter /sendfile <path> to send each line of a file\n";
+  cout << "Enter /queues to print queue depth, drops and high-water marks\n";
+  cout << "Enter /stats to print node counters and latency percentiles\n";
+  cout << "Enter /dhtbench [count] to time sequential, multi-put and pipelined DHT put/get\n";
+  cout << "Enter /peers [timeout_ms] to discover peers near this node and its bootstrap peers\n";
+  cout << "Enter /hop on|off to toggle relay hop in place\n";
+  cout << "Enter /events to print pending node events\n";
+  cout << "Enter /dial <multiaddr>... to connect to a peer over the fastest address\n";
   string line;
+  uint64_t probeSeq = 0;
+
+  // Typed payloads waiting for a full --send-batch
+  std::vector<string> pending;
+  pending.reserve(sendBatch);
 
   while (keepRunning.load(std::memory_order_acquire) && std::getline(std::cin, line))
   {
@@ -559,55 +2711,375 @@ void sendLoop(
       getAddrsSnapshot(abi, node);
     }
 
-    // This one sends the payloads
-    const auto sendStatus = abi.EnqueueMessage(
-      node,
-      reinterpret_cast<const uint8_t*>(line.data()),
-      line.size());
+    // DHT scenario: blocking vs pipelined put/get round trips
+    if (line.rfind("/dhtbench", 0) == 0)
+    {
+      const auto count = std::strtoul(line.c_str() + std::strlen("/dhtbench"), nullptr, 10);
+      dhtBench(abi, node, count > 0 ? count : 16);
+      cout << "Enter payload (empty line or /quit to exit):\n";
+      continue;
+    }
+
+    // Discovery scenario: closest peers to us and to every bootstrap peer
+    if (line.rfind("/peers", 0) == 0)
+    {
+      const auto timeoutMs = std::strtoull(line.c_str() + std::strlen("/peers"), nullptr, 10);
+      discoverPeers(abi, node, bootstrapPeers, timeoutMs > 0 ? timeoutMs : 15000);
+      cout << "Enter payload (empty line or /quit to exit):\n";
+      continue;
+    }
+
+    // Events scenario: pending node events, for receive modes without the event fd
+    if (line == "/events")
+    {
+      if (!abi.DequeueNodeEvent)
+      {
+        cout << "Library does not export cabi_node_dequeue_node_event\n";
+      }
+      else
+      {
+        drainNodeEvents(abi, node);
+      }
+      cout << "Enter payload (empty line or /quit to exit):\n";
+      continue;
+    }
+
+    // Dial scenario: one connection to the peer of the given addresses
+    if (line.rfind("/dial ", 0) == 0)
+    {
+      std::vector<string> addrs;
+      std::istringstream words(line.substr(std::strlen("/dial ")));
+      for (string addr; words >> addr;)
+      {
+        addrs.push_back(addr);
+      }
+      dialPeers(abi, node, addrs, "requested");
+      cout << "Enter payload (empty line or /quit to exit):\n";
+      continue;
+    }
+
+    // Relay scenario: toggle hop without restarting the node
+    if (line == "/hop on" || line == "/hop off")
+    {
+      if (!abi.SetRelayHop)
+      {
+        cout << "Library does not export cabi_node_set_relay_hop\n";
+      }
+      else
+      {
+        setRelayHop(abi, node, line == "/hop on");
+      }
+      cout << "Enter payload (empty line or /quit to exit):\n";
+      continue;
+    }
+
+    // Metrics scenario
+    if (line == "/stats")
+    {
+      printMetrics(abi, node);
+      cout << "Enter payload (empty line or /quit to exit):\n";
+      continue;
+    }
+
+    // Queue counters scenario
+    if (line == "/queues")
+    {
+      printQueueStats(abi, node);
+      cout << "Enter payload (empty line or /quit to exit):\n";
+      continue;
+    }
+
+    // Probe scenario: timestamped payloads for the receiver's latency stats
+    if (line.rfind("/probe", 0) == 0)
+    {
+      const auto count = std::max(1ul, std::strtoul(line.c_str() + std::strlen("/probe"), nullptr, 10));
+      unsigned long rejected = 0;
+      for (unsigned long i = 0; i < count; ++i)
+      {
+        const auto probe = PROBE_PREFIX + std::to_string(steadyNowNs()) + ":" + std::to_string(++probeSeq);
+        const auto probeStatus = abi.EnqueueMessage(
+          node,
+          reinterpret_cast<const uint8_t*>(probe.data()),
+          probe.size());
+        if (probeStatus == CABI_STATUS_QUEUE_FULL)
+        {
+          ++rejected;
+          continue;
+        }
+        if (probeStatus != CABI_STATUS_SUCCESS)
+        {
+          cerr << "Failed to send probe: " << statusMessage(probeStatus) << "\n";
+          break;
+        }
+      }
+      if (rejected > 0)
+      {
+        cerr << rejected << " of " << count << " probes rejected: outbound queue full\n";
+      }
+      cout << "Enter payload (empty line or /quit to exit):\n";
+      continue;
+    }
+
+    // File scenario
+    if (line.rfind("/sendfile ", 0) == 0)
+    {
+      const auto path = line.substr(std::strlen("/sendfile "));
+      if (!sendFile(abi, node, path, sendBatch > 1 ? sendBatch : DEFAULT_FILE_BATCH))
+      {
+        keepRunning.store(false, std::memory_order_release);
+        break;
+      }
+      cout << "Enter payload (empty line or /quit to exit):\n";
+      continue;
+    }
+
+    // This one sends the payloads, once a full batch is collected
+    pending.push_back(line);
+    if (pending.size() < sendBatch)
+    {
+      continue;
+    }
+
+    const bool sent = enqueueBatch(abi, node, pending);
+    pending.clear();
 
     // Quit of failing sending message
-    if (sendStatus != CABI_STATUS_SUCCESS)
+    if (!sent)
     {
-      cerr << "Failed to send message: " << statusMessage(sendStatus) << "\n";
       keepRunning.store(false, std::memory_order_release);
       break;
     }
 
     cout << "Enter payload (empty line or /quit to exit):\n";
   }
+
+  // Partial batch left at quit or end of input
+  enqueueBatch(abi, node, pending);
 }
 
-// Initital dial to know that peer is enabled
-void dialPeers(const CabiRustLibp2p& abi, void* node, const std::vector<string>& peers, const char* label)
+void reserveOnRelays(const CabiRustLibp2p& abi, void* node, const std::vector<string>& peers)
 {
   for (const auto& addr : peers)
   {
-    const auto status = abi.DialNode(node, addr.c_str());
+    const auto status = abi.ReserveRelay(node, addr.c_str());
+
     if (status == CABI_STATUS_SUCCESS)
     {
-      cout << "Dialed " << label << " peer: " << addr << "\n";
+      cout << "Reserved relay on " << addr << "\n";
     }
     else
     {
-      cerr << "Failed to dial " << label << " peer " << addr << " : " << statusMessage(status) << "\n";
+      cerr << "Failed to reserve relay on " << addr << " : " << statusMessage(status) << "\n";
     }
   }
 }
 
-void reserveOnRelays(const CabiRustLibp2p& abi, void* node, const std::vector<string>& peers)
+// Threads and resident memory of this process; zero where unavailable
+struct ProcessUsage
 {
-  for (const auto& addr : peers)
+  long long threads = 0;
+  long long rssKb = 0;
+};
+
+ProcessUsage readProcessUsage()
+{
+  ProcessUsage usage;
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  string line;
+  while (std::getline(status, line))
   {
-    const auto status = abi.ReserveRelay(node, addr.c_str());
+    std::istringstream fields(line);
+    string key;
+    fields >> key;
+    if (key == "Threads:")
+    {
+      fields >> usage.threads;
+    }
+    else if (key == "VmRSS:")
+    {
+      fields >> usage.rssKb;
+    }
+  }
+#endif
+  return usage;
+}
 
-    if (status == CABI_STATUS_SUCCESS)
+void printUsage(const char* label, const ProcessUsage& usage)
+{
+  cout << label << ": " << usage.threads << " threads, " << usage.rssKb << " KiB RSS\n";
+}
+
+// Starts args.nodeCount nodes on one shared runtime and reports what each node
+// costs in threads and memory. Runs until /quit or end of input.
+void runFleet(const CabiRustLibp2p& abi, const Arguments& args)
+{
+  const auto baseline = readProcessUsage();
+  printUsage("Baseline", baseline);
+
+  RuntimeHandle runtime;
+  runtime.abi = &abi;
+  if (abi.NewRuntime && abi.FreeRuntime && abi.NewNodeWithConfig)
+  {
+    CabiRuntimeConfig config{};
+    config.struct_size = sizeof(config);
+    config.worker_threads = args.runtimeThreads;
+    config.pin_workers = args.pinCores;
+    runtime.reset(abi.NewRuntime(&config));
+    if (!runtime.handle)
     {
-      cout << "Reserved relay on " << addr << "\n";
+      throw std::runtime_error("cabi_runtime_new failed; see Rust logs for details");
+    }
+  }
+  else
+  {
+    cerr << "Library has no cabi_runtime_new; every node starts its own runtime\n";
+  }
+  const auto withRuntime = readProcessUsage();
+  printUsage("With runtime", withRuntime);
+
+  // Sized up front: a NodeHandle owns its node and must not be relocated.
+  // Declared after the runtime so every node is freed before it.
+  std::vector<NodeHandle> nodes(args.nodeCount);
+  const auto started = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < nodes.size(); ++i)
+  {
+    auto seed = args.identitySeed;
+    if (seed.has_value())
+    {
+      // Distinct PeerIds from the one seed: mix the node index into the tail
+      for (size_t b = 0; b < sizeof(uint32_t); ++b)
+      {
+        (*seed)[seed->size() - 1 - b] ^= static_cast<uint8_t>(i >> (8 * b));
+      }
+    }
+
+    nodes[i].abi = &abi;
+    nodes[i].reset(createNode(abi, args.useQuic, false, args.bootstrapPeers, seed, args.queues, args.tuning, runtime.handle));
+
+    const auto status = abi.ListenNode(nodes[i].handle, args.listen.c_str());
+    if (status != CABI_STATUS_SUCCESS)
+    {
+      throw std::runtime_error("cabi_node_listen failed for node #" + std::to_string(i) + ": " + statusMessage(status));
+    }
+    for (const auto& peer : args.bootstrapPeers)
+    {
+      abi.DialNode(nodes[i].handle, peer.c_str());
+    }
+  }
+  const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+
+  const auto withNodes = readProcessUsage();
+  printUsage("With nodes", withNodes);
+  const auto count = static_cast<double>(nodes.size());
+  cout << "Started " << nodes.size() << " nodes in " << elapsed << " ms; per node: "
+       << (withNodes.threads - withRuntime.threads) / count << " threads, "
+       << (withNodes.rssKb - withRuntime.rssKb) / count << " KiB RSS\n";
+  cout << "Enter /usage to sample again, /quit to stop the fleet\n";
+
+  string line;
+  while (std::getline(std::cin, line) && line != "/quit")
+  {
+    if (line == "/usage")
+    {
+      printUsage("Now", readProcessUsage());
+    }
+  }
+}
+
+// Starts a node, dials the bootstrap peers and times how long the first
+// get_closest_peers(self) takes to return a peer, retrying finished queries
+// until a 30 s budget runs out. A negative result means no lookup succeeded.
+double timeFirstLookup(const CabiRustLibp2p& abi, void* node)
+{
+  const auto self = readPeerId(abi, node);
+  const auto started = std::chrono::steady_clock::now();
+  const auto deadline = started + std::chrono::seconds(30);
+  uint64_t requestId = 0;
+  DiscoveryEvent event;
+  while (std::chrono::steady_clock::now() < deadline)
+  {
+    if (requestId == 0 && abi.GetClosestPeers(node, self.c_str(), &requestId) != CABI_STATUS_SUCCESS)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      continue;
+    }
+    if (!nextDiscoveryEvent(abi, node, deadline, event) || event.requestId != requestId)
+    {
+      continue;
+    }
+    if (event.kind == CABI_DISCOVERY_EVENT_FINISHED)
+    {
+      // Finished empty-handed: the table was not ready yet, ask again
+      requestId = 0;
+      continue;
+    }
+    if (!event.peerId.empty() && event.peerId != self)
+    {
+      return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    }
+  }
+  return -1;
+}
+
+// Cold start vs. warm start: time to the first successful lookup of a node
+// that only knows --bootstrap, then of a fresh node that loaded the peer
+// store the first one saved after its routing table filled.
+void runWarmStartBench(const CabiRustLibp2p& abi, const Arguments& args)
+{
+  if (!abi.SavePeerStore || !abi.LoadPeerStore)
+  {
+    throw std::runtime_error("library does not export cabi_node_save_peer_store/load_peer_store");
+  }
+  if (!abi.GetClosestPeers || !abi.DequeueDiscoveryEvent)
+  {
+    throw std::runtime_error("library does not export the discovery ABI");
+  }
+
+  const auto run = [&](bool warm) {
+    NodeHandle node;
+    node.abi = &abi;
+    node.reset(createNode(abi, args.useQuic, false, args.bootstrapPeers, args.identitySeed, args.queues, args.tuning));
+    if (warm)
+    {
+      loadPeerStore(abi, node.handle, args.peerStorePath);
+    }
+    const auto status = abi.ListenNode(node.handle, args.listen.c_str());
+    if (status != CABI_STATUS_SUCCESS)
+    {
+      throw std::runtime_error("cabi_node_listen failed: " + statusMessage(status));
+    }
+    dialPeers(abi, node.handle, args.bootstrapPeers, "bootstrap");
+    const auto elapsedMs = timeFirstLookup(abi, node.handle);
+    if (!warm)
+    {
+      // Let the bootstrap settle so the snapshot holds more than the first bucket
+      std::this_thread::sleep_for(std::chrono::seconds(2));
+      savePeerStore(abi, node.handle, args.peerStorePath, true);
+    }
+    return elapsedMs;
+  };
+  const auto report = [](const char* label, double ms) {
+    cout << label << ": ";
+    if (ms < 0)
+    {
+      cout << "no successful lookup within 30 s\n";
     }
     else
     {
-      cerr << "Failed to reserve relay on " << addr << " : " << statusMessage(status) << "\n";
+      cout << "first lookup after " << ms << " ms\n";
     }
+  };
+
+  cout << "Cold start (bootstrap peers only)...\n";
+  const auto coldMs = run(false);
+  report("Cold start", coldMs);
+  cout << "Warm start (from " << args.peerStorePath << ")...\n";
+  const auto warmMs = run(true);
+  report("Warm start", warmMs);
+  if (coldMs > 0 && warmMs > 0)
+  {
+    cout << "Warm start is " << coldMs / warmMs << "x faster\n";
   }
 }
 
@@ -651,6 +3123,40 @@ int main(int argc, char** argv)
   }
   #endif
 
+  if (args.warmStartBench)
+  {
+    try
+    {
+      runWarmStartBench(abi, args);
+    }
+    catch (const std::exception& ex)
+    {
+      cerr << "Fatal error: " << ex.what() << "\n";
+      CLOSE_LIB(lib);
+      return 1;
+    }
+
+    CLOSE_LIB(lib);
+    return 0;
+  }
+
+  if (args.nodeCount > 1)
+  {
+    try
+    {
+      runFleet(abi, args);
+    }
+    catch (const std::exception& ex)
+    {
+      cerr << "Fatal error: " << ex.what() << "\n";
+      CLOSE_LIB(lib);
+      return 1;
+    }
+
+    CLOSE_LIB(lib);
+    return 0;
+  }
+
   NodeHandle node;
   node.abi = &abi;
 
@@ -664,8 +3170,13 @@ int main(int argc, char** argv)
   try
   {
     // Step 4. Create node for this peer
-    node.reset(createNode(abi, args.useQuic, false, args.bootstrapPeers, args.identitySeed));
+    const bool hopFromStart = args.role == Role::Relay && args.forceHop;
+    node.reset(createNode(abi, args.useQuic, hopFromStart, args.bootstrapPeers, args.identitySeed, args.queues, args.tuning));
     cout << "Local PeerId: " << readPeerId(abi, node.handle) << "\n";
+    if (!args.peerStorePath.empty())
+    {
+      loadPeerStore(abi, node.handle, args.peerStorePath);
+    }
 
     // Step 5. Try listen on provided addr
     auto status = abi.ListenNode(node.handle, args.listen.c_str());
@@ -688,12 +3199,26 @@ int main(int argc, char** argv)
         cout << "Waiting up to " << waitTime.count() << "s for PUBLIC AutoNAT status before enabling relay hop...\n";
         
         // Step 6. Try understand wheter node is public or private
-        // And if public, remake the node
-        if (waitForPublicAutonat(abi, node.handle, waitTime))
+        // And if public, turn hop on in place, or remake the node on older libraries
+        const bool isPublic = waitForPublicAutonat(abi, node.handle, waitTime);
+        if (isPublic && setRelayHop(abi, node.handle, true))
+        {
+          cout << "AutoNAT is PUBLIC; relay hop enabled in place, connections kept\n";
+        }
+        else if (isPublic)
         {
           cout << "AutoNAT is PUBLIC; restarting with relay hop enabled\n";
+          // Carry what the first node learned over to the restarted one
+          if (!args.peerStorePath.empty())
+          {
+            savePeerStore(abi, node.handle, args.peerStorePath, false);
+          }
           node.reset();
-          node.reset(createNode(abi, args.useQuic, true, args.bootstrapPeers, args.identitySeed));
+          node.reset(createNode(abi, args.useQuic, true, args.bootstrapPeers, args.identitySeed, args.queues, args.tuning));
+          if (!args.peerStorePath.empty())
+          {
+            loadPeerStore(abi, node.handle, args.peerStorePath);
+          }
 
           status = abi.ListenNode(node.handle, args.listen.c_str());
           cout << "Listening with hop relay on " << args.listen << "\n";
@@ -711,21 +3236,50 @@ int main(int argc, char** argv)
       }
     }
 
+    // Metrics endpoint follows the final node, after any hop restart
+    MetricsExporter exporter;
+    if (args.metricsPort != 0)
+    {
+      exporter.start(abi, node.handle, args.metricsPort);
+    }
+    PeerStoreSaver peerStoreSaver;
+    if (!args.peerStorePath.empty())
+    {
+      peerStoreSaver.start(abi, node.handle, args.peerStorePath, std::chrono::seconds(60));
+    }
+
     // Step 7. Initail dial to know active peers from bootstrap and target
     dialPeers(abi, node.handle, args.bootstrapPeers, "bootstrap");
     dialPeers(abi, node.handle, args.targetPeers, "target");
 
+    StopSignal stop;
+    ReceiverStats receiverStats;
     std::thread receiver(
       recvLoop,
       std::cref(abi),
       node.handle,
-      std::ref(keepRunning));
+      args.recvMode,
+      std::ref(keepRunning),
+      std::cref(stop),
+      std::ref(receiverStats));
 
     // Step 8. Start sending loop
-    sendLoop(abi, node.handle, keepRunning);
+    sendLoop(abi, node.handle, args.bootstrapPeers, args.sendBatch, keepRunning);
 
     keepRunning.store(false, std::memory_order_release);
+    stop.notify();
     receiver.join();
+    exporter.stop();
+    peerStoreSaver.stop();
+    if (!args.peerStorePath.empty())
+    {
+      savePeerStore(abi, node.handle, args.peerStorePath, true);
+    }
+    printReceiverStats(receiverStats);
+    if (!args.queues.isDefault())
+    {
+      printQueueStats(abi, node.handle);
+    }
   }
   catch (const std::exception& ex)
   {
@@ -29,13 +29,18 @@ if ! curl -sfL -o "$SO_DEST" "$SO_URL"; then
 fi
 echo "  -> $SO_DEST"
 
-# C header (for reference; JNI code uses forward declarations)
+# C header. The copy in the tree is canonical: it also declares the optional
+# functions of newer releases, which the JNI and examples include. Only fetch it
+# when it is missing so a release header does not drop those declarations.
 H_URL="${BASE_URL}/cabi-rust-libp2p.h"
 H_DEST="$CPP_DIR/cabi-rust-libp2p.h"
-if ! curl -sfL -o "$H_DEST" "$H_URL"; then
+if [ -f "$H_DEST" ]; then
+  echo "  -> $H_DEST (kept)"
+elif ! curl -sfL -o "$H_DEST" "$H_URL"; then
   echo "Error: failed to download $H_URL" >&2
   exit 1
+else
+  echo "  -> $H_DEST"
 fi
-echo "  -> $H_DEST"
 
 echo "Done. Pre-built libcabi_rust_libp2p is ready for arm64-v8a."